@@ -0,0 +1,54 @@
+#include <benchmark/benchmark.h>
+
+#include <future>
+#include <vector>
+
+#include "events.h"
+#include "jobscheduler.h"
+
+// Args : number of events per poll, number of other listeners (that do not match the events)
+static void BM_EventQueuePostPoll(benchmark::State &state) {
+    auto &queue = EventQueue::getInstance();
+    int64_t num_received = 0;
+    Listener listener{"benchmark/*", [&num_received](Event_ptr &) { num_received++; }};
+    std::vector<Listener> others(state.range(1), Listener{"others/*", [](Event_ptr &) {}});
+
+    queue.subscribe(&listener);
+    for (auto &other : others)
+        queue.subscribe(&other);
+
+    for (auto _ : state) {
+        for (int i = 0; i < state.range(0); i++)
+            queue.post(Event_ptr(new Event("benchmark/event")));
+        queue.pollEvents();
+    }
+
+    queue.unsubscribe(&listener);
+    for (auto &other : others)
+        queue.unsubscribe(&other);
+    queue.pollEvents();
+
+    state.SetItemsProcessed(num_received);
+}
+BENCHMARK(BM_EventQueuePostPoll)->Args({100, 0})->Args({100, 50})->Args({1000, 50});
+
+// Time between the job being added and the job starting on a worker
+static void BM_JobSchedulerDispatch(benchmark::State &state) {
+    auto &scheduler = JobScheduler::getInstance();
+    for (auto _ : state) {
+        std::promise<void> started;
+        auto future = started.get_future();
+        jobFct job = [&started](float &, bool &) -> std::shared_ptr<JobResult> {
+            started.set_value();
+            return std::make_shared<JobResult>();
+        };
+        scheduler.addJob("benchmark", job);
+        future.wait();
+    }
+
+    while (scheduler.isBusy())
+        std::this_thread::yield();
+    scheduler.finalizeJobs();
+    EventQueue::getInstance().pollEvents();
+}
+BENCHMARK(BM_JobSchedulerDispatch)->UseRealTime();
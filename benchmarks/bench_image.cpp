@@ -0,0 +1,44 @@
+#include <benchmark/benchmark.h>
+
+#include "core/image.h"
+#include "core/dataset/extract_view_from_dicom.h"
+#include "core/segmentation/mask.h"
+
+#include "synthetic_ct.h"
+
+// CPU part of Image::setImageFromHU, the texture upload needs an OpenGL context
+static void BM_HuToRGBA(benchmark::State &state) {
+    cv::Mat slice = core::syntheticCTSlice((int)state.range(0));
+    cv::Mat rgba;
+    for (auto _ : state) {
+        core::huToRGBA(slice, 400, 40, rgba);
+        benchmark::DoNotOptimize(rgba.data);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(0));
+    state.SetBytesProcessed(state.iterations() * state.range(0) * state.range(0) * 4);
+}
+BENCHMARK(BM_HuToRGBA)->Arg(256)->Arg(512);
+
+static void BM_HuToRGBAWithMask(benchmark::State &state) {
+    cv::Mat slice = core::syntheticCTSlice((int)state.range(0));
+    auto mask = core::segmentation::huThresholdMask(slice, -29, 150, false, 0, 0);
+    cv::Mat rgba;
+    for (auto _ : state) {
+        core::huToRGBA(slice, 400, 40, rgba, mask.getData(), ImVec4(1, 0, 0, 0.5f));
+        benchmark::DoNotOptimize(rgba.data);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(0));
+}
+BENCHMARK(BM_HuToRGBAWithMask)->Arg(256)->Arg(512);
+
+// Args : number of slices, 1 for a horizontal (coronal) view, 0 for a sagittal one
+static void BM_BuildView(benchmark::State &state) {
+    auto volume = core::syntheticCTVolume((int)state.range(0), 512);
+    bool horizontal = state.range(1) != 0;
+    for (auto _ : state) {
+        auto view = core::dataset::build_view(volume, 0.5f, horizontal);
+        benchmark::DoNotOptimize(view.data.data);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * 512);
+}
+BENCHMARK(BM_BuildView)->Args({100, 1})->Args({100, 0})->Args({400, 0});
@@ -0,0 +1,167 @@
+#include "python/py_api.h"
+#include "python/executor.h"
+
+#include <benchmark/benchmark.h>
+
+#include <map>
+#include <chrono>
+#include <thread>
+#include <filesystem>
+
+#include "jobscheduler.h"
+#include "core/np2cv.h"
+#include "core/dataset/npz.h"
+#include "core/dataset/dicom_to_image.h"
+
+#include "synthetic_ct.h"
+
+// Per-slice cost of loading an imported image (.npz) through Python, compared to the native reader. The Python
+// interpreter needs the python directory of the install, these benchmarks run from the install directory.
+
+namespace {
+    namespace py = pybind11;
+
+    /**
+     * @return error message if Python could not be initialized
+     */
+    std::string init_python() {
+        static std::string error = [] {
+            PyAPI::Handler::getInstance();
+            auto& executor = PyAPI::Executor::getInstance();
+            try {
+                executor.call([&executor] {
+                    executor.module("python.scripts.__init__");
+                    executor.functions();
+                });
+            }
+            catch (const std::exception& e) {
+                return std::string("Could not initialize Python (run from the install directory): ") + e.what();
+            }
+            return std::string();
+        }();
+        return error;
+    }
+
+    /**
+     * Slice written once as by the import (see ImportPipeline::write)
+     */
+    const std::string& slice_file(int size) {
+        static std::map<int, std::string> files;
+        auto& filename = files[size];
+        if (filename.empty()) {
+            filename = (std::filesystem::temp_directory_path() / ("bm_bench_slice_" + std::to_string(size) + ".npz")).string();
+            core::dataset::NpzWriter writer;
+            writer.add("matrix", core::syntheticCTSlice(size));
+            writer.add("spacing", std::vector<double>{0.7, 0.7});
+            writer.add("windowing", std::vector<int64_t>{400, 40});
+            writer.add("crop_x", std::vector<double>{0., 100.});
+            writer.add("crop_y", std::vector<double>{0., 100.});
+            writer.add("slice_info", std::vector<double>{1., 0.});
+            std::string archive;
+            std::string error = writer.encode(archive);
+            if (error.empty())
+                error = core::dataset::NpzWriter::writeFile(filename, archive);
+            if (!error.empty())
+                filename.clear();
+        }
+        return filename;
+    }
+
+    /**
+     * Time during which the Executor held the GIL, per iteration
+     */
+    void set_gil_counter(benchmark::State& state, const PyAPI::ExecutorStats& before) {
+        auto after = PyAPI::Executor::getInstance().getStats();
+        state.counters["gil_ms"] = benchmark::Counter(after.gil_held_ms - before.gil_held_ms,
+                                                      benchmark::Counter::kAvgIterations);
+        state.counters["python_calls"] = benchmark::Counter((double)(after.num_calls - before.num_calls),
+                                                            benchmark::Counter::kAvgIterations);
+    }
+}
+
+// Same path as DicomSeries::loadCase : job of the JobScheduler, Python call on the Executor, result on this thread
+static void BM_NpyToMatrixJob(benchmark::State &state) {
+    std::string error = init_python();
+    const std::string& filename = slice_file((int)state.range(0));
+    if (!error.empty() || filename.empty()) {
+        state.SkipWithError(error.empty() ? "Could not write the slice" : error.c_str());
+        return;
+    }
+    auto& scheduler = JobScheduler::getInstance();
+    auto before = PyAPI::Executor::getInstance().getStats();
+    for (auto _ : state) {
+        std::shared_ptr<core::dataset::DicomResult> result;
+        core::dataset::npy_to_matrix(filename, [&result](const std::shared_ptr<JobResult>& job_result) {
+            result = std::dynamic_pointer_cast<core::dataset::DicomResult>(job_result);
+        });
+        while (result == nullptr) {
+            scheduler.finalizeJobs();
+            std::this_thread::yield();
+        }
+        if (!result->success) {
+            state.SkipWithError(result->error_msg.c_str());
+            break;
+        }
+        benchmark::DoNotOptimize(result->image.data.data);
+    }
+    set_gil_counter(state, before);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_NpyToMatrixJob)->Arg(256)->Arg(512)->UseRealTime();
+
+// Python part alone : numpy.load of the slice and conversion of its arrays, as in npy_to_matrix
+static void BM_ExecutorNumpyLoad(benchmark::State &state) {
+    std::string error = init_python();
+    const std::string& filename = slice_file((int)state.range(0));
+    if (!error.empty() || filename.empty()) {
+        state.SkipWithError(error.empty() ? "Could not write the slice" : error.c_str());
+        return;
+    }
+    auto& executor = PyAPI::Executor::getInstance();
+    auto before = executor.getStats();
+    for (auto _ : state) {
+        cv::Mat image;
+        float spacing = 0.f;
+        try {
+            executor.call([&] {
+                auto& functions = executor.functions();
+                auto data = functions.numpy_load(filename, **functions.numpy_load_kwargs);
+                core::npy_buffer_to_cv(data["matrix"], image);
+                spacing = data["spacing"].cast<py::list>()[0].cast<float>();
+            });
+        }
+        catch (const std::exception& e) {
+            state.SkipWithError(e.what());
+            break;
+        }
+        benchmark::DoNotOptimize(image.data);
+        benchmark::DoNotOptimize(spacing);
+    }
+    set_gil_counter(state, before);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ExecutorNumpyLoad)->Arg(256)->Arg(512)->UseRealTime();
+
+// Lower bound without Python (NpzReader)
+static void BM_NpzReaderNative(benchmark::State &state) {
+    const std::string& filename = slice_file((int)state.range(0));
+    if (filename.empty()) {
+        state.SkipWithError("Could not write the slice");
+        return;
+    }
+    for (auto _ : state) {
+        core::dataset::NpzReader reader;
+        core::dataset::NpyArray array;
+        cv::Mat image;
+        std::string error = reader.open(filename);
+        if (error.empty())
+            error = reader.read("matrix", array);
+        if (!error.empty() || !array.toMat(image)) {
+            state.SkipWithError("Could not read the slice");
+            break;
+        }
+        benchmark::DoNotOptimize(image.data);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_NpzReaderNative)->Arg(256)->Arg(512);
@@ -0,0 +1,110 @@
+#include <benchmark/benchmark.h>
+
+#include "core/segmentation/mask.h"
+
+#include "synthetic_ct.h"
+
+namespace seg = core::segmentation;
+
+/*
+ * Masks of a synthetic slice : muscles (-29 to 150 HU) and fat (-190 to -30 HU)
+ */
+struct SliceMasks {
+    cv::Mat slice;
+    seg::Mask muscle;
+    seg::Mask fat;
+
+    explicit SliceMasks(int size) : slice(core::syntheticCTSlice(size)) {
+        muscle = seg::huThresholdMask(slice, -29, 150, false, 0, 0);
+        fat = seg::huThresholdMask(slice, -190, -30, false, 0, 0);
+    }
+};
+
+static void BM_MaskCopy(benchmark::State &state) {
+    SliceMasks masks((int)state.range(0));
+    for (auto _ : state) {
+        auto mask = masks.muscle.copy();
+        benchmark::DoNotOptimize(mask.getData().data);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(0));
+}
+BENCHMARK(BM_MaskCopy)->Arg(256)->Arg(512);
+
+// The boolean operations are done on a copy, see BM_MaskCopy for its cost
+static void BM_MaskUnion(benchmark::State &state) {
+    SliceMasks masks((int)state.range(0));
+    for (auto _ : state) {
+        auto mask = masks.muscle.copy();
+        mask.union_with(masks.fat);
+        benchmark::DoNotOptimize(mask.getData().data);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(0));
+}
+BENCHMARK(BM_MaskUnion)->Arg(256)->Arg(512);
+
+static void BM_MaskIntersect(benchmark::State &state) {
+    SliceMasks masks((int)state.range(0));
+    for (auto _ : state) {
+        auto mask = masks.muscle.copy();
+        mask.intersect_with(masks.fat);
+        benchmark::DoNotOptimize(mask.getData().data);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(0));
+}
+BENCHMARK(BM_MaskIntersect)->Arg(256)->Arg(512);
+
+static void BM_MaskDifference(benchmark::State &state) {
+    SliceMasks masks((int)state.range(0));
+    for (auto _ : state) {
+        auto mask = masks.muscle.copy();
+        mask.difference_with(masks.fat);
+        benchmark::DoNotOptimize(mask.getData().data);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(0));
+}
+BENCHMARK(BM_MaskDifference)->Arg(256)->Arg(512);
+
+static void BM_MaskInvert(benchmark::State &state) {
+    SliceMasks masks((int)state.range(0));
+    for (auto _ : state) {
+        auto mask = masks.muscle.copy();
+        mask.invert();
+        benchmark::DoNotOptimize(mask.getData().data);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(0));
+}
+BENCHMARK(BM_MaskInvert)->Arg(256)->Arg(512);
+
+// Args : size of the slice, closing / opening size
+static void BM_HuThresholdMask(benchmark::State &state) {
+    cv::Mat slice = core::syntheticCTSlice((int)state.range(0));
+    int morphology_size = (int)state.range(1);
+    for (auto _ : state) {
+        auto mask = seg::huThresholdMask(slice, -29, 150, true, morphology_size, morphology_size);
+        benchmark::DoNotOptimize(mask.getData().data);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(0));
+}
+BENCHMARK(BM_HuThresholdMask)->Args({256, 0})->Args({512, 0})->Args({512, 3});
+
+static void BM_VertebraDistanceMask(benchmark::State &state) {
+    cv::Mat slice = core::syntheticCTSlice((int)state.range(0));
+    for (auto _ : state) {
+        auto mask = seg::vertebraDistanceMask(slice, 200, 10);
+        benchmark::DoNotOptimize(mask.getData().data);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(0));
+}
+BENCHMARK(BM_VertebraDistanceMask)->Arg(256)->Arg(512);
+
+static void BM_RemoveSmallObjects(benchmark::State &state) {
+    // The noise of the slice leaves many small objects in the fat mask
+    SliceMasks masks((int)state.range(0));
+    for (auto _ : state) {
+        auto mask = masks.fat.copy();
+        mask.remove_small_objects(20);
+        benchmark::DoNotOptimize(mask.getData().data);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(0));
+}
+BENCHMARK(BM_RemoveSmallObjects)->Arg(256)->Arg(512);
@@ -0,0 +1,502 @@
+/**
+ * Headless end-to-end harness : generates a synthetic project and measures the stages that a user goes through
+ * (explore, import, load the project, browse the series, load and save the masks), without a window or a GPU.
+ *
+ * Usage:
+ *   e2e_harness [--cases N] [--slices N] [--size N] [--format dicom|npz] [--workers N] [--series N]
+ *               [--dir path] [--output results.json] [--clean]
+ *
+ * With --format dicom (default), DICOM files are generated and go through the explorer and the import. With
+ * --format npz, the images are written directly in the project (as the import would have), to measure the
+ * loading of large projects without the import. The results (duration of each stage, Profiler timers and
+ * counters, time spent in Python) are written as JSON.
+ *
+ * The Python scripts are needed (numpy.load of the images, masks), the harness must be run from the install
+ * directory, as the app. Everything is generated in <dir>/bm_e2e, which is removed first.
+ */
+
+#include "python/py_api.h"
+#include "python/init_python.h"
+#include "python/executor.h"
+
+#include <atomic>
+#include <cstdio>
+#include <future>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <filesystem>
+#include <functional>
+#include <thread>
+
+#include "jobscheduler.h"
+#include "profiler.h"
+#include "settings.h"
+#include "core/dataset/npz.h"
+#include "core/dataset/explore.h"
+#include "core/project/project.h"
+#include "core/segmentation/segmentation.h"
+
+#include "synthetic_ct.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+    struct Options {
+        int num_cases = 100;
+        int num_slices = 20;
+        int size = 256;
+        bool dicom = true;
+        int num_workers = 4;
+        // Number of series fully loaded (loadAll), -1 for all of them
+        int num_series = -1;
+        std::string directory = ".";
+        std::string output = "e2e_results.json";
+        bool clean = false;
+        double timeout_s = 24 * 3600;
+    };
+
+    struct Stage {
+        std::string name;
+        double ms = 0.;
+        size_t items = 0;
+        std::string error;
+    };
+
+    std::string case_name(int index) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "case_%05d", index);
+        return name;
+    }
+
+    /**
+     * Calls fct(i) for i in [0, count[ on all the cores, returns the first error
+     */
+    std::string parallel_for(int count, const std::function<std::string(int)>& fct) {
+        std::atomic<int> next{0};
+        std::mutex error_mutex;
+        std::string error;
+        std::vector<std::thread> threads;
+        for (unsigned int t = 0; t < std::max(std::thread::hardware_concurrency(), 1u); t++) {
+            threads.emplace_back([&] {
+                for (int i = next++; i < count; i = next++) {
+                    std::string fct_error = fct(i);
+                    if (!fct_error.empty()) {
+                        std::lock_guard<std::mutex> lock(error_mutex);
+                        if (error.empty())
+                            error = fct_error;
+                        return;
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        return error;
+    }
+
+    class Harness {
+    private:
+        Options options_;
+        fs::path workspace_;
+        std::vector<Stage> stages_;
+        std::shared_ptr<core::project::Project> project_;
+
+        template<typename Fct>
+        void run_stage(const std::string& name, Fct&& fct) {
+            std::cout << name << "..." << std::endl;
+            Stage stage;
+            stage.name = name;
+            auto start = Profiler::Clock::now();
+            stage.error = fct(stage.items);
+            auto end = Profiler::Clock::now();
+            stage.ms = std::chrono::duration<double, std::milli>(end - start).count();
+            Profiler::getInstance().addTime("e2e/" + name, start, end);
+            if (!stage.error.empty())
+                std::cerr << name << ": " << stage.error << std::endl;
+            stages_.push_back(stage);
+        }
+
+        bool failed() const { return !stages_.empty() && !stages_.back().error.empty(); }
+
+        std::string generate_dicoms(size_t& items) {
+            fs::path directory = workspace_ / "dicoms";
+            items = (size_t)options_.num_cases * options_.num_slices;
+            return parallel_for(options_.num_cases, [&](int c) {
+                fs::path patient_directory = directory / case_name(c);
+                std::error_code error;
+                fs::create_directories(patient_directory, error);
+                if (error)
+                    return error.message();
+                for (int s = 0; s < options_.num_slices; s++) {
+                    cv::Mat slice = core::syntheticCTSlice(options_.size, s, (unsigned int)c);
+                    std::string write_error = core::writeSyntheticDicom(
+                            (patient_directory / (std::to_string(s) + ".dcm")).string(), slice, case_name(c), s + 1, s);
+                    if (!write_error.empty())
+                        return write_error;
+                }
+                return std::string();
+            });
+        }
+
+        std::string generate_npz(size_t& items) {
+            // Same files as the import (see ImportPipeline::write)
+            fs::path directory = fs::path(project_->getRoot()) / "data" / "dicoms";
+            items = (size_t)options_.num_cases * options_.num_slices;
+            std::string error_msg = parallel_for(options_.num_cases, [&](int c) {
+                fs::path series_directory = directory / case_name(c);
+                std::error_code error;
+                fs::create_directories(series_directory, error);
+                if (error)
+                    return error.message();
+                for (int s = 0; s < options_.num_slices; s++) {
+                    core::dataset::NpzWriter writer;
+                    writer.add("matrix", core::syntheticCTSlice(options_.size, s, (unsigned int)c));
+                    writer.add("spacing", std::vector<double>{0.7, 0.7});
+                    writer.add("windowing", std::vector<int64_t>{400, 40});
+                    writer.add("crop_x", std::vector<double>{0., 100.});
+                    writer.add("crop_y", std::vector<double>{0., 100.});
+                    writer.add("slice_info", std::vector<double>{1., (double)s});
+                    std::string archive;
+                    std::string write_error = writer.encode(archive);
+                    if (write_error.empty())
+                        write_error = core::dataset::NpzWriter::writeFile(
+                                (series_directory / (std::to_string(s) + ".npz")).string(), archive);
+                    if (!write_error.empty())
+                        return write_error;
+                }
+                return std::string();
+            });
+            if (!error_msg.empty())
+                return error_msg;
+
+            std::vector<std::string> ids;
+            for (int c = 0; c < options_.num_cases; c++)
+                ids.push_back(case_name(c));
+            auto& dataset = project_->getDataset();
+            return dataset.registerFiles(ids, dataset.createGroup("Synthetic"), project_->getRoot());
+        }
+
+        /**
+         * One mask per series, thresholded from its first image, and the segmentation that holds them
+         */
+        std::string generate_masks(size_t& items) {
+            auto segmentation = std::make_shared<core::segmentation::Segmentation>("Muscle", "Synthetic masks");
+            std::string error_msg = project_->addSegmentation(segmentation);
+            if (error_msg.empty())
+                error_msg = project_->saveSegmentations();
+            if (!error_msg.empty())
+                return error_msg;
+
+            fs::path root(project_->getRoot());
+            std::vector<std::string> ids;
+            for (auto& entry : fs::directory_iterator(root / "data" / "dicoms")) {
+                if (entry.is_directory())
+                    ids.push_back(entry.path().filename().string());
+            }
+            items = ids.size();
+            fs::path masks_directory = root / "data" / "masks" / segmentation->getStrippedName();
+            return parallel_for((int)ids.size(), [&](int i) {
+                core::dataset::NpzReader reader;
+                core::dataset::NpyArray array;
+                cv::Mat image, mask;
+                std::string error = reader.open((root / "data" / "dicoms" / ids[i] / "0.npz").string());
+                if (error.empty())
+                    error = reader.read("matrix", array);
+                if (!error.empty())
+                    return error;
+                if (!array.toMat(image))
+                    return "Unsupported image in '" + ids[i] + "'";
+                // Muscle range, as 0 / 1
+                cv::inRange(image, cv::Scalar(-29), cv::Scalar(150), mask);
+                mask.convertTo(mask, CV_8U, 1. / 255.);
+
+                core::dataset::NpzWriter writer;
+                writer.add("current", mask);
+                std::string archive;
+                error = writer.encode(archive);
+                if (error.empty())
+                    error = core::dataset::NpzWriter::writeFile((masks_directory / (ids[i] + ".npz")).string(), archive);
+                return error;
+            });
+        }
+
+        std::string explore_and_import() {
+            auto& scheduler = JobScheduler::getInstance();
+            core::dataset::Explore explore;
+
+            run_stage("explore", [&](size_t& items) {
+                explore.findDicoms((workspace_ / "dicoms").string());
+                if (!JobScheduler::getInstance().runUntil([&] { return !scheduler.isBusy(); }, options_.timeout_s))
+                    return std::string("Timeout");
+                // The last cases are inserted in the tree, as by the next frame of the app
+                while (explore.update());
+                for (auto& patient : *explore.getCases()) {
+                    for (auto& study : patient.study) {
+                        for (auto& series : study.series)
+                            items += series->images.size();
+                    }
+                }
+                if (explore.getStatus() == core::dataset::Explore::EXPLORE_ERROR)
+                    return std::string("Exploration failed");
+                return std::string();
+            });
+            if (failed())
+                return stages_.back().error;
+
+            run_stage("import", [&](size_t& items) {
+                auto& dataset = project_->getDataset();
+                auto& group = dataset.createGroup("Synthetic");
+                std::shared_ptr<core::dataset::ImportResult> result;
+                dataset.importData(group, explore.getCases(), project_->getRoot(),
+                                   [&result](const std::shared_ptr<JobResult>& job_result) {
+                                       result = std::dynamic_pointer_cast<core::dataset::ImportResult>(job_result);
+                                   });
+                if (!JobScheduler::getInstance().runUntil([&] { return result != nullptr; }, options_.timeout_s))
+                    return std::string("Timeout");
+                if (!result->success)
+                    return result->error_msg;
+                for (auto& progress : dataset.getImportProgress())
+                    items += progress->num_done;
+                // As when the import modal is closed
+                return dataset.registerFiles(result->save_paths, group, project_->getRoot());
+            });
+            return failed() ? stages_.back().error : "";
+        }
+
+        std::string load_series(size_t& items) {
+            auto& dicoms = project_->getDataset().getOrderedDicoms();
+            size_t num_series = options_.num_series < 0 ? dicoms.size()
+                                                        : std::min(dicoms.size(), (size_t)options_.num_series);
+            size_t num_errors = 0;
+            // One series at a time, as when browsing the project, so that the memory stays bounded
+            for (size_t i = 0; i < num_series; i++) {
+                auto& dicom = dicoms[i];
+                int num_finished = 0;
+                dicom->loadAll([&](const core::Dicom& image) {
+                    num_finished++;
+                    if (!image.error_message.empty())
+                        num_errors++;
+                });
+                if (!JobScheduler::getInstance().runUntil([&] { return num_finished >= dicom->size(); }, options_.timeout_s))
+                    return "Timeout";
+                items += num_finished;
+                dicom->unloadAll();
+            }
+            if (num_errors > 0)
+                return std::to_string(num_errors) + " images could not be loaded";
+            return "";
+        }
+
+        std::string load_masks(size_t& items) {
+            std::atomic<size_t> num_loaded{0};
+            for (auto& segmentation : project_->getSegmentations()) {
+                for (auto& mask : segmentation->getMasks()) {
+                    mask.second->loadData(false, true, "", [&num_loaded] { num_loaded++; });
+                    items++;
+                }
+            }
+            if (!JobScheduler::getInstance().runUntil([&] { return num_loaded >= items; }, options_.timeout_s))
+                return "Timeout";
+            return "";
+        }
+
+        std::string save_masks(size_t& items) {
+            std::vector<std::future<std::string>> saves;
+            for (auto& segmentation : project_->getSegmentations()) {
+                for (auto& mask : segmentation->getMasks()) {
+                    saves.push_back(mask.second->saveCollection());
+                    items++;
+                }
+            }
+            std::string error;
+            for (auto& save : saves) {
+                try {
+                    std::string save_error = save.get();
+                    if (error.empty())
+                        error = save_error;
+                }
+                catch (const std::exception& e) {
+                    if (error.empty())
+                        error = e.what();
+                }
+            }
+            if (!error.empty())
+                return error;
+            for (auto& segmentation : project_->getSegmentations()) {
+                for (auto& mask : segmentation->getMasks())
+                    mask.second->unloadData(true);
+            }
+            return "";
+        }
+
+    public:
+        explicit Harness(Options options) : options_(std::move(options)) {
+            workspace_ = fs::path(options_.directory) / "bm_e2e";
+        }
+
+        /**
+         * @return false if a stage failed
+         */
+        bool run() {
+            std::error_code error;
+            fs::remove_all(workspace_, error);
+            fs::create_directories(workspace_, error);
+            if (error) {
+                std::cerr << "Could not create '" << workspace_.string() << "': " << error.message() << std::endl;
+                return false;
+            }
+
+            project_ = std::make_shared<core::project::Project>("Synthetic", "Generated by e2e_harness");
+            std::string project_file;
+            if (!project_->setUpWorkspace(workspace_.string(), project_->getName(), STRING(PROJECT_EXTENSION), project_file)) {
+                std::cerr << project_file << std::endl;
+                return false;
+            }
+            project_->setSaveFile(project_file);
+
+            if (options_.dicom) {
+                run_stage("generate_dicoms", [this](size_t& items) { return generate_dicoms(items); });
+                if (failed() || !explore_and_import().empty())
+                    return false;
+            }
+            else {
+                run_stage("generate_npz", [this](size_t& items) { return generate_npz(items); });
+                if (failed())
+                    return false;
+            }
+            run_stage("generate_masks", [this](size_t& items) { return generate_masks(items); });
+            if (failed())
+                return false;
+
+            // The project is opened again, as by the app
+            project_ = std::make_shared<core::project::Project>("Synthetic", "Generated by e2e_harness");
+            project_->setSaveFile(project_file);
+            run_stage("dataset_load", [this, &project_file](size_t& items) {
+                std::string load_error = project_->getDataset().load(project_file);
+                items = project_->getDataset().getDicoms().size();
+                return load_error;
+            });
+            run_stage("load_segmentations", [this](size_t& items) {
+                std::string load_error = project_->loadSegmentations();
+                for (auto& segmentation : project_->getSegmentations())
+                    items += segmentation->getMasks().size();
+                return load_error;
+            });
+            if (failed())
+                return false;
+            run_stage("series_load_all", [this](size_t& items) { return load_series(items); });
+            run_stage("masks_load", [this](size_t& items) { return load_masks(items); });
+            run_stage("masks_save", [this](size_t& items) { return save_masks(items); });
+
+            bool success = true;
+            for (auto& stage : stages_)
+                success = success && stage.error.empty();
+            if (options_.clean)
+                fs::remove_all(workspace_, error);
+            return success;
+        }
+
+        std::string writeResults() {
+            std::ofstream file(options_.output, std::ios::trunc);
+            if (!file)
+                return "Could not open '" + options_.output + "'";
+
+            file << "{\n\"config\": {\"cases\": " << options_.num_cases << ", \"slices\": " << options_.num_slices
+                 << ", \"size\": " << options_.size << ", \"format\": \"" << (options_.dicom ? "dicom" : "npz")
+                 << "\", \"workers\": " << options_.num_workers << "},\n\"stages\": [";
+            for (size_t i = 0; i < stages_.size(); i++) {
+                auto& stage = stages_[i];
+                double per_second = stage.ms > 0. ? 1000. * (double)stage.items / stage.ms : 0.;
+                file << (i ? "," : "") << "\n  {\"name\": \"" << stage.name << "\", \"ms\": " << stage.ms
+                     << ", \"items\": " << stage.items << ", \"items_per_s\": " << per_second
+                     << ", \"error\": \"" << escapeJson(stage.error) << "\"}";
+            }
+
+            file << "\n],\n\"timers\": {";
+            bool first = true;
+            for (auto& timer : Profiler::getInstance().getTimers()) {
+                file << (first ? "" : ",") << "\n  \"" << escapeJson(timer.first) << "\": {\"count\": "
+                     << timer.second.count << ", \"total_ms\": " << timer.second.total_ms << ", \"max_ms\": "
+                     << timer.second.max_ms << "}";
+                first = false;
+            }
+            file << "\n},\n\"counters\": {";
+            first = true;
+            for (auto& counter : Profiler::getInstance().getCounters()) {
+                file << (first ? "" : ",") << "\n  \"" << escapeJson(counter.first) << "\": " << counter.second;
+                first = false;
+            }
+
+            auto python = PyAPI::Executor::getInstance().getStats();
+            file << "\n},\n\"python\": {\"calls\": " << python.num_calls << ", \"batches\": " << python.num_batches
+                 << ", \"gil_held_ms\": " << python.gil_held_ms << ", \"max_batch_ms\": " << python.max_batch_ms
+                 << ", \"max_queue_size\": " << python.max_queue_size << "}\n}\n";
+
+            if (!file)
+                return "Could not write '" + options_.output + "'";
+            return "";
+        }
+    };
+
+    bool parse_options(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool has_value = i + 1 < argc;
+            if (arg == "--clean") {
+                options.clean = true;
+                continue;
+            }
+            if (!has_value)
+                return false;
+            std::string value = argv[++i];
+            try {
+                if (arg == "--cases")
+                    options.num_cases = std::stoi(value);
+                else if (arg == "--slices")
+                    options.num_slices = std::stoi(value);
+                else if (arg == "--size")
+                    options.size = std::stoi(value);
+                else if (arg == "--workers")
+                    options.num_workers = std::stoi(value);
+                else if (arg == "--series")
+                    options.num_series = std::stoi(value);
+                else if (arg == "--dir")
+                    options.directory = value;
+                else if (arg == "--output")
+                    options.output = value;
+                else if (arg == "--format" && (value == "dicom" || value == "npz"))
+                    options.dicom = value == "dicom";
+                else
+                    return false;
+            }
+            catch (const std::exception&) {
+                return false;
+            }
+        }
+        return options.num_cases > 0 && options.num_slices > 0 && options.size >= 32 && options.num_workers > 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        std::cerr << "Usage: e2e_harness [--cases N] [--slices N] [--size N] [--format dicom|npz] [--workers N]"
+                     " [--series N] [--dir path] [--output results.json] [--clean]" << std::endl;
+        return 2;
+    }
+
+    PyAPI::Handler::getInstance();
+    JobScheduler::getInstance().setWorkerPoolSize(options.num_workers);
+    PyAPI::init();
+
+    Harness harness(options);
+    bool success = harness.run();
+    std::string error = harness.writeResults();
+    if (!error.empty()) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    std::cout << "Results written in " << options.output << std::endl;
+    return success ? 0 : 1;
+}
@@ -0,0 +1,175 @@
+#include "synthetic_ct.h"
+
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <algorithm>
+
+namespace {
+    /**
+     * Data elements of a DICOM file, in explicit VR little endian
+     */
+    class DicomWriter {
+    private:
+        std::string data_;
+
+        void add_uint(uint32_t value, int num_bytes) {
+            for (int i = 0; i < num_bytes; i++) {
+                data_ += (char)((value >> (8 * i)) & 0xFF);
+            }
+        }
+        void add_header(uint16_t group, uint16_t number, const char* vr, uint32_t length) {
+            add_uint(group, 2);
+            add_uint(number, 2);
+            data_.append(vr, 2);
+            // OB and OW have a 4 bytes length, after 2 reserved bytes
+            if (vr[0] == 'O') {
+                add_uint(0, 2);
+                add_uint(length, 4);
+            }
+            else {
+                add_uint(length, 2);
+            }
+        }
+    public:
+        const std::string& data() const { return data_; }
+
+        void addString(uint16_t group, uint16_t number, const char* vr, std::string value) {
+            // Values have an even length, UIs are padded with a null byte and the other strings with a space
+            if (value.size() % 2)
+                value += std::string(vr) == "UI" ? '\0' : ' ';
+            add_header(group, number, vr, (uint32_t)value.size());
+            data_ += value;
+        }
+        void addUnsigned(uint16_t group, uint16_t number, const char* vr, uint32_t value) {
+            int num_bytes = std::string(vr) == "US" ? 2 : 4;
+            add_header(group, number, vr, num_bytes);
+            add_uint(value, num_bytes);
+        }
+        void addBytes(uint16_t group, uint16_t number, const char* vr, const char* bytes, uint32_t size) {
+            add_header(group, number, vr, size);
+            data_.append(bytes, size);
+        }
+    };
+
+    std::string decimal(double value) {
+        std::ostringstream stream;
+        stream << value;
+        return stream.str();
+    }
+}
+
+cv::Mat core::syntheticCTSlice(int size, int index, unsigned int seed) {
+    cv::Mat slice(size, size, CV_16S, cv::Scalar(-1000));
+
+    // The body grows and shrinks a little along the volume
+    float scale = (float)size * (1.f + 0.03f * std::sin(0.2f * (float)index));
+    cv::Point center(size / 2, size / 2);
+    cv::Size body((int)(0.42f * scale), (int)(0.32f * scale));
+    int fat_thickness = std::max(2, size / 25);
+
+    // Subcutaneous fat, then soft tissue
+    cv::ellipse(slice, center, body, 0, 0, 360, cv::Scalar(-100), cv::FILLED);
+    cv::ellipse(slice, center, cv::Size(body.width - fat_thickness, body.height - fat_thickness), 0, 0, 360,
+                cv::Scalar(40), cv::FILLED);
+
+    // Visceral fat
+    cv::ellipse(slice, center + cv::Point(-size / 8, -size / 12), cv::Size(size / 12, size / 16), 20, 0, 360,
+                cv::Scalar(-90), cv::FILLED);
+    cv::ellipse(slice, center + cv::Point(size / 9, -size / 10), cv::Size(size / 14, size / 18), -15, 0, 360,
+                cv::Scalar(-90), cv::FILLED);
+
+    // Back muscles on both sides of the vertebra, psoas in front of it
+    cv::Point vertebra = center + cv::Point(0, (int)(0.17f * scale));
+    cv::ellipse(slice, vertebra + cv::Point(-size / 9, size / 40), cv::Size(size / 12, size / 16), 0, 0, 360,
+                cv::Scalar(55), cv::FILLED);
+    cv::ellipse(slice, vertebra + cv::Point(size / 9, size / 40), cv::Size(size / 12, size / 16), 0, 0, 360,
+                cv::Scalar(55), cv::FILLED);
+    cv::ellipse(slice, vertebra + cv::Point(-size / 14, -size / 12), cv::Size(size / 30, size / 22), 0, 0, 360,
+                cv::Scalar(50), cv::FILLED);
+    cv::ellipse(slice, vertebra + cv::Point(size / 14, -size / 12), cv::Size(size / 30, size / 22), 0, 0, 360,
+                cv::Scalar(50), cv::FILLED);
+
+    // Vertebra : cortical bone around spongy bone, spinal canal behind
+    int radius = std::max(4, size / 20);
+    cv::circle(slice, vertebra, radius, cv::Scalar(900), cv::FILLED);
+    cv::circle(slice, vertebra, radius - std::max(2, size / 200), cv::Scalar(250), cv::FILLED);
+    cv::circle(slice, vertebra + cv::Point(0, radius + radius / 2), radius / 2, cv::Scalar(10), cv::FILLED);
+
+    // Noise of the scanner
+    cv::Mat noise(size, size, CV_16S);
+    cv::RNG rng(((uint64_t)seed << 32) + (uint64_t)index + 1);
+    rng.fill(noise, cv::RNG::NORMAL, 0, 15);
+    slice += noise;
+
+    return slice;
+}
+
+std::vector<core::Dicom> core::syntheticCTVolume(int num_slices, int size, unsigned int seed) {
+    std::vector<Dicom> volume(num_slices);
+    for (int i = 0; i < num_slices; i++) {
+        volume[i].data = syntheticCTSlice(size, i, seed);
+        volume[i].slice_position = (float)i;
+        volume[i].is_set = true;
+    }
+    return volume;
+}
+
+std::string core::writeSyntheticDicom(const std::string& filename, const cv::Mat& slice, const std::string& patient_id,
+                                      int instance_number, double slice_location, double pixel_spacing) {
+    if (slice.type() != CV_16S)
+        return "Synthetic DICOM files can only be written from CV_16S slices";
+    const std::string sop_class = "1.2.840.10008.5.1.4.1.1.2"; // CT Image Storage
+    const std::string sop_instance = "1.2.826.0.1.3680043.2.1125."
+            + std::to_string(std::hash<std::string>{}(patient_id) % 1000000000) + "." + std::to_string(instance_number);
+
+    DicomWriter meta;
+    const char version[2] = {0, 1};
+    meta.addBytes(0x0002, 0x0001, "OB", version, 2);
+    meta.addString(0x0002, 0x0002, "UI", sop_class);
+    meta.addString(0x0002, 0x0003, "UI", sop_instance);
+    meta.addString(0x0002, 0x0010, "UI", "1.2.840.10008.1.2.1"); // Explicit VR little endian
+
+    // Tags in ascending order, the pixel data last
+    DicomWriter dataset;
+    dataset.addString(0x0008, 0x0016, "UI", sop_class);
+    dataset.addString(0x0008, 0x0018, "UI", sop_instance);
+    dataset.addString(0x0008, 0x0020, "DA", "20200101");
+    dataset.addString(0x0008, 0x0030, "TM", "120000");
+    dataset.addString(0x0008, 0x0060, "CS", "CT");
+    dataset.addString(0x0008, 0x1030, "LO", "SYNTHETIC");
+    dataset.addString(0x0010, 0x0020, "LO", patient_id);
+    dataset.addString(0x0018, 0x0050, "DS", "1");
+    dataset.addString(0x0020, 0x0011, "IS", "1");
+    dataset.addString(0x0020, 0x0013, "IS", std::to_string(instance_number));
+    dataset.addString(0x0020, 0x1041, "DS", decimal(slice_location));
+    dataset.addUnsigned(0x0028, 0x0002, "US", 1);
+    dataset.addString(0x0028, 0x0004, "CS", "MONOCHROME2");
+    dataset.addUnsigned(0x0028, 0x0010, "US", (uint32_t)slice.rows);
+    dataset.addUnsigned(0x0028, 0x0011, "US", (uint32_t)slice.cols);
+    dataset.addString(0x0028, 0x0030, "DS", decimal(pixel_spacing) + "\\" + decimal(pixel_spacing));
+    dataset.addUnsigned(0x0028, 0x0100, "US", 16);
+    dataset.addUnsigned(0x0028, 0x0101, "US", 16);
+    dataset.addUnsigned(0x0028, 0x0102, "US", 15);
+    dataset.addUnsigned(0x0028, 0x0103, "US", 1);
+    dataset.addString(0x0028, 0x1052, "DS", "0");
+    dataset.addString(0x0028, 0x1053, "DS", "1");
+    cv::Mat pixels = slice.isContinuous() ? slice : slice.clone();
+    dataset.addBytes(0x7FE0, 0x0010, "OW", (const char*)pixels.data, (uint32_t)pixels.total() * 2);
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return "Could not open '" + filename + "'";
+    std::string preamble(128, '\0');
+    file.write(preamble.data(), (std::streamsize)preamble.size());
+    file.write("DICM", 4);
+    DicomWriter group_length;
+    group_length.addUnsigned(0x0002, 0x0000, "UL", (uint32_t)meta.data().size());
+    file.write(group_length.data().data(), (std::streamsize)group_length.data().size());
+    file.write(meta.data().data(), (std::streamsize)meta.data().size());
+    file.write(dataset.data().data(), (std::streamsize)dataset.data().size());
+    if (!file)
+        return "Could not write '" + filename + "'";
+    return "";
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+#include "core/dicom.h"
+
+namespace core {
+    /**
+     * Generates a CT-like axial slice in Houndsfield units (CV_16S), so that the pipelines can be measured and
+     * tested without patient data
+     *
+     * The slice contains air around an elliptic body, subcutaneous and visceral fat, soft tissue, the back muscles
+     * and a vertebra (cortical and spongy bone, spinal canal), with Gaussian noise.
+     * @param size width and height of the slice
+     * @param index index of the slice in its volume, the anatomy varies slowly from one slice to the next
+     * @param seed seed of the noise, the same parameters always give the same slice
+     */
+    cv::Mat syntheticCTSlice(int size, int index = 0, unsigned int seed = 0);
+
+    /**
+     * Generates the slices of a synthetic volume (see syntheticCTSlice), with a slice thickness of 1mm
+     */
+    std::vector<Dicom> syntheticCTVolume(int num_slices, int size, unsigned int seed = 0);
+
+    /**
+     * Writes a slice (see syntheticCTSlice) as an uncompressed CT DICOM file (explicit VR little endian), with the
+     * tags that are read by the explorer and by the import
+     *
+     * All the files of a patient are put in the same study and series.
+     * @param slice_location position of the slice in mm, also used for the slice thickness of 1mm
+     * @return error message if the file could not be written
+     */
+    std::string writeSyntheticDicom(const std::string& filename, const cv::Mat& slice, const std::string& patient_id,
+                                    int instance_number, double slice_location, double pixel_spacing = 0.7);
+}
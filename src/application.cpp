@@ -10,6 +10,7 @@
 
 #include "application.h"
 #include "settings.h"
+#include "profiler.h"
 
 
 static void glfw_error_callback(int error, const char* description) {
@@ -163,6 +164,8 @@ bool Rendering::Application::loop() {
         else {
             glfwWaitEvents();
         }
+        // The time waiting for the events is not part of the frame
+        auto frame_start = Profiler::Clock::now();
         event_queue_.pollEvents();
         KeyboardShortCut::dispatchShortcuts();
 
@@ -199,6 +202,7 @@ bool Rendering::Application::loop() {
         JobScheduler::getInstance().finalizeJobs();
 
         glfwSwapBuffers(main_window);
+        Profiler::getInstance().addFrame(frame_start, Profiler::Clock::now());
 
         if (glfwWindowShouldClose(main_window)) {
             scheduler_.abortAll();
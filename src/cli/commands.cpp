@@ -0,0 +1,264 @@
+#include "python/py_api.h"
+#include "python/init_python.h"
+
+#include "commands.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <filesystem>
+#include <functional>
+
+#include "jobscheduler.h"
+#include "settings.h"
+#include "core/dataset/explore.h"
+#include "core/project/project.h"
+#include "core/project/project_manager.h"
+#include "core/segmentation/batch.h"
+#include "core/segmentation/segmentation.h"
+
+namespace fs = std::filesystem;
+using core::project::Project;
+using core::project::ProjectManager;
+using core::segmentation::Segmentation;
+
+namespace cli {
+    namespace {
+        // The commands wait for their jobs as long as needed
+        const double WAIT_TIMEOUT_S = 30 * 24 * 3600;
+
+        /**
+         * Opens a project with its dataset and segmentations, without the ProjectManager (no recent files)
+         */
+        std::shared_ptr<Project> open_project(const std::string& filename, std::string& error_msg) {
+            std::shared_ptr<Project> project;
+            try {
+                project = ProjectManager::readProjectFile(filename);
+            }
+            catch (const std::exception& e) {
+                error_msg = e.what();
+                return nullptr;
+            }
+            error_msg = project->getDataset().load(filename);
+            if (error_msg.empty())
+                error_msg = project->loadSegmentations();
+            return error_msg.empty() ? project : nullptr;
+        }
+
+        std::shared_ptr<Segmentation> find_segmentation(Project& project, const std::string& name, bool create,
+                                                        std::string& error_msg) {
+            for (auto& segmentation : project.getSegmentations()) {
+                if (segmentation->getName() == name)
+                    return segmentation;
+            }
+            if (!create) {
+                error_msg = "No segmentation named '" + name + "' in the project";
+                return nullptr;
+            }
+            // Same as the New segmentation modal
+            auto segmentation = std::make_shared<Segmentation>(name, "");
+            error_msg = project.addSegmentation(segmentation);
+            if (error_msg.empty())
+                error_msg = project.saveSegmentations();
+            return error_msg.empty() ? segmentation : nullptr;
+        }
+
+        /**
+         * Runs a batch operation on all the cases of the project and waits for it
+         * @return true if no case failed
+         */
+        bool run_batch(Project& project, const std::shared_ptr<Segmentation>& segmentation,
+                       const std::shared_ptr<const core::segmentation::BatchOperation>& operation) {
+            auto progress = std::make_shared<core::segmentation::BatchProgress>();
+            std::shared_ptr<core::segmentation::BatchResult> result;
+            core::segmentation::runBatchOperation(
+                    segmentation, project.getDataset().getOrderedDicoms(), project.getRoot(), operation, progress,
+                    [&result](const std::shared_ptr<JobResult>& job_result) {
+                        result = std::dynamic_pointer_cast<core::segmentation::BatchResult>(job_result);
+                    });
+            JobScheduler::getInstance().runUntil([&result] { return result != nullptr; }, WAIT_TIMEOUT_S, [&] {
+                std::cout << operation->getName() << ": " << progress->num_done << " / " << progress->num_cases
+                          << std::endl;
+            });
+
+            std::cout << operation->getName() << ": " << progress->num_cases << " cases, " << progress->num_modified
+                      << " modified, " << progress->num_skipped << " skipped, " << progress->num_failed << " failed"
+                      << std::endl;
+            if (!result->error_msg.empty())
+                std::cerr << result->error_msg << std::endl;
+            return result->success;
+        }
+    }
+
+    std::string Arguments::get(const std::string& name, const std::string& default_value) const {
+        auto it = options.find(name);
+        return it == options.end() ? default_value : it->second;
+    }
+
+    int Arguments::getInt(const std::string& name, int default_value) const {
+        auto it = options.find(name);
+        return it == options.end() ? default_value : std::stoi(it->second);
+    }
+
+    Arguments parseArguments(int argc, char** argv, int first, const std::set<std::string>& flags, std::string& error_msg) {
+        Arguments arguments;
+        for (int i = first; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg.rfind("--", 0) != 0) {
+                arguments.positional.push_back(arg);
+            }
+            else if (flags.count(arg)) {
+                arguments.flags.insert(arg);
+            }
+            else if (i + 1 < argc) {
+                arguments.options[arg] = argv[++i];
+            }
+            else {
+                error_msg = "Missing value for '" + arg + "'";
+            }
+        }
+        return arguments;
+    }
+
+    int newProject(const Arguments& arguments) {
+        if (arguments.positional.size() != 2) {
+            std::cerr << "Usage: new <directory> <name> [--description text]" << std::endl;
+            return 2;
+        }
+        auto project = std::make_shared<Project>(arguments.positional[1], arguments.get("--description"));
+        std::string filename;
+        if (!project->setUpWorkspace(arguments.positional[0], project->getName(), STRING(PROJECT_EXTENSION), filename)) {
+            std::cerr << filename << std::endl;
+            return 1;
+        }
+        if (!ProjectManager::writeProjectFile(project, filename)) {
+            std::cerr << "Could not write '" << filename << "'" << std::endl;
+            return 1;
+        }
+        std::cout << filename << std::endl;
+        return 0;
+    }
+
+    int importDicoms(const Arguments& arguments) {
+        if (arguments.positional.size() < 2) {
+            std::cerr << "Usage: import <project file> <DICOM directory>... [--group name] [--replace]" << std::endl;
+            return 2;
+        }
+        std::string error_msg;
+        auto project = open_project(arguments.positional[0], error_msg);
+        if (project == nullptr) {
+            std::cerr << error_msg << std::endl;
+            return 1;
+        }
+
+        // The images that can not be decoded natively are imported by Python
+        PyAPI::Handler::getInstance();
+        PyAPI::init();
+
+        auto& scheduler = JobScheduler::getInstance();
+        auto& dataset = project->getDataset();
+        auto& group = dataset.createGroup(arguments.get("--group", "default"));
+        for (size_t i = 1; i < arguments.positional.size(); i++) {
+            const std::string& directory = arguments.positional[i];
+            core::dataset::Explore explore;
+            explore.findDicoms(directory);
+            scheduler.runUntil([&scheduler] { return !scheduler.isBusy(); });
+            // The last cases are inserted in the tree, as by the next frame of the app
+            while (explore.update());
+            if (explore.getStatus() == core::dataset::Explore::EXPLORE_ERROR) {
+                std::cerr << "Could not explore '" << directory << "'" << std::endl;
+                return 1;
+            }
+            if (explore.getCases()->empty()) {
+                std::cout << directory << ": no DICOM found" << std::endl;
+                continue;
+            }
+
+            std::shared_ptr<core::dataset::ImportResult> result;
+            dataset.importData(group, explore.getCases(), project->getRoot(),
+                               [&result](const std::shared_ptr<JobResult>& job_result) {
+                                   result = std::dynamic_pointer_cast<core::dataset::ImportResult>(job_result);
+                               }, arguments.has("--replace"));
+            scheduler.runUntil([&result] { return result != nullptr; }, WAIT_TIMEOUT_S, [&dataset] {
+                int num_done = 0, num_images = 0;
+                for (auto& series : dataset.getImportProgress()) {
+                    num_done += series->num_done;
+                    num_images += series->num_images;
+                }
+                std::cout << "Import: " << num_done << " / " << num_images << " images" << std::endl;
+            });
+            if (!result->success) {
+                std::cerr << result->error_msg << std::endl;
+                return 1;
+            }
+
+            // As when the import modal is closed
+            error_msg = dataset.registerFiles(result->save_paths, group, project->getRoot());
+            if (!error_msg.empty()) {
+                std::cerr << error_msg << std::endl;
+                return 1;
+            }
+            std::cout << directory << ": " << result->save_paths.size() << " series imported, "
+                      << result->existing.size() << " already in the project" << std::endl;
+        }
+        return 0;
+    }
+
+    int threshold(const Arguments& arguments) {
+        if (arguments.positional.size() != 2) {
+            std::cerr << "Usage: threshold <project file> <segmentation> [--min-hu -29] [--max-hu 150] [--closing 0]"
+                         " [--opening 0] [--min-object-size 0] [--overwrite]" << std::endl;
+            return 2;
+        }
+        std::shared_ptr<core::segmentation::HuThresholdOperation> operation;
+        try {
+            operation = std::make_shared<core::segmentation::HuThresholdOperation>(
+                    arguments.getInt("--min-hu", -29), arguments.getInt("--max-hu", 150),
+                    arguments.getInt("--closing", 0), arguments.getInt("--opening", 0),
+                    arguments.getInt("--min-object-size", 0), arguments.has("--overwrite"));
+        }
+        catch (const std::logic_error&) {
+            std::cerr << "Invalid number in the arguments" << std::endl;
+            return 2;
+        }
+
+        std::string error_msg;
+        auto project = open_project(arguments.positional[0], error_msg);
+        auto segmentation = project ? find_segmentation(*project, arguments.positional[1], true, error_msg) : nullptr;
+        if (segmentation == nullptr) {
+            std::cerr << error_msg << std::endl;
+            return 1;
+        }
+        return run_batch(*project, segmentation, operation) ? 0 : 1;
+    }
+
+    int exportMasks(const Arguments& arguments) {
+        if (arguments.positional.size() != 3) {
+            std::cerr << "Usage: export <project file> <segmentation> <directory> [--stats file]" << std::endl;
+            return 2;
+        }
+        std::string error_msg;
+        auto project = open_project(arguments.positional[0], error_msg);
+        auto segmentation = project ? find_segmentation(*project, arguments.positional[1], false, error_msg) : nullptr;
+        if (segmentation == nullptr) {
+            std::cerr << error_msg << std::endl;
+            return 1;
+        }
+
+        const std::string& directory = arguments.positional[2];
+        bool success = run_batch(*project, segmentation,
+                                 std::make_shared<core::segmentation::ExportOperation>(directory));
+
+        auto statistics = std::make_shared<core::segmentation::StatisticsOperation>();
+        success = run_batch(*project, segmentation, statistics) && success;
+        std::error_code error;
+        fs::create_directories(directory, error);
+        std::string filename = arguments.get("--stats", (fs::path(directory) / "statistics.csv").string());
+        error_msg = statistics->writeCSV(filename);
+        if (!error_msg.empty()) {
+            std::cerr << error_msg << std::endl;
+            return 1;
+        }
+        std::cout << "Statistics written in " << filename << std::endl;
+        return success ? 0 : 1;
+    }
+}
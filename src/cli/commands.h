@@ -0,0 +1,61 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace cli {
+    /**
+     * Arguments of a command : positional arguments, options (--name value) and flags (--name)
+     */
+    struct Arguments {
+        std::vector<std::string> positional;
+        std::map<std::string, std::string> options;
+        std::set<std::string> flags;
+
+        /**
+         * @return value of the option, or default_value if it has not been given
+         */
+        std::string get(const std::string& name, const std::string& default_value = "") const;
+        /**
+         * @throw std::invalid_argument or std::out_of_range if the value is not an integer
+         */
+        int getInt(const std::string& name, int default_value) const;
+        bool has(const std::string& flag) const { return flags.count(flag) > 0; }
+    };
+
+    /**
+     * Parses the arguments that follow the command
+     * @param flags names of the options that do not take a value
+     * @param error_msg set if an option has no value
+     */
+    Arguments parseArguments(int argc, char** argv, int first, const std::set<std::string>& flags, std::string& error_msg);
+
+    /**
+     * new <directory> <name> [--description text]
+     * Creates the workspace of a project (same as the New project modal)
+     */
+    int newProject(const Arguments& arguments);
+
+    /**
+     * import <project file> <DICOM directory>... [--group name] [--replace]
+     * Explores the directories and imports all the series that have been found into the project
+     */
+    int importDicoms(const Arguments& arguments);
+
+    /**
+     * threshold <project file> <segmentation> [--min-hu -29] [--max-hu 150] [--closing 0] [--opening 0]
+     *           [--min-object-size 0] [--overwrite]
+     * Generates the current mask of all the cases of the project (see HuThresholdOperation), the segmentation is
+     * created if it does not exist
+     */
+    int threshold(const Arguments& arguments);
+
+    /**
+     * export <project file> <segmentation> <directory> [--stats file]
+     * Exports the masks as png (see ExportOperation) and their statistics as CSV (by default
+     * <directory>/statistics.csv)
+     */
+    int exportMasks(const Arguments& arguments);
+}
@@ -0,0 +1,60 @@
+#include <thread>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "commands.h"
+#include "jobscheduler.h"
+
+namespace {
+    void print_usage() {
+        std::cerr << "Usage: BM-Segmenter-cli <command> [arguments] [--workers N]\n"
+                     "Commands:\n"
+                     "  new <directory> <name> [--description text]\n"
+                     "  import <project file> <DICOM directory>... [--group name] [--replace]\n"
+                     "  threshold <project file> <segmentation> [--min-hu -29] [--max-hu 150] [--closing 0]\n"
+                     "            [--opening 0] [--min-object-size 0] [--overwrite]\n"
+                     "  export <project file> <segmentation> <directory> [--stats file]" << std::endl;
+    }
+}
+
+/**
+ * Command line version of BM-Segmenter, for processing projects without a display (no window is created)
+ *
+ * The commands run the same jobs as the app, on all the cores by default.
+ */
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        print_usage();
+        return 2;
+    }
+    std::string command = argv[1];
+
+    std::string error_msg;
+    auto arguments = cli::parseArguments(argc, argv, 2, {"--replace", "--overwrite"}, error_msg);
+    if (!error_msg.empty()) {
+        std::cerr << error_msg << std::endl;
+        return 2;
+    }
+
+    int num_workers;
+    try {
+        num_workers = arguments.getInt("--workers", (int)std::thread::hardware_concurrency());
+    }
+    catch (const std::logic_error&) {
+        std::cerr << "Invalid number for '--workers'" << std::endl;
+        return 2;
+    }
+    JobScheduler::getInstance().setWorkerPoolSize(std::max(num_workers, 1));
+
+    if (command == "new")
+        return cli::newProject(arguments);
+    if (command == "import")
+        return cli::importDicoms(arguments);
+    if (command == "threshold")
+        return cli::threshold(arguments);
+    if (command == "export")
+        return cli::exportMasks(arguments);
+    print_usage();
+    return 2;
+}
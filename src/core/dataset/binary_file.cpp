@@ -0,0 +1,51 @@
+#include "binary_file.h"
+
+#include <fstream>
+#include <filesystem>
+
+namespace core {
+    namespace dataset {
+        void writeU64(std::ostream &out, uint64_t value) {
+            out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+        }
+
+        void writeString(std::ostream &out, const std::string &str) {
+            writeU64(out, str.size());
+            out.write(str.data(), (std::streamsize) str.size());
+        }
+
+        bool readU64(std::istream &in, uint64_t &value) {
+            in.read(reinterpret_cast<char *>(&value), sizeof(value));
+            return (size_t) in.gcount() == sizeof(value);
+        }
+
+        bool readString(std::istream &in, std::string &str, uint64_t max_size) {
+            uint64_t size;
+            if (!readU64(in, size) || size > max_size)
+                return false;
+            str.resize(size);
+            if (size == 0)
+                return true;
+            in.read(&str[0], (std::streamsize) size);
+            return (uint64_t) in.gcount() == size;
+        }
+
+        std::string writeFileAtomically(const std::string &filename, const std::function<void(std::ostream &)> &write_fct,
+                                        std::ios::openmode mode) {
+            std::string tmp_filename = filename + ".tmp";
+            {
+                std::ofstream file(tmp_filename, mode | std::ios::out | std::ios::trunc);
+                if (!file)
+                    return "Could not open '" + tmp_filename + "'";
+                write_fct(file);
+                if (!file)
+                    return "Could not write '" + tmp_filename + "'";
+            }
+            std::error_code error;
+            std::filesystem::rename(tmp_filename, filename, error);
+            if (error)
+                return "Could not write '" + filename + "': " + error.message();
+            return "";
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <functional>
+
+namespace core {
+    namespace dataset {
+        /**
+         * Values of the binary caches of the app (scan index, directory manifest), in the byte order of the machine
+         */
+        void writeU64(std::ostream &out, uint64_t value);
+        void writeString(std::ostream &out, const std::string &str);
+        bool readU64(std::istream &in, uint64_t &value);
+        /**
+         * @param max_size strings announced as longer are considered as corrupted
+         * @return false if the string could not be read entirely
+         */
+        bool readString(std::istream &in, std::string &str, uint64_t max_size);
+
+        /**
+         * Writes a file in a temporary file first, which then replaces the file, so that the previous version stays
+         * usable if anything goes wrong
+         * @param write_fct writes the content, the file is not replaced if the stream is in error afterwards
+         * @return error message, empty if the file has been written
+         */
+        std::string writeFileAtomically(const std::string &filename, const std::function<void(std::ostream &)> &write_fct,
+                                        std::ios::openmode mode = std::ios::binary);
+    }
+}
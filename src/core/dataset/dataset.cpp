@@ -1,14 +1,15 @@
+#include <map>
+#include <set>
 #include <unordered_map>
 #include <toml.hpp>
 #include <fstream>
-
-#include "python/py_api.h"
-#include "pybind11/numpy.h"
-#include "pybind11/stl.h"
+#include <filesystem>
+#include <thread>
 
 #include "dataset.h"
-
-namespace py = pybind11;
+#include "directory_manifest.h"
+#include "binary_file.h"
+#include "log.h"
 
 core::dataset::Group::Group(const std::string& name) : name_(name) {
 
@@ -22,70 +23,87 @@ bool core::dataset::Group::operator!=(const Group& other) {
     return other.name_ != name_;
 }
 
-std::vector<std::shared_ptr<core::DicomSeries>> core::dataset::Group::getOrderedDicoms() {
-    std::vector<std::shared_ptr<DicomSeries>> vector;
-    for (auto& series : dicoms_) {
-        vector.push_back(series);
+const std::vector<std::shared_ptr<core::DicomSeries>>& core::dataset::Group::getOrderedDicoms() {
+    if (!ordered_valid_) {
+        ordered_dicoms_.assign(dicoms_.begin(), dicoms_.end());
+        ordered_valid_ = true;
     }
-    return vector;
+    return ordered_dicoms_;
 }
 
 void core::dataset::Group::addDicom(std::shared_ptr<DicomSeries> dicom) {
 	dicoms_.insert(dicom);
+	ordered_valid_ = false;
 }
 
 void core::dataset::Group::removeDicom(std::shared_ptr<DicomSeries> dicom) {
 	dicoms_.erase(dicom);
+	ordered_valid_ = false;
 }
 
 std::string core::dataset::Dataset::load(const std::string& path) {
     dicoms_.clear();
+    ordered_dicoms_.clear();
     groups_.clear();
 
     std::cout << "Load dataset" << std::endl;
 
-    auto state = PyGILState_Ensure();
+    std::filesystem::path root = std::filesystem::path(path).parent_path();
+    std::filesystem::path filename = root / "dataset.toml";
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(filename, error)) {
+        is_loaded_ = true;
+        return "";
+    }
 
-    py::module scripts;
-    bool skip = false;
     try {
-        py::module import_data = py::module::import("python.scripts.dataset");
-        py::tuple tuple = import_data.attr("load_dataset")(path);
-        py::dict data = tuple[0].cast<py::dict>();
-        auto& groups = tuple[1].cast<std::vector<std::string>>();
-
-        // Create the groups
-        for (auto& group_name : groups) {
-            createGroup(group_name);
+        // Ordered table, so that the groups always come in the same order
+        const auto data = toml::parse<toml::discard_comments, std::map, std::vector>(filename.string());
+        if (!data.is_table() || data.as_table().count("groups") == 0 || data.as_table().count("files") == 0) {
+            is_loaded_ = true;
+            return "";
         }
-        
-        for (auto& pair : data) {
-            std::string id = pair.first.cast<std::string>();
-            py::dict file_info = pair.second.cast<py::dict>();
-            
-            auto file = file_info["files"].cast<std::vector<std::string>>();
-            
-            auto dicom = std::make_shared<DicomSeries>(file, id, DicomSeries::F_NP);
-            dicoms_.insert(dicom);
-            for (auto& group : file_info["groups"].cast<py::list>()) {
-                std::string group_name = group.cast<std::string>();
-                for (auto& current_group : groups_) {
-                    if (current_group.getName() == group_name) {
-                        current_group.addDicom(dicom);
-                        break;
-                    }
+
+        // Groups of each file, in one pass over the groups
+        std::unordered_map<std::string, std::vector<size_t>> file_groups;
+        for (auto& group : toml::find(data, "groups").as_table()) {
+            size_t group_idx = groups_.size();
+            createGroup(group.first);
+            for (auto& id : toml::get<std::vector<std::string>>(group.second)) {
+                file_groups[id].push_back(group_idx);
+            }
+        }
+
+        // The images of each series are only listed when the series is needed
+        for (auto& id : toml::find<std::vector<std::string>>(data, "files")) {
+            std::string directory = (root / "data" / "dicoms" / id).string();
+            auto dicom = std::make_shared<DicomSeries>(DicomSeries::F_NP);
+            dicom->setId(id);
+            dicom->setPathsLoader([directory]() {
+                std::vector<std::string> names;
+                std::string error = listDirectory(directory, names);
+                if (!error.empty())
+                    BM_DEBUG(error);
+                std::vector<std::string> files;
+                files.reserve(names.size());
+                for (auto& name : names) {
+                    files.push_back((std::filesystem::path(directory) / name).string());
                 }
+                return files;
+            });
+
+            dicoms_.insert(dicom);
+            for (auto group_idx : file_groups[id]) {
+                groups_[group_idx].addDicom(dicom);
             }
         }
+        ordered_dicoms_.assign(dicoms_.begin(), dicoms_.end());
     }
     catch (const std::exception& e) {
-        std::string err = e.what();
-        PyGILState_Release(state);
         is_loaded_ = false;
-        return err;
+        return e.what();
     }
     is_loaded_ = true;
-    PyGILState_Release(state);
     return "";
 }
 
@@ -99,104 +117,124 @@ core::dataset::Group& core::dataset::Dataset::createGroup(const std::string& nam
 }
 
 jobId& core::dataset::Dataset::importData(const Group& group, std::shared_ptr<std::vector<::core::dataset::PatientNode>> cases, const std::string& root_path, jobResultFct result_fct, bool replace) {
-    jobFct job_fct = [=](float& progress, bool& abort) -> std::shared_ptr<JobResult> {
-        auto import_result = std::make_shared<ImportResult>();
-
-        std::vector<DicomSeries> all_cases;
-
-        // Flatten all the selected cases
-        int num_images = 0;
-        for (auto& patient : *cases) {
-            for (auto& study : patient.study) {
-                for (auto& series : study.series) {
-                    bool is_active = series->is_active && study.is_active && patient.is_active;
-                    if (is_active) {
-                        std::vector<std::string> paths;
-                        for (auto& image : series->images) {
-                            if (image.is_active) {
-                                num_images++;
-                                paths.push_back(image.path);
-                            }
-                        }
-                        if (!paths.empty()) {
-                            auto &dicom = DicomSeries(paths, patient.ID + std::string("___") + std::to_string(
-                                std::hash<std::string>{}(study.date + study.description + study.time + series->modality + series->number)));
-                            dicom.setCrops(series->data.getCropX(), series->data.getCropY(), true);
-                            all_cases.emplace_back(dicom);
+    // Flatten all the selected cases here, as the tree belongs to the UI
+    auto all_series = std::make_shared<std::vector<ImportSeries>>();
+    auto all_cases = std::make_shared<std::vector<DicomSeries>>();
+    import_progress_.clear();
+    for (auto& patient : *cases) {
+        for (auto& study : patient.study) {
+            for (auto& series : study.series) {
+                bool is_active = series->is_active && study.is_active && patient.is_active;
+                if (is_active) {
+                    std::vector<std::string> paths;
+                    for (auto& image : series->images) {
+                        if (image.is_active) {
+                            paths.push_back(image.path);
                         }
                     }
+                    if (!paths.empty()) {
+                        DicomSeries dicom(paths, patient.ID + std::string("___") + std::to_string(
+                            std::hash<std::string>{}(study.date + study.description + study.time + series->modality + series->number)));
+                        dicom.setCrops(series->data.getCropX(), series->data.getCropY(), true);
+
+                        ImportSeries import_series;
+                        import_series.progress = std::make_shared<SeriesImportProgress>();
+                        import_series.progress->id = dicom.getId();
+                        import_series.progress->num_images = paths.size();
+                        import_series.paths = paths;
+                        import_series.window_width = dicom.getWW();
+                        import_series.window_center = dicom.getWC();
+                        import_series.crop_x = dicom.getCropX();
+                        import_series.crop_y = dicom.getCropY();
+
+                        import_progress_.push_back(import_series.progress);
+                        all_series->push_back(import_series);
+                        all_cases->push_back(dicom);
+                    }
                 }
             }
         }
+    }
 
-        int i = 0;
-        std::string error_msg;
-        bool failure = false;
-
-        std::vector<DicomSeries> existing;
-        std::vector<std::string> save_paths;
-        import_result->success = true;
-        auto state = PyGILState_Ensure();
-        for (auto& dicom : all_cases) {
-            if (failure)
-                break;
-
-            py::module scripts;
-            bool skip = false;
-            try {
-                scripts = py::module::import("python.scripts.import_data");
-                py::module create = py::module::import("python.scripts.workspace");
-                py::tuple ret = create.attr("create_series_dir")(root_path, dicom.getId());
-                if (!ret[1].cast<bool>() && !replace) {
-                    import_result->existing.push_back(dicom);
-                    skip = true;
+    jobFct job_fct = [=](float& progress, bool& abort) -> std::shared_ptr<JobResult> {
+        auto import_result = std::make_shared<ImportResult>();
+        auto& series_list = *all_series;
+
+        // Same directories as create_series_dir in workspace.py
+        std::filesystem::path root(root_path);
+        try {
+            for (auto& directory : { root / "data" / "dicoms", root / "data" / "masks", root / "tmp" / "train" / "x",
+                                     root / "tmp" / "train" / "y", root / "models" }) {
+                std::filesystem::create_directories(directory);
+            }
+            for (size_t i = 0; i < series_list.size(); i++) {
+                auto& series = series_list[i];
+                auto directory = root / "data" / "dicoms" / series.progress->id;
+                series.created_directory = std::filesystem::create_directory(directory);
+                series.directory = directory.string();
+                series.journal = std::make_shared<ImportJournal>(root_path, series.progress->id, series.directory);
+
+                std::string journal_error;
+                if (series.created_directory || replace) {
+                    journal_error = series.journal->start(series.paths);
+                }
+                // A series whose import has been interrupted is resumed where it stopped
+                else if (series.journal->load(series.paths) == ImportJournal::JOURNAL_INCOMPLETE) {
+                    journal_error = series.journal->resume();
                 }
                 else {
-                    import_result->save_paths.push_back(ret[0].cast<std::string>());
+                    series.progress->skipped = true;
+                    import_result->existing.push_back((*all_cases)[i]);
+                }
+                if (!journal_error.empty()) {
+                    import_result->error_msg = journal_error;
+                    import_result->success = false;
+                    return import_result;
                 }
             }
-            catch (const std::exception& e) {
-                import_result->error_msg = e.what();
-                failure = true;
-            }
-
-            if (!skip) {
-                int img_num = 0;
-                for (auto& path : dicom.getPaths()) {
-                    if (failure)
-                        break;
-                    if (abort) {
-                        failure = true;
-                        import_result->error_msg = "Job canceled";
-                        break;
-                    }
+        }
+        catch (const std::filesystem::filesystem_error& e) {
+            import_result->error_msg = e.what();
+            import_result->success = false;
+            return import_result;
+        }
 
-                    try {
-                        std::vector<float> crop_x = { dicom.getCropX().x, dicom.getCropX().y };
-                        std::vector<float> crop_y = { dicom.getCropY().x, dicom.getCropY().y };
-                        scripts.attr("import_dicom")(path, root_path, dicom.getId(), img_num, dicom.getWW(), dicom.getWC(), crop_x, crop_y, replace);
-                    }
-                    catch (const std::exception& e) {
-                        std::cout << e.what() << std::endl;
-                        import_result->error_msg = e.what();
-                        failure = true;
-                    }
+        // The images are spread on all the workers, this job being one of them
+        auto& scheduler = JobScheduler::getInstance();
+        int num_helpers = std::max(scheduler.getNumberOfWorkers() - 1, 0);
+        ImportPipeline pipeline(series_list, root_path, 2 * (num_helpers + 1));
+        auto caller = std::this_thread::get_id();
+        scheduler.parallelRun("import_data_helper", num_helpers, [&](bool& abort) {
+            pipeline.run(abort, std::this_thread::get_id() == caller ? &progress : nullptr);
+        }, abort);
 
-                    img_num++;
+        import_result->success = true;
+        if (abort) {
+            import_result->error_msg = "Job canceled";
+            import_result->success = false;
+        }
+        else if (pipeline.hasFailed()) {
+            import_result->error_msg = pipeline.getError();
+            import_result->success = false;
+        }
 
-                    // Update progress
-                    i++;
-                    progress = float(i) / float(num_images);
-                }
+        for (auto& series : series_list) {
+            if (series.progress->skipped)
+                continue;
+            // A cancelled series is removed, unless it replaced a series of the project
+            if (series.progress->cancel && series.created_directory) {
+                std::error_code error;
+                std::filesystem::remove_all(series.directory, error);
+                series.journal->remove();
+                continue;
             }
-            else {
-                i += dicom.getPaths().size();
+            // Otherwise, the journal is kept so that an interrupted import can be resumed
+            if (series.progress->num_done == series.progress->num_images) {
+                std::string journal_error = series.journal->complete();
+                if (!journal_error.empty())
+                    std::cout << journal_error << std::endl;
             }
-        }
-        PyGILState_Release(state);
-
-        if (failure) {
-            import_result->success = false;
+            import_result->save_paths.push_back(series.directory);
         }
         return import_result;
     };
@@ -206,23 +244,55 @@ jobId& core::dataset::Dataset::importData(const Group& group, std::shared_ptr<st
 }
 
 std::string core::dataset::Dataset::registerFiles(std::vector<std::string> paths, const Group& group, const std::string& root_path) {
-    auto state = PyGILState_Ensure();
-
+    // Same as add_to_dataset in import_data.py
     std::cout << "Save dataset" << std::endl;
-    py::module scripts;
-    bool skip = false;
+    std::filesystem::path filename = std::filesystem::path(root_path) / "dataset.toml";
+
+    std::set<std::string> files;
+    std::map<std::string, std::set<std::string>> groups;
     try {
-        py::module import_data = py::module::import("python.scripts.import_data");
-        import_data.attr("add_to_dataset")(paths, group.getName(), root_path);
+        std::error_code error;
+        if (std::filesystem::is_regular_file(filename, error)) {
+            const auto data = toml::parse<toml::discard_comments, std::map, std::vector>(filename.string());
+            if (data.is_table() && data.as_table().count("files")) {
+                for (auto& id : toml::find<std::vector<std::string>>(data, "files")) {
+                    files.insert(id);
+                }
+            }
+            if (data.is_table() && data.as_table().count("groups")) {
+                for (auto& saved_group : toml::find(data, "groups").as_table()) {
+                    auto& ids = groups[saved_group.first];
+                    for (auto& id : toml::get<std::vector<std::string>>(saved_group.second)) {
+                        ids.insert(id);
+                    }
+                }
+            }
+        }
     }
     catch (const std::exception& e) {
-        std::string err = e.what();
-        PyGILState_Release(state);
-        return err;
+        return e.what();
     }
 
-    PyGILState_Release(state);
-    return "";
+    auto& group_files = groups[group.getName()];
+    for (auto& path : paths) {
+        std::string name = std::filesystem::path(path).filename().string();
+        files.insert(name);
+        group_files.insert(name);
+    }
+
+    toml::table groups_table;
+    for (auto& saved_group : groups) {
+        groups_table[saved_group.first] = toml::value(std::vector<std::string>(saved_group.second.begin(), saved_group.second.end()));
+    }
+    const toml::value data{
+            {"files", std::vector<std::string>(files.begin(), files.end())},
+            {"groups", groups_table}
+    };
+
+    // The dataset stays readable if anything goes wrong
+    return writeFileAtomically(filename.string(), [&data](std::ostream& file) {
+        file << data << std::endl;
+    }, std::ios::out);
 }
 
 std::string core::dataset::Dataset::save(const std::string& root_path) {
@@ -238,11 +308,3 @@ std::string core::dataset::Dataset::save(const std::string& root_path) {
     }
     return "";
 }
-
-std::vector<std::shared_ptr<::core::DicomSeries>> core::dataset::Dataset::getOrderedDicoms() {
-    std::vector<std::shared_ptr<DicomSeries>> vector;
-    for (auto& series : dicoms_) {
-        vector.push_back(series);
-    }
-    return vector;
-}
@@ -9,6 +9,7 @@
 
 #include "core/dicom.h"
 #include "explore.h"
+#include "import_pipeline.h"
 
 #include "events.h"
 #include "jobscheduler.h"
@@ -21,6 +22,10 @@ namespace core {
         private:
             std::string name_;
             dicom_set dicoms_;
+
+            // Ordered view of dicoms_, rebuilt only when the group changes
+            std::vector<std::shared_ptr<DicomSeries>> ordered_dicoms_;
+            bool ordered_valid_ = true;
         public:
             Group(const std::string& name);
 
@@ -29,8 +34,12 @@ namespace core {
 
             const std::string& getName() const { return name_; }
 
-            std::vector<std::shared_ptr<DicomSeries>> getOrderedDicoms();
-            dicom_set& getDicoms() { return dicoms_; }
+            /**
+             * Series of the group, in the order of OrderDicom
+             * The vector is cached, it stays valid until the group is modified
+             */
+            const std::vector<std::shared_ptr<DicomSeries>>& getOrderedDicoms();
+            const dicom_set& getDicoms() const { return dicoms_; }
 
             void addDicom(std::shared_ptr<DicomSeries> dicom);
             void removeDicom(std::shared_ptr<DicomSeries> dicom);
@@ -49,6 +58,9 @@ namespace core {
         private:
             std::vector<Group> groups_;
             dicom_set dicoms_;
+            std::vector<std::shared_ptr<DicomSeries>> ordered_dicoms_;
+
+            std::vector<std::shared_ptr<SeriesImportProgress>> import_progress_;
 
             bool is_loaded_ = false;
 
@@ -61,17 +73,28 @@ namespace core {
 
             /**
              * Whenever importData is called, a new job is launched.
+             *
+             * The images are imported in parallel by an ImportPipeline, on all the workers of the JobScheduler.
+             * The progress of each series is available with getImportProgress until the next call.
              * @return the job reference created in the findDicoms function
              */
             jobId& importData(const Group& group, std::shared_ptr<std::vector<::core::dataset::PatientNode>> cases, const std::string& root_path, jobResultFct result_fct, bool replace=false);
 
+            /**
+             * Progress of the series of the last import, a series can be cancelled with its cancel flag
+             */
+            const std::vector<std::shared_ptr<SeriesImportProgress>>& getImportProgress() const { return import_progress_; }
+
             std::string registerFiles(std::vector<std::string> paths, const Group& group, const std::string& root_path);
 
             std::string save(const std::string& root_path);
 
             std::vector<Group>& getGroups() { return groups_; }
-            dicom_set& getDicoms() { return dicoms_; }
-            std::vector<std::shared_ptr<::core::DicomSeries>> getOrderedDicoms();
+            const dicom_set& getDicoms() const { return dicoms_; }
+            /**
+             * All the series of the dataset, in the order of OrderDicom (built when the dataset is loaded)
+             */
+            const std::vector<std::shared_ptr<::core::DicomSeries>>& getOrderedDicoms() const { return ordered_dicoms_; }
         };
     }
 }
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include "dicom_header.h"
+#include "dicom_parser.h"
+
+namespace core {
+    namespace dataset {
+        namespace {
+            const uint32_t TAG_STUDY_DATE = 0x00080020;
+            const uint32_t TAG_STUDY_TIME = 0x00080030;
+            const uint32_t TAG_MODALITY = 0x00080060;
+            const uint32_t TAG_STUDY_DESCRIPTION = 0x00081030;
+            const uint32_t TAG_PATIENT_ID = 0x00100020;
+            const uint32_t TAG_SERIES_NUMBER = 0x00200011;
+            const uint32_t TAG_INSTANCE_NUMBER = 0x00200013;
+        }
+
+        DicomHeaderStatus readDicomHeader(const std::string &path, DicomHeader &header, std::string &error_msg) {
+            DicomParser parser(path);
+            try {
+                if (!parser.open())
+                    return HEADER_NOT_DICOM;
+                header.transferSyntax = parser.getTransferSyntax();
+                header.is_dicomdir = parser.isDicomdir();
+
+                // Data set, up to the pixel data
+                DicomElement element;
+                while (parser.next(element)) {
+                    if (element.tag == DICOM_TAG_PIXEL_DATA) {
+                        header.has_pixel_data = true;
+                        break;
+                    }
+                    switch (element.tag) {
+                        case TAG_PATIENT_ID:
+                            header.patientID = parser.readString(element.length);
+                            break;
+                        case TAG_STUDY_DATE:
+                            header.studyDate = parser.readString(element.length);
+                            break;
+                        case TAG_STUDY_TIME:
+                            header.studyTime = parser.readString(element.length);
+                            break;
+                        case TAG_STUDY_DESCRIPTION:
+                            header.studyDescription = parser.readString(element.length);
+                            break;
+                        case TAG_SERIES_NUMBER:
+                            header.seriesNumber = parser.readString(element.length);
+                            break;
+                        case TAG_MODALITY:
+                            header.modality = parser.readString(element.length);
+                            break;
+                        case TAG_INSTANCE_NUMBER:
+                            header.instanceNumber = parser.readString(element.length);
+                            header.has_instance_number = true;
+                            break;
+                        default:
+                            parser.skip(element.length);
+                    }
+                }
+            }
+            catch (const DicomParseError &e) {
+                error_msg = std::string(e.what()) + " ('" + path + "')";
+                return HEADER_ERROR;
+            }
+            return HEADER_OK;
+        }
+    }
+}
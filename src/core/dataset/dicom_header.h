@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+
+namespace core {
+    namespace dataset {
+        /**
+         * Tags of a DICOM file that are needed to place it in the explorer tree
+         * Here using the DICOM nomenclature (Camel Case)
+         */
+        struct DicomHeader {
+            std::string patientID;
+            std::string studyDate;
+            std::string studyTime;
+            std::string studyDescription;
+            std::string seriesNumber;
+            std::string modality;
+            std::string instanceNumber;
+            std::string transferSyntax;
+
+            bool has_instance_number = false;
+            bool has_pixel_data = false;
+            bool is_dicomdir = false;
+        };
+
+        enum DicomHeaderStatus {HEADER_OK, HEADER_NOT_DICOM, HEADER_ERROR};
+
+        /**
+         * Reads the header of a DICOM Part 10 file without going through the pixel data
+         *
+         * Only the preamble, the file meta information and the data elements placed before PixelData are read,
+         * the reading stops as soon as the PixelData tag is found. Explicit and implicit VR little endian and
+         * explicit VR big endian are supported; sequences of undefined length are skipped.
+         *
+         * @param path path to the file
+         * @param header filled with the tags found in the file
+         * @param error_msg if the file is a DICOM file that could not be read, describes the error
+         * @return HEADER_NOT_DICOM if the file has no DICM prefix, HEADER_ERROR if the file is a malformed or
+         * unsupported DICOM file, HEADER_OK otherwise
+         */
+        DicomHeaderStatus readDicomHeader(const std::string &path, DicomHeader &header, std::string &error_msg);
+    }
+}
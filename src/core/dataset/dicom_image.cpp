@@ -0,0 +1,194 @@
+#include "dicom_image.h"
+#include "dicom_parser.h"
+
+#include <cstdlib>
+#include <cstdint>
+
+namespace core {
+    namespace dataset {
+        namespace {
+            const uint32_t TAG_SLICE_THICKNESS = 0x00180050;
+            const uint32_t TAG_SLICE_LOCATION = 0x00201041;
+            const uint32_t TAG_SAMPLES_PER_PIXEL = 0x00280002;
+            const uint32_t TAG_NUMBER_OF_FRAMES = 0x00280008;
+            const uint32_t TAG_ROWS = 0x00280010;
+            const uint32_t TAG_COLUMNS = 0x00280011;
+            const uint32_t TAG_PIXEL_SPACING = 0x00280030;
+            const uint32_t TAG_BITS_ALLOCATED = 0x00280100;
+            const uint32_t TAG_BITS_STORED = 0x00280101;
+            const uint32_t TAG_PIXEL_REPRESENTATION = 0x00280103;
+            const uint32_t TAG_RESCALE_INTERCEPT = 0x00281052;
+            const uint32_t TAG_RESCALE_SLOPE = 0x00281053;
+
+            /**
+             * First value of a decimal string (multiple values are separated by backslashes)
+             */
+            double decimal(const std::string &value) {
+                return std::strtod(value.c_str(), nullptr);
+            }
+
+            template<typename T>
+            T read_value(const char *ptr, bool little_endian) {
+                unsigned char bytes[sizeof(T)];
+                for (size_t i = 0; i < sizeof(T); i++)
+                    bytes[i] = (unsigned char) ptr[little_endian ? i : sizeof(T) - 1 - i];
+                uint64_t value = 0;
+                for (size_t i = 0; i < sizeof(T); i++)
+                    value |= (uint64_t) bytes[i] << (8 * i);
+                return (T) value;
+            }
+
+            int64_t raw_pixel(const DicomPixels &pixels, size_t index) {
+                int bytes = pixels.bits_allocated / 8;
+                const char *ptr = pixels.data.data() + index * bytes;
+                uint64_t value;
+                switch (bytes) {
+                    case 1:
+                        value = (uint8_t) *ptr;
+                        break;
+                    case 2:
+                        value = read_value<uint16_t>(ptr, pixels.little_endian);
+                        break;
+                    default:
+                        value = read_value<uint32_t>(ptr, pixels.little_endian);
+                }
+                if (!pixels.is_signed)
+                    return (int64_t) value;
+
+                // Sign extension from the stored bits
+                int bits = pixels.bits_stored > 0 && pixels.bits_stored <= pixels.bits_allocated ?
+                           pixels.bits_stored : pixels.bits_allocated;
+                uint64_t sign = (uint64_t) 1 << (bits - 1);
+                value &= (sign << 1) - 1;
+                return (int64_t) ((value ^ sign) - sign);
+            }
+        }
+
+        DicomImageStatus readDicomPixels(const std::string &path, DicomPixels &pixels, std::string &error_msg) {
+            DicomParser parser(path);
+            bool has_pixel_spacing = false;
+            try {
+                if (!parser.open()) {
+                    error_msg = "Invalid DICOM file.";
+                    return IMAGE_ERROR;
+                }
+                const std::string &syntax = parser.getTransferSyntax();
+                if (syntax != DICOM_IMPLICIT_LITTLE_ENDIAN && syntax != DICOM_EXPLICIT_LITTLE_ENDIAN
+                    && syntax != DICOM_EXPLICIT_BIG_ENDIAN) {
+                    return IMAGE_UNSUPPORTED;
+                }
+                pixels.little_endian = parser.isLittleEndian();
+
+                DicomElement element;
+                bool has_pixel_data = false;
+                while (!has_pixel_data && parser.next(element)) {
+                    switch (element.tag) {
+                        case TAG_SAMPLES_PER_PIXEL:
+                            if (parser.readUnsigned(element.length) != 1)
+                                return IMAGE_UNSUPPORTED;
+                            break;
+                        case TAG_NUMBER_OF_FRAMES:
+                            if (std::atoi(parser.readString(element.length).c_str()) > 1)
+                                return IMAGE_UNSUPPORTED;
+                            break;
+                        case TAG_ROWS:
+                            pixels.rows = (int) parser.readUnsigned(element.length);
+                            break;
+                        case TAG_COLUMNS:
+                            pixels.cols = (int) parser.readUnsigned(element.length);
+                            break;
+                        case TAG_BITS_ALLOCATED:
+                            pixels.bits_allocated = (int) parser.readUnsigned(element.length);
+                            break;
+                        case TAG_BITS_STORED:
+                            pixels.bits_stored = (int) parser.readUnsigned(element.length);
+                            break;
+                        case TAG_PIXEL_REPRESENTATION:
+                            pixels.is_signed = parser.readUnsigned(element.length) == 1;
+                            break;
+                        case TAG_PIXEL_SPACING: {
+                            // Same as load_scan_from_dicom, which uses the first value for both directions
+                            pixels.pixel_spacing = decimal(parser.readString(element.length));
+                            has_pixel_spacing = true;
+                            break;
+                        }
+                        case TAG_SLICE_THICKNESS:
+                            pixels.slice_thickness = decimal(parser.readString(element.length));
+                            break;
+                        case TAG_SLICE_LOCATION:
+                            pixels.slice_location = decimal(parser.readString(element.length));
+                            break;
+                        case TAG_RESCALE_INTERCEPT:
+                            pixels.rescale_intercept = decimal(parser.readString(element.length));
+                            break;
+                        case TAG_RESCALE_SLOPE:
+                            pixels.rescale_slope = decimal(parser.readString(element.length));
+                            break;
+                        case DICOM_TAG_PIXEL_DATA: {
+                            // Encapsulated (compressed) pixel data
+                            if (element.length == DICOM_UNDEFINED_LENGTH)
+                                return IMAGE_UNSUPPORTED;
+                            if (pixels.bits_allocated != 8 && pixels.bits_allocated != 16
+                                && pixels.bits_allocated != 32) {
+                                return IMAGE_UNSUPPORTED;
+                            }
+                            size_t expected = (size_t) pixels.rows * pixels.cols * (pixels.bits_allocated / 8);
+                            if (pixels.rows <= 0 || pixels.cols <= 0 || element.length < expected) {
+                                error_msg = "Problem when opening the image in the DICOM file.";
+                                return IMAGE_ERROR;
+                            }
+                            pixels.data.resize(expected);
+                            parser.read(pixels.data.data(), expected);
+                            has_pixel_data = true;
+                            break;
+                        }
+                        default:
+                            parser.skip(element.length);
+                    }
+                }
+                if (!has_pixel_data || !has_pixel_spacing) {
+                    error_msg = "Problem when opening the image in the DICOM file.\n"
+                                " The image should contain pixels and PixelSpacing.";
+                    return IMAGE_ERROR;
+                }
+            }
+            catch (const DicomParseError &e) {
+                error_msg = std::string(e.what()) + " ('" + path + "')";
+                return IMAGE_ERROR;
+            }
+            return IMAGE_OK;
+        }
+
+        void pixelsToHounsfield(const DicomPixels &pixels, cv::Mat &image) {
+            image.create(pixels.rows, pixels.cols, CV_16S);
+            auto intercept = (int16_t) pixels.rescale_intercept;
+            bool use_slope = pixels.rescale_slope != 1.;
+
+            for (int row = 0; row < pixels.rows; row++) {
+                auto image_row = image.ptr<int16_t>(row);
+                size_t offset = (size_t) row * pixels.cols;
+                for (int col = 0; col < pixels.cols; col++) {
+                    auto value = (int16_t) raw_pixel(pixels, offset + col);
+                    // Outside-of-scan pixels
+                    if (value == -2000)
+                        value = 0;
+                    if (use_slope)
+                        value = (int16_t) (int) (pixels.rescale_slope * (double) value);
+                    image_row[col] = (int16_t) (value + intercept);
+                }
+            }
+        }
+
+        DicomImageStatus readDicomImage(const std::string &path, Dicom &dicom, std::string &error_msg) {
+            DicomPixels pixels;
+            DicomImageStatus status = readDicomPixels(path, pixels, error_msg);
+            if (status != IMAGE_OK)
+                return status;
+            pixelsToHounsfield(pixels, dicom.data);
+            dicom.pixel_spacing = ImVec2((float) pixels.pixel_spacing, (float) pixels.pixel_spacing);
+            dicom.slice_thickness = (float) pixels.slice_thickness;
+            dicom.slice_position = (float) pixels.slice_location;
+            return IMAGE_OK;
+        }
+    }
+}
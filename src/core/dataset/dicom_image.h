@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+#include "core/dicom.h"
+
+namespace core {
+    namespace dataset {
+        enum DicomImageStatus {IMAGE_OK, IMAGE_UNSUPPORTED, IMAGE_ERROR};
+
+        /**
+         * Raw pixel data of a DICOM image, with the tags needed to convert it into HU
+         */
+        struct DicomPixels {
+            std::vector<char> data;
+            int rows = 0;
+            int cols = 0;
+            int bits_allocated = 0;
+            int bits_stored = 0;
+            bool is_signed = false;
+            bool little_endian = true;
+
+            double rescale_slope = 1.;
+            double rescale_intercept = 0.;
+
+            double pixel_spacing = 1.;
+            double slice_thickness = 1.;
+            double slice_location = 1.;
+        };
+
+        /**
+         * Reads the pixel data of a single frame, uncompressed DICOM image
+         *
+         * @return IMAGE_UNSUPPORTED if the image is compressed, has multiple frames or samples per pixel
+         * (these images have to be read by pydicom), IMAGE_ERROR if the file can not be read as an image
+         */
+        DicomImageStatus readDicomPixels(const std::string &path, DicomPixels &pixels, std::string &error_msg);
+
+        /**
+         * Converts the raw pixels into a CV_16S matrix of Hounsfield units, in the same way as get_pixels_hu
+         * in load_dicom.py (int16 cast, padding value -2000 set to 0, then slope and intercept)
+         */
+        void pixelsToHounsfield(const DicomPixels &pixels, cv::Mat &image);
+
+        /**
+         * Reads an uncompressed DICOM image (same result as load_scan_from_dicom in load_dicom.py)
+         * @return see readDicomPixels
+         */
+        DicomImageStatus readDicomImage(const std::string &path, Dicom &dicom, std::string &error_msg);
+    }
+}
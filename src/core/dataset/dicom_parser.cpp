@@ -0,0 +1,188 @@
+#include "dicom_parser.h"
+
+#include <cstring>
+
+namespace core {
+    namespace dataset {
+        namespace {
+            const uint32_t TAG_MEDIA_STORAGE_SOP_CLASS = 0x00020002;
+            const uint32_t TAG_TRANSFER_SYNTAX = 0x00020010;
+
+            const uint32_t TAG_ITEM = 0xFFFEE000;
+            const uint32_t TAG_ITEM_DELIMITATION = 0xFFFEE00D;
+            const uint32_t TAG_SEQUENCE_DELIMITATION = 0xFFFEE0DD;
+
+            const char *DICOMDIR_SOP_CLASS = "1.2.840.10008.1.3.10";
+            const char *DEFLATED_LITTLE_ENDIAN = "1.2.840.10008.1.2.1.99";
+
+            // Sequences are not expected to be nested deeper than this in a sane file
+            const int MAX_SEQUENCE_DEPTH = 32;
+
+            bool has_long_length(const char vr[2]) {
+                static const char *long_vrs[] = {"OB", "OD", "OF", "OL", "OV", "OW", "SQ", "SV", "UC", "UN", "UR",
+                                                 "UT", "UV"};
+                for (auto long_vr: long_vrs) {
+                    if (vr[0] == long_vr[0] && vr[1] == long_vr[1])
+                        return true;
+                }
+                return false;
+            }
+
+            /**
+             * Content of UN elements of undefined length is always implicit VR
+             */
+            bool is_nested_explicit(const DicomElement &element, bool explicit_vr) {
+                return explicit_vr && !(element.vr[0] == 'U' && element.vr[1] == 'N');
+            }
+        }
+
+        bool DicomParser::open() {
+            stream_.open(path_, std::ios::binary | std::ios::ate);
+            if (!stream_)
+                return false;
+            file_size_ = (uint64_t) stream_.tellg();
+            stream_.seekg(0);
+
+            // 128 bytes preamble followed by "DICM"
+            char prefix[132];
+            stream_.read(prefix, 132);
+            if (stream_.gcount() != 132 || std::memcmp(prefix + 128, "DICM", 4) != 0)
+                return false;
+
+            // File meta information, always explicit VR little endian
+            little_endian_ = true;
+            while (stream_.peek() != std::char_traits<char>::eof()) {
+                auto start = stream_.tellg();
+                DicomElement element;
+                read_element(element, true);
+                if (element.tag >> 16 != 0x0002) {
+                    stream_.seekg(start);
+                    break;
+                }
+                if (element.tag == TAG_TRANSFER_SYNTAX)
+                    transfer_syntax_ = readString(element.length);
+                else if (element.tag == TAG_MEDIA_STORAGE_SOP_CLASS)
+                    is_dicomdir_ = readString(element.length) == DICOMDIR_SOP_CLASS;
+                else
+                    skip(element.length);
+            }
+
+            if (transfer_syntax_ == DEFLATED_LITTLE_ENDIAN)
+                throw DicomParseError("Deflated transfer syntax is not supported");
+            explicit_vr_ = transfer_syntax_ != DICOM_IMPLICIT_LITTLE_ENDIAN;
+            little_endian_ = transfer_syntax_ != DICOM_EXPLICIT_BIG_ENDIAN;
+            return true;
+        }
+
+        bool DicomParser::next(DicomElement &element) {
+            while (stream_.peek() != std::char_traits<char>::eof()) {
+                read_element(element, explicit_vr_);
+                // Sequences of undefined length are skipped, the pixel data is left to the caller
+                if (element.length == DICOM_UNDEFINED_LENGTH && element.tag != DICOM_TAG_PIXEL_DATA) {
+                    skip_undefined_sequence(is_nested_explicit(element, explicit_vr_), 0);
+                    continue;
+                }
+                return true;
+            }
+            return false;
+        }
+
+        void DicomParser::read(char *buffer, size_t size) {
+            stream_.read(buffer, size);
+            if ((size_t) stream_.gcount() != size)
+                throw DicomParseError("Unexpected end of file");
+        }
+
+        void DicomParser::skip(uint32_t length) {
+            if ((uint64_t) stream_.tellg() + length > file_size_)
+                throw DicomParseError("Element length goes past the end of the file");
+            stream_.seekg(length, std::ios::cur);
+        }
+
+        std::string DicomParser::readString(uint32_t length) {
+            if ((uint64_t) stream_.tellg() + length > file_size_)
+                throw DicomParseError("Element length goes past the end of the file");
+            std::string value(length, '\0');
+            if (length > 0)
+                read(&value[0], length);
+
+            // Values are padded with spaces (or a null byte for UIs)
+            size_t end = value.find_last_not_of(std::string(" \0", 2));
+            size_t begin = value.find_first_not_of(' ');
+            if (end == std::string::npos || begin == std::string::npos)
+                return "";
+            return value.substr(begin, end - begin + 1);
+        }
+
+        uint32_t DicomParser::readUnsigned(uint32_t length) {
+            if (length != 2 && length != 4) {
+                skip(length);
+                throw DicomParseError("Unexpected length for a binary value");
+            }
+            unsigned char bytes[4];
+            read((char *) bytes, length);
+            uint32_t value = 0;
+            for (uint32_t i = 0; i < length; i++) {
+                uint32_t byte = little_endian_ ? bytes[i] : bytes[length - 1 - i];
+                value |= byte << (8 * i);
+            }
+            return value;
+        }
+
+        void DicomParser::read_element(DicomElement &element, bool explicit_vr) {
+            element = DicomElement();
+            auto group = (uint16_t) readUnsigned(2);
+            auto number = (uint16_t) readUnsigned(2);
+            element.tag = (uint32_t) group << 16 | number;
+
+            // Items and delimiters never have a VR
+            if (!explicit_vr || group == 0xFFFE) {
+                element.length = readUnsigned(4);
+                return;
+            }
+            read(element.vr, 2);
+            if (has_long_length(element.vr)) {
+                skip(2);
+                element.length = readUnsigned(4);
+            } else {
+                element.length = readUnsigned(2);
+            }
+        }
+
+        /**
+         * Skips the elements of an item of undefined length, up to (and including) the item delimitation
+         */
+        void DicomParser::skip_undefined_item(bool explicit_vr, int depth) {
+            while (true) {
+                DicomElement element;
+                read_element(element, explicit_vr);
+                if (element.tag == TAG_ITEM_DELIMITATION)
+                    return;
+                if (element.length == DICOM_UNDEFINED_LENGTH)
+                    skip_undefined_sequence(is_nested_explicit(element, explicit_vr), depth + 1);
+                else
+                    skip(element.length);
+            }
+        }
+
+        /**
+         * Skips the items of a sequence of undefined length, up to (and including) the sequence delimitation
+         */
+        void DicomParser::skip_undefined_sequence(bool explicit_vr, int depth) {
+            if (depth > MAX_SEQUENCE_DEPTH)
+                throw DicomParseError("Sequences are nested too deeply");
+            while (true) {
+                DicomElement item;
+                read_element(item, false);
+                if (item.tag == TAG_SEQUENCE_DELIMITATION)
+                    return;
+                if (item.tag != TAG_ITEM)
+                    throw DicomParseError("Unexpected element in a sequence");
+                if (item.length == DICOM_UNDEFINED_LENGTH)
+                    skip_undefined_item(explicit_vr, depth);
+                else
+                    skip(item.length);
+            }
+        }
+    }
+}
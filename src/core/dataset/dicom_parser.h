@@ -0,0 +1,95 @@
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <exception>
+
+namespace core {
+    namespace dataset {
+        const uint32_t DICOM_UNDEFINED_LENGTH = 0xFFFFFFFF;
+
+        const uint32_t DICOM_TAG_PIXEL_DATA = 0x7FE00010;
+
+        const char *const DICOM_IMPLICIT_LITTLE_ENDIAN = "1.2.840.10008.1.2";
+        const char *const DICOM_EXPLICIT_LITTLE_ENDIAN = "1.2.840.10008.1.2.1";
+        const char *const DICOM_EXPLICIT_BIG_ENDIAN = "1.2.840.10008.1.2.2";
+
+        class DicomParseError : public std::exception {
+        private:
+            std::string what_;
+        public:
+            explicit DicomParseError(std::string msg) : what_(std::move(msg)) {}
+
+            const char *what() const noexcept override { return what_.c_str(); }
+        };
+
+        /**
+         * Header of a data element
+         * The VR is only set for explicit VR transfer syntaxes
+         */
+        struct DicomElement {
+            uint32_t tag = 0;
+            char vr[2] = {0, 0};
+            uint32_t length = 0;
+        };
+
+        /**
+         * @brief Sequential reader of the top level data elements of a DICOM Part 10 file
+         *
+         * open() checks the preamble and reads the file meta information, then next() walks the data set.
+         * The value of each element must be read (or skipped) by the caller before calling next() again.
+         * Sequences of undefined length are skipped by next(). Malformed files throw DicomParseError.
+         */
+        class DicomParser {
+        private:
+            std::ifstream stream_;
+            std::string path_;
+            uint64_t file_size_ = 0;
+
+            std::string transfer_syntax_;
+            bool is_dicomdir_ = false;
+            bool little_endian_ = true;
+            bool explicit_vr_ = true;
+
+            void read_element(DicomElement &element, bool explicit_vr);
+
+            void skip_undefined_item(bool explicit_vr, int depth);
+            void skip_undefined_sequence(bool explicit_vr, int depth);
+
+        public:
+            explicit DicomParser(std::string path) : path_(std::move(path)) {}
+
+            /**
+             * Opens the file and reads the file meta information
+             * @return false if the file could not be opened or does not have the "DICM" prefix
+             */
+            bool open();
+
+            /**
+             * Reads the header of the next data element of the data set
+             * @return false at the end of the file
+             */
+            bool next(DicomElement &element);
+
+            void read(char *buffer, size_t size);
+            void skip(uint32_t length);
+
+            /**
+             * Reads a text value, without its padding
+             */
+            std::string readString(uint32_t length);
+
+            /**
+             * Reads an unsigned binary value (US or UL) of the given length
+             */
+            uint32_t readUnsigned(uint32_t length);
+
+            const std::string &getTransferSyntax() const { return transfer_syntax_; }
+            const std::string &getPath() const { return path_; }
+            bool isDicomdir() const { return is_dicomdir_; }
+            bool isLittleEndian() const { return little_endian_; }
+            bool isExplicitVR() const { return explicit_vr_; }
+        };
+    }
+}
@@ -23,7 +23,8 @@ namespace core {
             std::string error_msg;
         };
 
-        std::shared_ptr<Job> npy_to_matrix(const std::string& path, jobResultFct result_fct);
+        std::shared_ptr<Job> npy_to_matrix(const std::string& path, jobResultFct result_fct,
+                                           Job::jobPriority priority = Job::JOB_PRIORITY_NORMAL);
 
         /**
          * Opens the dicom image, converts it into an array of in16
@@ -35,7 +36,9 @@ namespace core {
          * @param event_name name of event that will tell when the image is ready
          * will be named "dataset/dicom/<event_name>"
          * @param path path to the dicom image
+         * @param priority priority of the job in the JobScheduler
          */
-        std::shared_ptr<Job> dicom_to_matrix(const std::string &path, jobResultFct result_fct);
+        std::shared_ptr<Job> dicom_to_matrix(const std::string &path, jobResultFct result_fct,
+                                             Job::jobPriority priority = Job::JOB_PRIORITY_NORMAL);
     }
 }
\ No newline at end of file
@@ -0,0 +1,203 @@
+#include "directory_manifest.h"
+
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cctype>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+
+#include "jobscheduler.h"
+#include "binary_file.h"
+
+namespace core {
+    namespace dataset {
+        namespace fs = std::filesystem;
+
+        namespace {
+            const char *MANIFEST_MAGIC = "BMMAN1";
+
+            // A directory modified less than this time ago could still be modified during the same clock tick,
+            // its listing is not cached
+            const auto MIN_CACHE_AGE = std::chrono::seconds(2);
+
+            /**
+             * Names starting with a number come first, ordered by this number (images are saved as 0.npz, 1.npz, ...)
+             */
+            bool name_less(const std::string &lhs, const std::string &rhs) {
+                size_t lhs_digits = 0;
+                while (lhs_digits < lhs.size() && std::isdigit((unsigned char) lhs[lhs_digits]))
+                    lhs_digits++;
+                size_t rhs_digits = 0;
+                while (rhs_digits < rhs.size() && std::isdigit((unsigned char) rhs[rhs_digits]))
+                    rhs_digits++;
+
+                if ((lhs_digits > 0) != (rhs_digits > 0))
+                    return lhs_digits > 0;
+                if (lhs_digits > 0) {
+                    // Compares the numbers without converting them, leading zeros apart
+                    size_t lhs_start = lhs.find_first_not_of('0');
+                    size_t rhs_start = rhs.find_first_not_of('0');
+                    lhs_start = std::min(lhs_start, lhs_digits);
+                    rhs_start = std::min(rhs_start, rhs_digits);
+                    size_t lhs_length = lhs_digits - lhs_start;
+                    size_t rhs_length = rhs_digits - rhs_start;
+                    if (lhs_length != rhs_length)
+                        return lhs_length < rhs_length;
+                    int cmp = lhs.compare(lhs_start, lhs_length, rhs, rhs_start, rhs_length);
+                    if (cmp != 0)
+                        return cmp < 0;
+                }
+                return lhs < rhs;
+            }
+        }
+
+        std::string listDirectory(const std::string &directory, std::vector<std::string> &names) {
+            names.clear();
+            try {
+                for (auto &entry: fs::directory_iterator(directory)) {
+                    names.push_back(entry.path().filename().string());
+                }
+            }
+            catch (const fs::filesystem_error &e) {
+                return e.what();
+            }
+            std::sort(names.begin(), names.end(), name_less);
+            return "";
+        }
+
+        DirectoryManifest::DirectoryManifest(const std::string &root_path) : root_(root_path) {
+            filename_ = (fs::path(root_path) / "tmp" / "manifest.bin").string();
+        }
+
+        std::string DirectoryManifest::load() {
+            entries_.clear();
+            modified_ = false;
+
+            std::error_code error;
+            uint64_t file_size = fs::file_size(filename_, error);
+            if (error)
+                return "";
+
+            std::ifstream file(filename_, std::ios::binary);
+            if (!file)
+                return "Could not open the manifest '" + filename_ + "'";
+
+            std::string magic;
+            if (!readString(file, magic, file_size) || magic != MANIFEST_MAGIC)
+                return "";
+
+            std::string key;
+            while (readString(file, key, file_size)) {
+                Entry entry;
+                uint64_t mtime;
+                uint64_t num_names;
+                if (!readU64(file, mtime) || !readU64(file, num_names) || num_names > file_size)
+                    break;
+                entry.mtime = (int64_t) mtime;
+                entry.names.resize(num_names);
+                bool valid = true;
+                for (auto &name: entry.names) {
+                    if (!readString(file, name, file_size)) {
+                        valid = false;
+                        break;
+                    }
+                }
+                if (!valid)
+                    break;
+                entries_[key] = std::move(entry);
+            }
+            return "";
+        }
+
+        std::string DirectoryManifest::list(const std::vector<std::string> &directories,
+                                            std::vector<std::vector<std::string>> &listings) {
+            listings.assign(directories.size(), {});
+            std::vector<std::string> keys(directories.size());
+            std::vector<int64_t> mtimes(directories.size());
+            std::vector<char> to_cache(directories.size(), 0);
+
+            std::atomic<size_t> next_directory{0};
+            std::mutex error_mutex;
+            std::string error_msg;
+            auto now = fs::file_time_type::clock::now();
+
+            auto list_directories = [&](bool &abort) {
+                while (!abort) {
+                    size_t i = next_directory++;
+                    if (i >= directories.size())
+                        return;
+
+                    std::error_code error;
+                    fs::path directory(directories[i]);
+                    auto time = fs::last_write_time(directory, error);
+                    if (error) {
+                        std::lock_guard<std::mutex> lock(error_mutex);
+                        if (error_msg.empty())
+                            error_msg = "Could not open the directory '" + directories[i] + "': " + error.message();
+                        continue;
+                    }
+                    mtimes[i] = (int64_t) time.time_since_epoch().count();
+                    fs::path relative = directory.lexically_relative(root_);
+                    keys[i] = (relative.empty() ? directory : relative).generic_string();
+
+                    // The manifest is only read during the listing
+                    auto it = entries_.find(keys[i]);
+                    if (it != entries_.end() && it->second.mtime == mtimes[i]) {
+                        listings[i] = it->second.names;
+                        continue;
+                    }
+
+                    std::string list_error = listDirectory(directories[i], listings[i]);
+                    if (!list_error.empty()) {
+                        std::lock_guard<std::mutex> lock(error_mutex);
+                        if (error_msg.empty())
+                            error_msg = list_error;
+                        continue;
+                    }
+                    to_cache[i] = now - time > MIN_CACHE_AGE;
+                }
+            };
+
+            auto &scheduler = JobScheduler::getInstance();
+            bool abort = false;
+            scheduler.parallelRun("list_directories", std::max(scheduler.getNumberOfWorkers() - 1, 0),
+                                  list_directories, abort);
+
+            for (size_t i = 0; i < directories.size(); i++) {
+                if (!to_cache[i])
+                    continue;
+                Entry &entry = entries_[keys[i]];
+                entry.mtime = mtimes[i];
+                entry.names = listings[i];
+                modified_ = true;
+            }
+            return error_msg;
+        }
+
+        std::string DirectoryManifest::save() {
+            if (!modified_)
+                return "";
+
+            std::error_code error;
+            fs::create_directories(fs::path(filename_).parent_path(), error);
+
+            std::string error_msg = writeFileAtomically(filename_, [this](std::ostream &file) {
+                writeString(file, MANIFEST_MAGIC);
+                for (auto &entry: entries_) {
+                    writeString(file, entry.first);
+                    writeU64(file, (uint64_t) entry.second.mtime);
+                    writeU64(file, entry.second.names.size());
+                    for (auto &name: entry.second.names) {
+                        writeString(file, name);
+                    }
+                }
+            });
+            if (!error_msg.empty())
+                return "Could not write the manifest: " + error_msg;
+            modified_ = false;
+            return "";
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+
+namespace core {
+    namespace dataset {
+        /**
+         * Lists a directory, names starting with a number come first, ordered by this number (0.npz, 1.npz, ...)
+         * @param names names of the entries (files and directories) of the directory
+         * @return error message if the directory could not be listed
+         */
+        std::string listDirectory(const std::string &directory, std::vector<std::string> &names);
+
+        /**
+         * @brief Cached listing of directories of a project (e.g. the masks directories)
+         *
+         * A directory whose modification time did not change since it was cached does not need to be listed again
+         * when the project is opened. The manifest is stored in tmp/manifest.bin of the project, with the paths
+         * relative to the project, so that the project can be moved.
+         */
+        class DirectoryManifest {
+        private:
+            struct Entry {
+                int64_t mtime = 0;
+                std::vector<std::string> names;
+            };
+
+            std::string root_;
+            std::string filename_;
+            std::map<std::string, Entry> entries_;
+            bool modified_ = false;
+
+        public:
+            /**
+             * @param root_path root of the project
+             */
+            explicit DirectoryManifest(const std::string &root_path);
+
+            /**
+             * Loads the manifest from the disk, a missing or corrupted manifest is not an error (it is empty)
+             * @return error message if the manifest could not be read
+             */
+            std::string load();
+
+            /**
+             * Lists the directories in parallel, on the calling thread and on the workers of the JobScheduler
+             *
+             * Directories that did not change since the last listing are taken from the manifest.
+             * @param directories directories to list
+             * @param listings names of the entries of each directory, sorted as in listDirectory
+             * @return error message if one of the directories could not be listed
+             */
+            std::string list(const std::vector<std::string> &directories, std::vector<std::vector<std::string>> &listings);
+
+            /**
+             * Writes the manifest to the disk if it has been modified
+             * @return error message if the manifest could not be written
+             */
+            std::string save();
+        };
+    }
+}
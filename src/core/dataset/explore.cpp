@@ -1,5 +1,17 @@
 #include "explore.h"
-#include "python/py_api.h"
+
+#include <set>
+#include <deque>
+#include <tuple>
+#include <mutex>
+#include <chrono>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <condition_variable>
+
+#include "dicom_header.h"
+#include "scan_index.h"
 #include "log.h"
 #include "jobscheduler.h"
 #include "util.h"
@@ -7,13 +19,298 @@
 
 namespace core {
     namespace dataset {
-        namespace py = pybind11;
+        namespace fs = std::filesystem;
+
+        namespace {
+            // Number of files read by a worker before going back to the shared queue
+            const size_t FILE_BATCH_SIZE = 64;
+
+            // Minimal time between two updates of the tree while the exploration is running
+            const std::chrono::milliseconds TREE_UPDATE_INTERVAL(250);
+
+            struct CrawlFile {
+                std::string path;
+                uint64_t size;
+                int64_t mtime;
+            };
+
+            /**
+             * Work item of the crawler : either a directory to list, or a batch of files to read
+             */
+            struct CrawlItem {
+                std::string directory;
+                std::vector<CrawlFile> files;
+            };
+
+            /**
+             * Walks a folder and reads the headers of the DICOM files it contains
+             *
+             * run() can be called from multiple threads at the same time, the threads share a queue of
+             * directories to list and files to read. A thread returns once there is nothing left to do.
+             * Files that did not change since they were indexed are not read again. The cases are sent to
+             * the inbox as soon as a batch of files has been read.
+             */
+            class DicomCrawler {
+            private:
+                std::string root_;
+                EventQueue &event_queue_;
+                ScanIndex &index_;
+                std::shared_ptr<Explore::CaseInbox> inbox_;
+
+                std::mutex mutex_;
+                std::condition_variable cv_;
+                std::deque<CrawlItem> queue_;
+                int pending_ = 0; // Items in the queue or being processed
+
+                std::vector<std::pair<std::string, ScanIndexEntry>> new_entries_;
+                bool has_errors_ = false;
+
+                void push(CrawlItem item) {
+                    {
+                        std::lock_guard<std::mutex> guard(mutex_);
+                        pending_++;
+                        queue_.push_back(std::move(item));
+                    }
+                    cv_.notify_one();
+                }
+
+                void post_search(const std::string &directory, bool found) {
+                    std::string message = std::string("Searching in '")
+                                          + directory.substr(std::min(root_.size(), directory.size()))
+                                          + std::string((found ? "', found DICOM(s)" : "'"));
+                    Rendering::push_animation();
+                    event_queue_.post(Event_ptr(new LogEvent("dicom_search", message)));
+                }
+
+                void list_directory(const std::string &directory) {
+                    std::error_code error;
+                    CrawlItem batch{directory};
+                    bool has_files = false;
+                    // Unreadable entries are ignored, like os.walk does
+                    for (fs::directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+                        std::error_code entry_error;
+                        // Symbolic links to directories are not followed
+                        if (it->is_directory(entry_error) && !it->is_symlink(entry_error)) {
+                            push(CrawlItem{it->path().string()});
+                        } else if (it->is_regular_file(entry_error)) {
+                            has_files = true;
+                            uint64_t size = it->file_size(entry_error);
+                            int64_t mtime = it->last_write_time(entry_error).time_since_epoch().count();
+                            batch.files.push_back(CrawlFile{it->path().string(), size, mtime});
+                            if (batch.files.size() == FILE_BATCH_SIZE) {
+                                push(std::move(batch));
+                                batch = CrawlItem{directory};
+                            }
+                        }
+                    }
+                    if (!batch.files.empty())
+                        push(std::move(batch));
+                    if (!has_files)
+                        post_search(directory, false);
+                }
+
+                void read_files(const CrawlItem &item, bool &abort) {
+                    std::vector<Case> found_cases;
+                    std::vector<std::pair<std::string, ScanIndexEntry>> new_entries;
+                    std::string errors;
+                    bool found = false;
+                    for (auto &file: item.files) {
+                        if (abort)
+                            break;
+                        ScanIndexEntry *indexed = index_.lookup(file.path, file.size, file.mtime);
+                        if (indexed != nullptr) {
+                            found = found || indexed->found;
+                            if (indexed->has_case)
+                                found_cases.push_back(indexed->case_);
+                            continue;
+                        }
+
+                        DicomHeader header;
+                        std::string error;
+                        DicomHeaderStatus status = readDicomHeader(file.path, header, error);
+                        if (status == HEADER_ERROR) {
+                            // Not indexed, so that the error is reported again on the next scan
+                            errors += (errors.empty() ? "" : "\n") + error;
+                            continue;
+                        }
+
+                        ScanIndexEntry entry;
+                        entry.size = file.size;
+                        entry.mtime = file.mtime;
+                        // The files referenced by a DICOMDIR are found by the crawl itself
+                        entry.found = status == HEADER_OK && !header.is_dicomdir && header.has_pixel_data;
+                        entry.has_case = entry.found && header.has_instance_number;
+                        if (entry.has_case) {
+                            entry.case_ = Case{header.patientID, header.studyDate, header.studyTime,
+                                               header.studyDescription, header.seriesNumber,
+                                               header.modality, file.path, header.instanceNumber};
+                            found_cases.push_back(entry.case_);
+                        }
+                        found = found || entry.found;
+                        new_entries.emplace_back(file.path, std::move(entry));
+                    }
+                    {
+                        std::lock_guard<std::mutex> guard(inbox_->mutex);
+                        inbox_->cases.insert(inbox_->cases.end(), found_cases.begin(), found_cases.end());
+                    }
+                    {
+                        std::lock_guard<std::mutex> guard(mutex_);
+                        new_entries_.insert(new_entries_.end(), std::make_move_iterator(new_entries.begin()),
+                                            std::make_move_iterator(new_entries.end()));
+                        if (!errors.empty())
+                            has_errors_ = true;
+                    }
+                    post_search(item.directory, found);
+                    if (!errors.empty())
+                        event_queue_.post(Event_ptr(new LogEvent("dicom_error", errors)));
+                }
+
+            public:
+                DicomCrawler(std::string root, ScanIndex &index, std::shared_ptr<Explore::CaseInbox> inbox) :
+                        root_(std::move(root)), event_queue_(EventQueue::getInstance()), index_(index),
+                        inbox_(std::move(inbox)) {
+                    push(CrawlItem{root_});
+                }
+
+                void run(bool &abort) {
+                    while (true) {
+                        CrawlItem item;
+                        {
+                            std::unique_lock<std::mutex> lock(mutex_);
+                            // The queue may be empty while other threads are still listing directories
+                            while (queue_.empty() && pending_ > 0 && !abort)
+                                cv_.wait_for(lock, std::chrono::milliseconds(50));
+                            if (abort || queue_.empty())
+                                return;
+                            item = std::move(queue_.front());
+                            queue_.pop_front();
+                        }
+
+                        if (item.files.empty())
+                            list_directory(item.directory);
+                        else
+                            read_files(item, abort);
+
+                        bool done;
+                        {
+                            std::lock_guard<std::mutex> guard(mutex_);
+                            done = --pending_ == 0;
+                        }
+                        if (done)
+                            cv_.notify_all();
+                    }
+                }
+
+                std::vector<std::pair<std::string, ScanIndexEntry>> &getNewEntries() { return new_entries_; }
+
+                bool hasErrors() const { return has_errors_; }
+            };
+
+            /**
+             * Length of the numerical prefix of the string
+             */
+            size_t numeric_prefix(const std::string &str) {
+                size_t length = 0;
+                while (length < str.size() && std::isdigit((unsigned char) str[length]))
+                    length++;
+                return length;
+            }
+
+            /**
+             * Same order as special_sort in util.py : IDs starting with a number are first and ordered by this
+             * number, then the other IDs in alphabetical order
+             */
+            bool patient_less(const std::string &a, const std::string &b) {
+                size_t a_prefix = numeric_prefix(a);
+                size_t b_prefix = numeric_prefix(b);
+                if ((a_prefix == 0) != (b_prefix == 0))
+                    return a_prefix != 0;
+                if (a_prefix > 0) {
+                    // Compare the numbers without converting them, they can be arbitrarily long
+                    size_t a_start = std::min(a.find_first_not_of('0'), a_prefix);
+                    size_t b_start = std::min(b.find_first_not_of('0'), b_prefix);
+                    size_t a_length = a_prefix - a_start;
+                    size_t b_length = b_prefix - b_start;
+                    if (a_length != b_length)
+                        return a_length < b_length;
+                    int cmp = a.compare(a_start, a_length, b, b_start, b_length);
+                    if (cmp != 0)
+                        return cmp < 0;
+                }
+                return a < b;
+            }
+
+            /**
+             * Numbers (series and instance numbers) are ordered numerically, and placed before non numerical values
+             */
+            bool number_less(const std::string &a, const std::string &b) {
+                char *a_end;
+                char *b_end;
+                long long a_value = std::strtoll(a.c_str(), &a_end, 10);
+                long long b_value = std::strtoll(b.c_str(), &b_end, 10);
+                bool a_numeric = !a.empty() && *a_end == '\0';
+                bool b_numeric = !b.empty() && *b_end == '\0';
+                if (a_numeric != b_numeric)
+                    return a_numeric;
+                if (a_numeric && a_value != b_value)
+                    return a_value < b_value;
+                return a < b;
+            }
+
+            /**
+             * Inserts the case at its place in the tree : patients in the same order as special_sort in util.py,
+             * studies by date, time and description, series and images by number
+             * The nodes that already exist are not moved in memory, except in their parent vector.
+             * @return the series in which the image has been added
+             */
+            std::shared_ptr<SeriesNode> insert_case(std::vector<PatientNode> &tree, const Case &new_case) {
+                auto patient = std::lower_bound(tree.begin(), tree.end(), new_case.patientID,
+                                                [](const PatientNode &node, const std::string &id) {
+                                                    return patient_less(node.ID, id);
+                                                });
+                if (patient == tree.end() || patient->ID != new_case.patientID)
+                    patient = tree.insert(patient, PatientNode{new_case.patientID});
+
+                auto study_key = std::tie(new_case.studyDate, new_case.studyTime, new_case.studyDescription);
+                auto study = std::lower_bound(patient->study.begin(), patient->study.end(), study_key,
+                                              [](const StudyNode &node, const decltype(study_key) &key) {
+                                                  return std::tie(node.date, node.time, node.description) < key;
+                                              });
+                if (study == patient->study.end() || std::tie(study->date, study->time, study->description) != study_key) {
+                    study = patient->study.insert(study, StudyNode{new_case.studyDate, new_case.studyTime,
+                                                                   new_case.studyDescription});
+                }
+
+                auto series = std::lower_bound(study->series.begin(), study->series.end(), new_case,
+                                               [](const std::shared_ptr<SeriesNode> &node, const Case &c) {
+                                                   if (node->number != c.seriesNumber)
+                                                       return number_less(node->number, c.seriesNumber);
+                                                   return node->modality < c.modality;
+                                               });
+                if (series == study->series.end() || (*series)->number != new_case.seriesNumber
+                    || (*series)->modality != new_case.modality) {
+                    series = study->series.insert(series, std::make_shared<SeriesNode>(
+                            SeriesNode{new_case.modality, new_case.seriesNumber}));
+                }
+
+                auto &images = (*series)->images;
+                auto image = std::upper_bound(images.begin(), images.end(), new_case,
+                                              [](const Case &c, const ImageNode &node) {
+                                                  if (c.instanceNumber != node.number)
+                                                      return number_less(c.instanceNumber, node.number);
+                                                  return c.path < node.path;
+                                              });
+                images.insert(image, ImageNode{new_case.path, new_case.instanceNumber});
+                return *series;
+            }
+        }
 
         bool Explore::destroy_ = false;
 
         Explore::Explore(const Explore& other) : event_queue_(EventQueue::getInstance()) {
             status_ = other.status_;
             cases_ = other.cases_;
+            inbox_ = other.inbox_;
             destroy_ = false;
         }
 
@@ -22,77 +319,42 @@ namespace core {
         }
 
         void Explore::findDicoms(const std::string &path) {
+            if (status_ == EXPLORE_WORKING)
+                return;
             path_ = path;
-            //cases_->clear();
+
+            // A new inbox, so that a previous job that would still be running can not add its cases to the new tree
+            cases_ = std::make_shared<std::vector<PatientNode>>();
+            inbox_ = std::make_shared<CaseInbox>();
+            auto inbox = inbox_;
+
             jobFct job = [=](float &progress, bool &abort) -> std::shared_ptr<JobResult> {
                 status_ = EXPLORE_WORKING;
-                auto cases = std::make_shared<std::vector<PatientNode>>();
-                auto state = PyGILState_Ensure();
 
                 Explore::status status = EXPLORE_SUCCESS;
                 JobResult job_result;
                 try {
-                    py::module scripts = py::module::import("python.scripts.load_dicom");
-                    py::object dicoms = scripts.attr("DiscoverDicoms")(path_.c_str());
-                    for (auto &element : dicoms) {
-                        if (abort) {
-                            status = EXPLORE_CANCELLED;
-                            break;
-                        }
-                        auto tuple = element.cast<py::tuple>();
-                        bool found = tuple[1].cast<bool>();
-                        std::string errors = tuple[2].cast<std::string>();
-
-                        std::string message = std::string("Searching in '")
-                                              + tuple[0].cast<std::string>()
-                                              + std::string((found ? "', found DICOM(s)" : "'"));
-                        Rendering::push_animation();
-                        event_queue_.post(Event_ptr(new LogEvent("dicom_search", message)));
-                        
-                        if (!errors.empty()) {
-                            status = EXPLORE_PARTIAL_SUCCESS;
-                            event_queue_.post(Event_ptr(new LogEvent("dicom_error", errors)));
-                        }
-                    }
-                    // Once it has finished building the cases, copy the dictionary that represents
-                    // all the cases
-                    // See load_dicom.py
-                    py::list data_dict = dicoms.attr("data").attr("get_cases_list")();
-                    for (auto &py_patient : data_dict) {
-                        auto patient_tuple = py_patient.cast<py::tuple>();
-                        auto patientID = patient_tuple[0].cast<std::string>();
-
-                        PatientNode patient{patientID};
-
-                        for (auto &py_study : patient_tuple[1].cast<py::dict>()) {
-                            auto study_tuple = py_study.first.cast<py::tuple>();
-
-                            StudyNode study {study_tuple[0].cast<std::string>(),
-                                             study_tuple[1].cast<std::string>(),
-                                             study_tuple[2].cast<std::string>()};
-
-                            for (auto &py_series : py_study.second.cast<py::dict>()) {
-                                auto series_tuple = py_series.first.cast<py::tuple>();
-
-                                SeriesNode series {series_tuple[1].cast<std::string>(),
-                                                   series_tuple[0].cast<std::string>()};
-
-                                std::vector<std::string> paths;
-                                for (auto &py_image : py_series.second.cast<py::list>()) {
-                                    auto image_dict = py_image.cast<py::dict>();
-
-                                    ImageNode image {image_dict["path"].cast<std::string>(),
-                                                     image_dict["instanceNumber"].cast<std::string>()};
-                                    series.images.push_back(image);
-                                    paths.push_back(image.path);
-                                }
-                                series.data = DicomSeries(paths);
-                                study.series.push_back(std::make_shared<SeriesNode>(series));
-                            }
-                            patient.study.push_back(study);
-                        }
-                        cases->push_back(patient);
-                    }
+                    ScanIndex index(path_);
+                    std::string index_error = index.load();
+                    if (!index_error.empty())
+                        BM_DEBUG(index_error);
+
+                    // The crawl is spread on all the workers, this job being one of them
+                    DicomCrawler crawler(path_, index, inbox);
+                    auto &scheduler = JobScheduler::getInstance();
+                    scheduler.parallelRun(std::string(STRING(JOB_EXPLORE_NAME)) + "_helper",
+                                          std::max(scheduler.getNumberOfWorkers() - 1, 0),
+                                          [&crawler](bool &abort) { crawler.run(abort); }, abort);
+
+                    if (abort)
+                        status = EXPLORE_CANCELLED;
+                    else if (crawler.hasErrors())
+                        status = EXPLORE_PARTIAL_SUCCESS;
+
+                    // Even a cancelled scan can save the files it has read
+                    index_error = index.save(crawler.getNewEntries(), !abort);
+                    if (!index_error.empty())
+                        BM_DEBUG(index_error);
                 }
                 catch (const std::exception &e) {
                     std::string error(e.what());
@@ -100,14 +362,13 @@ namespace core {
                     status = EXPLORE_ERROR;
                 }
 
-                PyGILState_Release(state);
-
                 if (destroy_) {
                     return std::make_shared<JobResult>(job_result);
                 }
-                cases_ = cases;
 
                 status_ = status;
+                // The last cases are inserted in the tree by the next frame
+                Rendering::push_animation();
                 if (status == EXPLORE_ERROR)
                     job_result.success = false;
                 else {
@@ -116,8 +377,47 @@ namespace core {
                 return std::make_shared<JobResult>(job_result);
             };
 
-            if (status_ != EXPLORE_WORKING)
-                jobRef_ = JobScheduler::getInstance().addJob(STRING(JOB_EXPLORE_NAME), job)->id;
+            jobRef_ = JobScheduler::getInstance().addJob(STRING(JOB_EXPLORE_NAME), job)->id;
+        }
+
+        bool Explore::update() {
+            auto now = std::chrono::steady_clock::now();
+            if (status_ == EXPLORE_WORKING && now - last_update_ < TREE_UPDATE_INTERVAL)
+                return false;
+
+            std::vector<Case> new_cases;
+            {
+                std::lock_guard<std::mutex> guard(inbox_->mutex);
+                new_cases.swap(inbox_->cases);
+            }
+            if (new_cases.empty())
+                return false;
+            last_update_ = now;
+
+            std::vector<SeriesPayload> changed_series;
+            std::set<SeriesNode*> changed;
+            for (auto &new_case: new_cases) {
+                auto series = insert_case(*cases_, new_case);
+                if (changed.insert(series.get()).second) {
+                    Case series_case = new_case;
+                    series_case.path.clear();
+                    series_case.instanceNumber.clear();
+                    changed_series.push_back(SeriesPayload{series, series_case});
+                }
+            }
+
+            // The series are only loaded from the UI thread, so their paths can be replaced here
+            for (auto &payload: changed_series) {
+                std::vector<std::string> paths;
+                paths.reserve(payload.series->images.size());
+                for (auto &image: payload.series->images) {
+                    paths.push_back(image.path);
+                }
+                payload.series->data.setPaths(paths);
+            }
+
+            event_queue_.post(Event_ptr(new ExplorerDeltaEvent(cases_, std::move(changed_series))));
+            return true;
         }
 
         template <typename T>
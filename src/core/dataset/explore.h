@@ -6,6 +6,8 @@
 #include <numeric>
 #include <cstdint>
 #include <algorithm>
+#include <mutex>
+#include <chrono>
 
 #include "imgui.h"
 
@@ -82,6 +84,21 @@
 
              std::shared_ptr<std::vector<PatientNode>> getCases() { return cases_; }
          };
+         /**
+          * Posted whenever the exploration adds images to the tree, with the series that are new or have
+          * new images
+          */
+         class ExplorerDeltaEvent : public Event {
+         private:
+             std::shared_ptr<std::vector<PatientNode>> cases_;
+             std::vector<SeriesPayload> series_;
+         public:
+             ExplorerDeltaEvent(std::shared_ptr<std::vector<PatientNode>> cases, std::vector<SeriesPayload> series) :
+                     Event("dataset/explorer/delta"), cases_(std::move(cases)), series_(std::move(series)) {}
+
+             std::shared_ptr<std::vector<PatientNode>> getCases() { return cases_; }
+             std::vector<SeriesPayload> &getSeries() { return series_; }
+         };
          class ExplorerFilterEvent : public Event {
          private:
              ImGuiTextFilter& case_filter_;
@@ -118,16 +135,26 @@
         /**
          * @brief The Explore class allows to explore and discover the content of a certain folder
          *
-         * This class mainly interfaces with the python script load_dicom.py and will explore the
-         * given folder for DICOM images and classify by Patient IDs.
+         * This class walks the given folder in parallel on the JobScheduler workers, reads the headers
+         * of the DICOM images (see dicom_header.h) and classifies them by Patient IDs.
          *
          */
          class Explore {
          public:
              enum status {EXPLORE_SLEEPING, EXPLORE_WORKING, EXPLORE_SUCCESS, EXPLORE_CANCELLED, EXPLORE_PARTIAL_SUCCESS, EXPLORE_ERROR};
+
+             /**
+              * Cases found by the exploration job, waiting to be inserted in the tree by the UI thread
+              */
+             struct CaseInbox {
+                 std::mutex mutex;
+                 std::vector<Case> cases;
+             };
          private:
              std::string path_;
              std::shared_ptr<std::vector<PatientNode>> cases_; // Tree representation of the cases discovered in the folder
+             std::shared_ptr<CaseInbox> inbox_;
+             std::chrono::steady_clock::time_point last_update_;
 
              EventQueue& event_queue_;
              status status_;
@@ -145,7 +172,8 @@
              explicit Explore() :
              event_queue_(EventQueue::getInstance()),
              status_(EXPLORE_SLEEPING),
-             cases_(std::make_shared<std::vector<PatientNode>>())
+             cases_(std::make_shared<std::vector<PatientNode>>()),
+             inbox_(std::make_shared<CaseInbox>())
              {
                  destroy_ = false;
              }
@@ -155,11 +183,14 @@
              ~Explore();
 
              /**
-              * @brief Opens the Python interpreter and explores all the readable DICOMs present in
-              * the folder.
+              * @brief Explores all the readable DICOMs present in the folder.
               *
-              * The function will push some log events about the progression of the exploration.
-              * The function is launched as a Job on the JobScheduler under the name JOB_EXPLORE_NAME
+              * Only the headers of the files are read, up to the pixel data. The function will push some
+              * log events about the progression of the exploration. The images are added to the tree while
+              * the exploration goes on (see update()), the tree of the previous exploration is replaced by
+              * a new one.
+              * The function is launched as a Job on the JobScheduler under the name JOB_EXPLORE_NAME, which
+              * spreads the exploration on the idle workers
               *
               * @returns SUCCESS if no error have been encountered, PARTIAL SUCCESS when encountering
               * some errors but still DICOMS have been found and ERROR if the exploration failed
@@ -167,7 +198,17 @@
              void findDicoms(const std::string& path);
 
              /**
-              * @return a flat representation of all the cases the have been found
+              * Inserts the cases found since the last call in the tree, and posts a ExplorerDeltaEvent if the
+              * tree has changed
+              *
+              * Must be called from the UI thread (the tree is only modified there), the updates are throttled
+              * while the exploration is running
+              * @return true if the tree has changed
+              */
+             bool update();
+
+             /**
+              * @return a tree representation of all the cases the have been found
               */
              std::shared_ptr<std::vector<PatientNode>> getCases() { return cases_; }
 
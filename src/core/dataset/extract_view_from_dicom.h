@@ -16,6 +16,15 @@ namespace core {
             Dicom image;
         };
 
+        /**
+         * Builds a sagittal or coronal view of a series (runs on the calling thread, see extract_view)
+         * @param matrices slices of the series, at least 5
+         * @param position position of the view in the slices (between 0 and 1)
+         * @param horizontal if set, the view is built from a row of each slice, otherwise from a column
+         * @return the view, whose data is empty if it could not be built
+         */
+        Dicom build_view(const std::vector<Dicom> &matrices, float position = 0.5, bool horizontal = true);
+
         /**
          *
          * @param matrices
@@ -0,0 +1,129 @@
+#include "import_journal.h"
+
+#include <sstream>
+#include <filesystem>
+#include <functional>
+
+namespace core {
+    namespace dataset {
+        namespace fs = std::filesystem;
+
+        namespace {
+            const char *JOURNAL_MAGIC = "BMJOURNAL1";
+
+            std::string hash_paths(const std::vector<std::string> &paths) {
+                std::string all_paths;
+                for (auto &path: paths) {
+                    all_paths += path;
+                    all_paths.push_back('\n');
+                }
+                return std::to_string(paths.size()) + " " + std::to_string(std::hash<std::string>{}(all_paths));
+            }
+        }
+
+        ImportJournal::ImportJournal(const std::string &root_path, const std::string &id,
+                                     const std::string &series_directory)
+                : series_directory_(series_directory) {
+            filename_ = (fs::path(root_path) / "tmp" / "import" / (id + ".journal")).string();
+        }
+
+        bool ImportJournal::verify(int num, uintmax_t size) const {
+            fs::path path = fs::path(series_directory_) / (std::to_string(num) + ".npz");
+            std::error_code error;
+            return fs::file_size(path, error) == size && !error;
+        }
+
+        ImportJournal::State ImportJournal::load(const std::vector<std::string> &paths) {
+            completed_.clear();
+            std::ifstream file(filename_);
+            if (!file)
+                return JOURNAL_MISSING;
+
+            std::string line;
+            if (!std::getline(file, line) || file.eof() || line != std::string(JOURNAL_MAGIC) + " " + hash_paths(paths))
+                return JOURNAL_MISMATCH;
+
+            bool complete = false;
+            while (std::getline(file, line)) {
+                // Line that has been cut by a crash
+                if (file.eof())
+                    break;
+                std::istringstream stream(line);
+                std::string type;
+                stream >> type;
+                if (type == "image") {
+                    int num;
+                    uintmax_t size;
+                    if ((stream >> num >> size) && num >= 0 && num < (int) paths.size() && verify(num, size))
+                        completed_.insert(num);
+                    else
+                        completed_.erase(num);
+                }
+                else if (type == "complete") {
+                    complete = true;
+                }
+            }
+            return complete && completed_.size() == paths.size() ? JOURNAL_COMPLETE : JOURNAL_INCOMPLETE;
+        }
+
+        std::string ImportJournal::start(const std::vector<std::string> &paths) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            completed_.clear();
+            std::error_code error;
+            fs::create_directories(fs::path(filename_).parent_path(), error);
+            file_.close();
+            file_.open(filename_, std::ios::trunc);
+            if (!file_)
+                return "Could not create the import journal '" + filename_ + "'";
+            file_ << JOURNAL_MAGIC << " " << hash_paths(paths) << std::endl;
+            return "";
+        }
+
+        std::string ImportJournal::resume() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            // Images that were being written when the import stopped
+            std::error_code error;
+            for (auto &entry: fs::directory_iterator(series_directory_, error)) {
+                if (entry.path().extension() == ".tmp")
+                    fs::remove(entry.path(), error);
+            }
+
+            file_.close();
+            file_.open(filename_, std::ios::app);
+            if (!file_)
+                return "Could not open the import journal '" + filename_ + "'";
+            // Terminates a line that could have been cut by a crash
+            file_ << std::endl;
+            return "";
+        }
+
+        std::string ImportJournal::addImage(int num, const std::string &filename) {
+            std::error_code error;
+            uintmax_t size = fs::file_size(filename, error);
+            if (error)
+                return "Could not read the size of '" + filename + "': " + error.message();
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            file_ << "image " << num << " " << size << std::endl;
+            if (!file_)
+                return "Could not write the import journal '" + filename_ + "'";
+            return "";
+        }
+
+        std::string ImportJournal::complete() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            file_ << "complete" << std::endl;
+            if (!file_)
+                return "Could not write the import journal '" + filename_ + "'";
+            file_.close();
+            return "";
+        }
+
+        void ImportJournal::remove() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            file_.close();
+            std::error_code error;
+            fs::remove(filename_, error);
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <mutex>
+#include <fstream>
+#include <cstdint>
+
+namespace core {
+    namespace dataset {
+        /**
+         * @brief Records the images of a series that have been imported, so that an interrupted import can be resumed
+         *
+         * The journal is a text file in tmp/import of the project (the series directory should only contain images),
+         * made of a header line with the number of images and a hash of their source paths, then one line per
+         * imported image (number and size of the .npz file) and a last line once the series is complete. Lines are
+         * flushed one by one, a line that has been cut by a crash is ignored.
+         *
+         * As the images are written in a temporary file which is then renamed, an image that is in the journal is
+         * complete unless the file has been modified since, which is checked (on its size) when the journal is loaded.
+         */
+        class ImportJournal {
+        public:
+            enum State {
+                JOURNAL_MISSING,  // No journal, the series has not been imported with a journal
+                JOURNAL_MISMATCH,  // Journal of another selection of images, the series can only be replaced
+                JOURNAL_INCOMPLETE,
+                JOURNAL_COMPLETE
+            };
+        private:
+            std::string filename_;
+            std::string series_directory_;
+            std::set<int> completed_;
+
+            std::mutex mutex_;
+            std::ofstream file_;
+
+            bool verify(int num, uintmax_t size) const;
+        public:
+            /**
+             * @param root_path root of the project
+             * @param id id of the series
+             * @param series_directory directory where the images of the series are saved
+             */
+            ImportJournal(const std::string &root_path, const std::string &id, const std::string &series_directory);
+
+            /**
+             * Reads the journal and verifies the images it contains, images that are missing or that have been
+             * modified are not marked as completed
+             * @param paths source paths of the images that are about to be imported
+             */
+            State load(const std::vector<std::string> &paths);
+
+            /**
+             * Starts a new journal (the previous one is erased)
+             * @return error message
+             */
+            std::string start(const std::vector<std::string> &paths);
+
+            /**
+             * Continues the journal that has been loaded, and removes the temporary files of the images that were
+             * being written when the previous import stopped
+             * @return error message
+             */
+            std::string resume();
+
+            /**
+             * Records an imported image, can be called from multiple threads
+             * @param num number of the image in the series
+             * @param filename file where the image has been saved
+             * @return error message
+             */
+            std::string addImage(int num, const std::string &filename);
+
+            /**
+             * Marks the series as complete
+             * @return error message
+             */
+            std::string complete();
+
+            /**
+             * Removes the journal
+             */
+            void remove();
+
+            const std::set<int> &getCompleted() const { return completed_; }
+        };
+    }
+}
@@ -0,0 +1,183 @@
+#include "import_pipeline.h"
+
+#include <filesystem>
+
+#include "python/py_api.h"
+#include "python/executor.h"
+#include "pybind11/stl.h"
+
+#include "npz.h"
+
+namespace py = pybind11;
+
+namespace core {
+    namespace dataset {
+        ImportPipeline::ImportPipeline(std::vector<ImportSeries> &series, const std::string &root_path,
+                                       size_t queue_capacity)
+                : series_(series), root_path_(root_path), queue_capacity_(queue_capacity) {
+            for (size_t i = 0; i < series_.size(); i++) {
+                if (series_[i].progress->skipped)
+                    continue;
+                auto &completed = series_[i].journal->getCompleted();
+                series_[i].progress->num_done = (int) completed.size();
+                for (int num = 0; num < (int) series_[i].paths.size(); num++) {
+                    if (completed.find(num) == completed.end())
+                        tasks_.push_back(Task{i, num});
+                }
+            }
+        }
+
+        std::string ImportPipeline::filename(const Task &task) const {
+            return (std::filesystem::path(series_[task.series].directory) / (std::to_string(task.num) + ".npz")).string();
+        }
+
+        bool ImportPipeline::is_cancelled(const Task &task) const {
+            return series_[task.series].progress->cancel;
+        }
+
+        void ImportPipeline::finish(const Task &task, bool imported) {
+            if (imported) {
+                std::string error_msg = series_[task.series].journal->addImage(task.num, filename(task));
+                if (!error_msg.empty())
+                    fail(error_msg);
+                series_[task.series].progress->num_done++;
+            }
+            num_done_++;
+        }
+
+        void ImportPipeline::fail(const std::string &error_msg) {
+            std::lock_guard<std::mutex> lock(error_mutex_);
+            // Only the first error is reported, the other ones are often a consequence of it
+            if (!failed_) {
+                error_msg_ = error_msg;
+                failed_ = true;
+            }
+        }
+
+        std::string ImportPipeline::getError() {
+            std::lock_guard<std::mutex> lock(error_mutex_);
+            return error_msg_;
+        }
+
+        bool ImportPipeline::decode(const Task &task, DecodedImage &image) {
+            const std::string &path = series_[task.series].paths[task.num];
+            DicomPixels pixels;
+            std::string error_msg;
+            switch (readDicomPixels(path, pixels, error_msg)) {
+                case IMAGE_OK:
+                    break;
+                case IMAGE_UNSUPPORTED:
+                    python_import(task);
+                    return false;
+                default:
+                    fail("Could not import '" + path + "':\n" + error_msg);
+                    return false;
+            }
+            pixelsToHounsfield(pixels, image.matrix);
+            image.pixel_spacing = pixels.pixel_spacing;
+            image.slice_thickness = pixels.slice_thickness;
+            image.slice_location = pixels.slice_location;
+            return true;
+        }
+
+        void ImportPipeline::write(const DecodedImage &image) {
+            const Task &task = tasks_[image.task];
+            const ImportSeries &series = series_[task.series];
+
+            // Same arrays as np.savez_compressed in import_dicom
+            NpzWriter writer;
+            writer.add("matrix", image.matrix);
+            writer.add("spacing", std::vector<double>{image.pixel_spacing, image.pixel_spacing});
+            writer.add("windowing", std::vector<int64_t>{series.window_width, series.window_center});
+            writer.add("crop_x", std::vector<double>{series.crop_x.x, series.crop_x.y});
+            writer.add("crop_y", std::vector<double>{series.crop_y.x, series.crop_y.y});
+            writer.add("slice_info", std::vector<double>{image.slice_thickness, image.slice_location});
+
+            std::string archive;
+            std::string error_msg = writer.encode(archive);
+            if (error_msg.empty())
+                error_msg = NpzWriter::writeFile(filename(task), archive);
+            if (!error_msg.empty()) {
+                fail(error_msg);
+                return;
+            }
+            finish(task, true);
+        }
+
+        void ImportPipeline::python_import(const Task &task) {
+            const ImportSeries &series = series_[task.series];
+            std::string error_msg;
+
+            auto &executor = PyAPI::Executor::getInstance();
+            try {
+                std::vector<float> crop_x = {series.crop_x.x, series.crop_x.y};
+                std::vector<float> crop_y = {series.crop_y.x, series.crop_y.y};
+                executor.call([&] {
+                    // The series directory has been prepared by the caller, so the image can always be replaced
+                    executor.functions().import_dicom(
+                            series.paths[task.num], root_path_, series.progress->id, task.num,
+                            series.window_width, series.window_center, crop_x, crop_y, true);
+                });
+            }
+            catch (const std::exception &e) {
+                error_msg = e.what();
+            }
+
+            if (!error_msg.empty())
+                fail(error_msg);
+            else
+                finish(task, true);
+        }
+
+        void ImportPipeline::run(bool &abort, float *progress) {
+            while (!abort && !failed_) {
+                if (progress && !tasks_.empty())
+                    *progress = float(num_done_) / float(tasks_.size());
+
+                // Decoded images are written first, to keep the queue short
+                DecodedImage image;
+                bool has_image = false;
+                {
+                    std::lock_guard<std::mutex> lock(queue_mutex_);
+                    if (!queue_.empty()) {
+                        image = std::move(queue_.front());
+                        queue_.pop_front();
+                        has_image = true;
+                    }
+                }
+                if (has_image) {
+                    if (is_cancelled(tasks_[image.task]))
+                        finish(tasks_[image.task], false);
+                    else
+                        write(image);
+                    continue;
+                }
+
+                // The images that are still being decoded are written by the worker that decodes them
+                size_t index = next_task_++;
+                if (index >= tasks_.size())
+                    return;
+
+                const Task &task = tasks_[index];
+                if (is_cancelled(task)) {
+                    finish(task, false);
+                    continue;
+                }
+                image.task = index;
+                if (!decode(task, image))
+                    continue;
+
+                bool queued = false;
+                {
+                    std::lock_guard<std::mutex> lock(queue_mutex_);
+                    if (queue_.size() < queue_capacity_) {
+                        queue_.push_back(std::move(image));
+                        queued = true;
+                    }
+                }
+                if (!queued)
+                    write(image);
+            }
+        }
+    }
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+
+#include "opencv2/opencv.hpp"
+#include "imgui.h"
+
+#include "dicom_image.h"
+#include "import_journal.h"
+
+namespace core {
+    namespace dataset {
+        /**
+         * Progress of the import of one series, shared between the import job and the UI
+         */
+        struct SeriesImportProgress {
+            std::string id;
+            int num_images = 0;
+            std::atomic<int> num_done{0};
+            /**
+             * Set by the UI to stop the import of this series only
+             */
+            std::atomic<bool> cancel{false};
+            /**
+             * Series that was already in the project and that has not been imported
+             */
+            std::atomic<bool> skipped{false};
+        };
+
+        /**
+         * Series to import, with the values that are saved with each image
+         */
+        struct ImportSeries {
+            std::shared_ptr<SeriesImportProgress> progress;
+            std::vector<std::string> paths;
+            std::string directory;
+            bool created_directory = false;
+            /**
+             * Images already in the journal are not imported again
+             */
+            std::shared_ptr<ImportJournal> journal;
+
+            int window_width = 400;
+            int window_center = 40;
+            ImVec2 crop_x;
+            ImVec2 crop_y;
+        };
+
+        /**
+         * @brief Imports DICOM images into the project as compressed numpy files
+         *
+         * Each image goes through two stages : read + decode + HU conversion, then compression + write. The decoded
+         * images wait in a bounded queue between the two stages. All the workers run the same loop (see run), which
+         * prefers to finish an image of the queue before decoding a new one, and which does both stages at once when
+         * the queue is full, so that the memory stays bounded whatever the speed of the disk.
+         *
+         * The crop is not applied to the image, it is saved alongside (as in import_dicom in import_data.py).
+         * Images that can not be decoded natively (compressed transfer syntaxes, multiple frames) are imported by
+         * import_data.import_dicom, under the GIL. Each image that has been saved is recorded in the journal of its
+         * series.
+         */
+        class ImportPipeline {
+        private:
+            struct Task {
+                size_t series;
+                int num;
+            };
+            struct DecodedImage {
+                size_t task;
+                cv::Mat matrix;
+                double pixel_spacing;
+                double slice_thickness;
+                double slice_location;
+            };
+
+            std::vector<ImportSeries> &series_;
+            std::string root_path_;
+
+            std::vector<Task> tasks_;
+            std::atomic<size_t> next_task_{0};
+
+            std::mutex queue_mutex_;
+            std::deque<DecodedImage> queue_;
+            size_t queue_capacity_;
+
+            std::atomic<int> num_done_{0};
+            std::atomic<bool> failed_{false};
+            std::mutex error_mutex_;
+            std::string error_msg_;
+
+            std::string filename(const Task &task) const;
+            bool is_cancelled(const Task &task) const;
+            void finish(const Task &task, bool imported);
+            void fail(const std::string &error_msg);
+
+            bool decode(const Task &task, DecodedImage &image);
+            void write(const DecodedImage &image);
+            void python_import(const Task &task);
+        public:
+            /**
+             * @param series series to import, their directory and journal should already exist
+             * @param root_path root of the project
+             * @param queue_capacity maximum number of decoded images waiting to be written
+             */
+            ImportPipeline(std::vector<ImportSeries> &series, const std::string &root_path, size_t queue_capacity);
+
+            /**
+             * Imports images until there is none left, the import failed or abort is set
+             *
+             * Can be called from multiple threads at the same time (see JobScheduler::parallelRun).
+             * @param abort stops the import
+             * @param progress if not null, updated with the fraction of imported images
+             */
+            void run(bool &abort, float *progress = nullptr);
+
+            int getNumDone() const { return num_done_; }
+            int getNumImages() const { return (int) tasks_.size(); }
+
+            bool hasFailed() const { return failed_; }
+            std::string getError();
+        };
+    }
+}
@@ -0,0 +1,517 @@
+#include "npz.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <algorithm>
+#include <fstream>
+
+#include <zlib.h>
+
+#include "binary_file.h"
+
+namespace core {
+    namespace dataset {
+        namespace {
+            // 1980-01-01 00:00, the earliest date of the zip format
+            const uint16_t DOS_TIME = 0;
+            const uint16_t DOS_DATE = (1 << 5) | 1;
+
+            void put_u16(std::string &out, uint16_t value) {
+                out.push_back((char) (value & 0xFF));
+                out.push_back((char) (value >> 8));
+            }
+
+            void put_u32(std::string &out, uint32_t value) {
+                put_u16(out, (uint16_t) (value & 0xFFFF));
+                put_u16(out, (uint16_t) (value >> 16));
+            }
+
+            std::string shape_string(const std::vector<size_t> &shape) {
+                std::string str = "(";
+                for (size_t i = 0; i < shape.size(); i++) {
+                    str += std::to_string(shape[i]);
+                    if (i + 1 < shape.size() || shape.size() == 1)
+                        str += ",";
+                    if (i + 1 < shape.size())
+                        str += " ";
+                }
+                return str + ")";
+            }
+
+            bool get_u16(const std::string &in, size_t pos, uint16_t &value) {
+                if (pos + 2 > in.size())
+                    return false;
+                value = (uint16_t) ((unsigned char) in[pos] | ((unsigned char) in[pos + 1] << 8));
+                return true;
+            }
+
+            bool get_u32(const std::string &in, size_t pos, uint32_t &value) {
+                uint16_t low, high;
+                if (!get_u16(in, pos, low) || !get_u16(in, pos + 2, high))
+                    return false;
+                value = (uint32_t) low | ((uint32_t) high << 16);
+                return true;
+            }
+
+            bool get_u64(const std::string &in, size_t pos, uint64_t &value) {
+                uint32_t low, high;
+                if (!get_u32(in, pos, low) || !get_u32(in, pos + 4, high))
+                    return false;
+                value = (uint64_t) low | ((uint64_t) high << 32);
+                return true;
+            }
+
+            /**
+             * Inflates raw deflate data, if partial is set the output may stop before the end of the stream
+             */
+            std::string inflate_data(const char *data, size_t size, size_t output_size, bool partial,
+                                     std::string &error) {
+                z_stream stream{};
+                if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+                    error = "Could not initialize the decompression";
+                    return "";
+                }
+                std::string output(output_size, '\0');
+                stream.next_in = (Bytef *) data;
+                stream.avail_in = (uInt) size;
+                stream.next_out = (Bytef *) &output[0];
+                stream.avail_out = (uInt) output.size();
+                int ret = inflate(&stream, partial ? Z_SYNC_FLUSH : Z_FINISH);
+                output.resize(stream.total_out);
+                inflateEnd(&stream);
+                bool valid = partial ? ret == Z_OK || ret == Z_STREAM_END || ret == Z_BUF_ERROR : ret == Z_STREAM_END;
+                if (!valid)
+                    error = "Could not decompress the data";
+                return output;
+            }
+
+            /**
+             * Parses the header of a .npy file
+             * @param required size of the file up to the end of the header, even if the header is not complete
+             * @return false if the header is not complete or not valid (error is set in the latter case)
+             */
+            bool parse_npy_header(const std::string &npy, NpyArray &array, size_t &required, std::string &error) {
+                required = 12;
+                if (npy.size() < 10)
+                    return false;
+                if (npy.compare(0, 6, "\x93NUMPY") != 0) {
+                    error = "Not a .npy array";
+                    return false;
+                }
+                size_t start;
+                size_t header_length;
+                if (npy[6] == 1) {
+                    uint16_t length;
+                    get_u16(npy, 8, length);
+                    header_length = length;
+                    start = 10;
+                }
+                else if (npy[6] == 2 || npy[6] == 3) {
+                    uint32_t length;
+                    if (!get_u32(npy, 8, length))
+                        return false;
+                    header_length = length;
+                    start = 12;
+                }
+                else {
+                    error = "Unsupported .npy version";
+                    return false;
+                }
+                required = start + header_length;
+                if (npy.size() < required)
+                    return false;
+
+                // The header is the repr of a python dict, e.g. {'descr': '<i2', 'fortran_order': False, 'shape': (2, 3), }
+                std::string header = npy.substr(start, header_length);
+                size_t descr_pos = header.find("'descr'");
+                size_t fortran_pos = header.find("'fortran_order'");
+                size_t shape_pos = header.find("'shape'");
+                if (descr_pos == std::string::npos || fortran_pos == std::string::npos || shape_pos == std::string::npos) {
+                    error = "Invalid .npy header";
+                    return false;
+                }
+                size_t descr_start = header.find('\'', descr_pos + 7);
+                size_t descr_end = descr_start == std::string::npos ? descr_start : header.find('\'', descr_start + 1);
+                size_t shape_start = header.find('(', shape_pos);
+                size_t shape_end = shape_start == std::string::npos ? shape_start : header.find(')', shape_start);
+                if (descr_end == std::string::npos || shape_end == std::string::npos) {
+                    error = "Invalid .npy header";
+                    return false;
+                }
+                array.descr = header.substr(descr_start + 1, descr_end - descr_start - 1);
+                size_t fortran_value = header.find_first_not_of(" :", fortran_pos + 15);
+                array.fortran_order = fortran_value != std::string::npos && header.compare(fortran_value, 4, "True") == 0;
+
+                array.shape.clear();
+                std::string dims = header.substr(shape_start + 1, shape_end - shape_start - 1);
+                size_t pos = 0;
+                while (pos < dims.size()) {
+                    size_t end = dims.find(',', pos);
+                    if (end == std::string::npos)
+                        end = dims.size();
+                    std::string dim = dims.substr(pos, end - pos);
+                    if (dim.find_first_not_of(' ') != std::string::npos) {
+                        try {
+                            array.shape.push_back((size_t) std::stoull(dim));
+                        }
+                        catch (const std::exception &) {
+                            error = "Invalid .npy shape";
+                            return false;
+                        }
+                    }
+                    pos = end + 1;
+                }
+                return true;
+            }
+
+            std::string deflate_data(const std::string &data, int level, std::string &error) {
+                z_stream stream{};
+                // Negative window bits for raw deflate data, the zip format has its own headers
+                if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                    error = "Could not initialize the compression";
+                    return "";
+                }
+                std::string compressed(deflateBound(&stream, (uLong) data.size()), '\0');
+                stream.next_in = (Bytef *) data.data();
+                stream.avail_in = (uInt) data.size();
+                stream.next_out = (Bytef *) &compressed[0];
+                stream.avail_out = (uInt) compressed.size();
+                int ret = deflate(&stream, Z_FINISH);
+                compressed.resize(stream.total_out);
+                deflateEnd(&stream);
+                if (ret != Z_STREAM_END)
+                    error = "Could not compress the data";
+                return compressed;
+            }
+        }
+
+        void NpzWriter::add_array(const std::string &name, const std::string &descr, const std::vector<size_t> &shape,
+                                  const char *data, size_t size) {
+            std::string header = "{'descr': '" + descr + "', 'fortran_order': False, 'shape': "
+                                 + shape_string(shape) + ", }";
+            // Magic string, version, header length and header are aligned on 64 bytes, ending with a new line
+            const size_t preamble = 10;
+            size_t total = preamble + header.size() + 1;
+            header.append((64 - total % 64) % 64, ' ');
+            header.push_back('\n');
+
+            std::string npy("\x93NUMPY\x01\x00", 8);
+            put_u16(npy, (uint16_t) header.size());
+            npy += header;
+            npy.append(data, size);
+            entries_.push_back(Entry{name + ".npy", std::move(npy)});
+        }
+
+        void NpzWriter::add(const std::string &name, const cv::Mat &matrix) {
+            std::string descr;
+            switch (matrix.type()) {
+                case CV_8U:
+                    descr = "|u1";
+                    break;
+                case CV_16S:
+                    descr = "<i2";
+                    break;
+                case CV_32S:
+                    descr = "<i4";
+                    break;
+                case CV_32F:
+                    descr = "<f4";
+                    break;
+                case CV_64F:
+                    descr = "<f8";
+                    break;
+                default:
+                    throw std::invalid_argument("Unsupported matrix type for npz");
+            }
+            cv::Mat continuous = matrix.isContinuous() ? matrix : matrix.clone();
+            add_array(name, descr, {(size_t) continuous.rows, (size_t) continuous.cols},
+                      (const char *) continuous.data, continuous.total() * continuous.elemSize());
+        }
+
+        void NpzWriter::add(const std::string &name, const std::vector<double> &values) {
+            add_array(name, "<f8", {values.size()}, (const char *) values.data(), values.size() * sizeof(double));
+        }
+
+        void NpzWriter::add(const std::string &name, const std::vector<int64_t> &values) {
+            add_array(name, "<i8", {values.size()}, (const char *) values.data(), values.size() * sizeof(int64_t));
+        }
+
+        bool NpzWriter::copy(const NpzReader &reader, const std::string &name) {
+            auto it = reader.entries_.find(name);
+            if (it == reader.entries_.end())
+                return false;
+            Entry entry;
+            entry.name = name + ".npy";
+            entry.is_raw = true;
+            entry.method = it->second.method;
+            entry.crc = it->second.crc;
+            entry.size = it->second.size;
+            entry.compressed = reader.archive_.substr(it->second.offset, it->second.compressed_size);
+            entries_.push_back(std::move(entry));
+            return true;
+        }
+
+        std::string NpzWriter::encode(std::string &archive, int level) const {
+            archive.clear();
+            std::string central_directory;
+            for (auto &entry: entries_) {
+                std::string error;
+                std::string compressed;
+                uint16_t method = entry.method;
+                uint32_t crc = entry.crc;
+                uint64_t size = entry.size;
+                if (!entry.is_raw) {
+                    compressed = deflate_data(entry.npy, level, error);
+                    if (!error.empty())
+                        return error;
+                    method = Z_DEFLATED;
+                    crc = (uint32_t) crc32(0L, (const Bytef *) entry.npy.data(), (uInt) entry.npy.size());
+                    size = entry.npy.size();
+                }
+                const std::string &data = entry.is_raw ? entry.compressed : compressed;
+                auto offset = (uint32_t) archive.size();
+
+                // Local file header
+                put_u32(archive, 0x04034b50);
+                put_u16(archive, 20);
+                put_u16(archive, 0);
+                put_u16(archive, method);
+                put_u16(archive, DOS_TIME);
+                put_u16(archive, DOS_DATE);
+                put_u32(archive, crc);
+                put_u32(archive, (uint32_t) data.size());
+                put_u32(archive, (uint32_t) size);
+                put_u16(archive, (uint16_t) entry.name.size());
+                put_u16(archive, 0);
+                archive += entry.name;
+                archive += data;
+
+                // Central directory header
+                put_u32(central_directory, 0x02014b50);
+                put_u16(central_directory, 20);
+                put_u16(central_directory, 20);
+                put_u16(central_directory, 0);
+                put_u16(central_directory, method);
+                put_u16(central_directory, DOS_TIME);
+                put_u16(central_directory, DOS_DATE);
+                put_u32(central_directory, crc);
+                put_u32(central_directory, (uint32_t) data.size());
+                put_u32(central_directory, (uint32_t) size);
+                put_u16(central_directory, (uint16_t) entry.name.size());
+                put_u16(central_directory, 0);
+                put_u16(central_directory, 0);
+                put_u16(central_directory, 0);
+                put_u16(central_directory, 0);
+                put_u32(central_directory, 0600u << 16);
+                put_u32(central_directory, offset);
+                central_directory += entry.name;
+            }
+
+            auto directory_offset = (uint32_t) archive.size();
+            archive += central_directory;
+
+            // End of central directory
+            put_u32(archive, 0x06054b50);
+            put_u16(archive, 0);
+            put_u16(archive, 0);
+            put_u16(archive, (uint16_t) entries_.size());
+            put_u16(archive, (uint16_t) entries_.size());
+            put_u32(archive, (uint32_t) central_directory.size());
+            put_u32(archive, directory_offset);
+            put_u16(archive, 0);
+            return "";
+        }
+
+        std::string NpzWriter::writeFile(const std::string &filename, const std::string &data) {
+            return writeFileAtomically(filename, [&data](std::ostream &file) {
+                file.write(data.data(), (std::streamsize) data.size());
+            });
+        }
+
+        bool NpyArray::toMat(cv::Mat &matrix) const {
+            int type;
+            if (descr == "|u1" || descr == "|b1")
+                type = CV_8U;
+            else if (descr == "<i2")
+                type = CV_16S;
+            else if (descr == "<i4")
+                type = CV_32S;
+            else if (descr == "<f4")
+                type = CV_32F;
+            else if (descr == "<f8")
+                type = CV_64F;
+            else
+                return false;
+            if (fortran_order || shape.size() != 2)
+                return false;
+
+            int rows = (int) shape[0];
+            int cols = (int) shape[1];
+            matrix.create(rows, cols, type);
+            size_t size = matrix.total() * matrix.elemSize();
+            if (data.size() != size)
+                return false;
+            if (size > 0)
+                memcpy(matrix.data, data.data(), size);
+            return true;
+        }
+
+        std::string NpzReader::open(const std::string &filename) {
+            std::ifstream file(filename, std::ios::binary);
+            if (!file)
+                return "Could not open '" + filename + "'";
+            std::string archive((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            if (file.bad())
+                return "Could not read '" + filename + "'";
+            std::string error = parse(std::move(archive));
+            if (!error.empty())
+                return "Could not read '" + filename + "': " + error;
+            return "";
+        }
+
+        std::string NpzReader::parse(std::string archive) {
+            archive_ = std::move(archive);
+            names_.clear();
+            entries_.clear();
+
+            // End of central directory, only followed by the comment of the archive
+            if (archive_.size() < 22)
+                return "Not a zip archive";
+            size_t end_record = std::string::npos;
+            for (size_t pos = archive_.size() - 22;; pos--) {
+                uint32_t signature;
+                get_u32(archive_, pos, signature);
+                if (signature == 0x06054b50) {
+                    end_record = pos;
+                    break;
+                }
+                if (pos == 0 || archive_.size() - pos > 22 + 0xFFFF)
+                    break;
+            }
+            if (end_record == std::string::npos)
+                return "Not a zip archive";
+
+            uint16_t num_entries16;
+            uint32_t directory_offset32;
+            get_u16(archive_, end_record + 10, num_entries16);
+            get_u32(archive_, end_record + 16, directory_offset32);
+            uint64_t num_entries = num_entries16;
+            uint64_t directory_offset = directory_offset32;
+
+            // Zip64 end of central directory
+            if (num_entries16 == 0xFFFF || directory_offset32 == 0xFFFFFFFF) {
+                uint32_t signature;
+                uint64_t record;
+                if (end_record < 20 || !get_u32(archive_, end_record - 20, signature) || signature != 0x07064b50
+                    || !get_u64(archive_, end_record - 12, record) || !get_u32(archive_, record, signature)
+                    || signature != 0x06064b50 || !get_u64(archive_, record + 32, num_entries)
+                    || !get_u64(archive_, record + 48, directory_offset))
+                    return "Invalid zip64 archive";
+            }
+
+            size_t pos = directory_offset;
+            for (uint64_t i = 0; i < num_entries; i++) {
+                uint32_t signature, crc, compressed_size, size, local_offset;
+                uint16_t method, name_length, extra_length, comment_length;
+                if (!get_u32(archive_, pos, signature) || signature != 0x02014b50
+                    || !get_u16(archive_, pos + 10, method) || !get_u32(archive_, pos + 16, crc)
+                    || !get_u32(archive_, pos + 20, compressed_size) || !get_u32(archive_, pos + 24, size)
+                    || !get_u16(archive_, pos + 28, name_length) || !get_u16(archive_, pos + 30, extra_length)
+                    || !get_u16(archive_, pos + 32, comment_length) || !get_u32(archive_, pos + 42, local_offset)
+                    || pos + 46 + name_length + extra_length > archive_.size())
+                    return "Invalid zip central directory";
+
+                Entry entry;
+                entry.method = method;
+                entry.crc = crc;
+                entry.compressed_size = compressed_size;
+                entry.size = size;
+                uint64_t offset = local_offset;
+                std::string name = archive_.substr(pos + 46, name_length);
+
+                // Sizes and offset that do not fit in 32 bits are in the zip64 extra field
+                size_t extra = pos + 46 + name_length;
+                size_t extra_end = extra + extra_length;
+                while (extra + 4 <= extra_end) {
+                    uint16_t id, length;
+                    get_u16(archive_, extra, id);
+                    get_u16(archive_, extra + 2, length);
+                    size_t field = extra + 4;
+                    if (id == 0x0001) {
+                        if (size == 0xFFFFFFFF && field + 8 <= extra_end) {
+                            get_u64(archive_, field, entry.size);
+                            field += 8;
+                        }
+                        if (compressed_size == 0xFFFFFFFF && field + 8 <= extra_end) {
+                            get_u64(archive_, field, entry.compressed_size);
+                            field += 8;
+                        }
+                        if (local_offset == 0xFFFFFFFF && field + 8 <= extra_end)
+                            get_u64(archive_, field, offset);
+                    }
+                    extra += 4 + length;
+                }
+
+                // The data follows the local header, whose extra field can differ from the central one
+                uint16_t local_name_length, local_extra_length;
+                if (!get_u32(archive_, offset, signature) || signature != 0x04034b50
+                    || !get_u16(archive_, offset + 26, local_name_length)
+                    || !get_u16(archive_, offset + 28, local_extra_length))
+                    return "Invalid zip local header";
+                entry.offset = offset + 30 + local_name_length + local_extra_length;
+                if (entry.offset + entry.compressed_size > archive_.size())
+                    return "Truncated zip archive";
+
+                if (name.size() > 4 && name.compare(name.size() - 4, 4, ".npy") == 0)
+                    name.resize(name.size() - 4);
+                names_.push_back(name);
+                entries_[name] = entry;
+                pos += 46 + name_length + extra_length + comment_length;
+            }
+            return "";
+        }
+
+        std::string NpzReader::read(const std::string &name, NpyArray &array, bool header_only) const {
+            auto it = entries_.find(name);
+            if (it == entries_.end())
+                return "No array '" + name + "' in the archive";
+            const Entry &entry = it->second;
+            const char *data = archive_.data() + entry.offset;
+            if (entry.method != 0 && entry.method != Z_DEFLATED)
+                return "Unsupported compression for the array '" + name + "'";
+
+            // Only the beginning of the array is decompressed to read its header
+            size_t length = header_only ? (size_t) std::min<uint64_t>(entry.size, 1024) : (size_t) entry.size;
+            while (true) {
+                std::string error;
+                std::string npy;
+                if (entry.method == 0)
+                    npy.assign(data, std::min<size_t>(length, entry.compressed_size));
+                else
+                    npy = inflate_data(data, entry.compressed_size, length, header_only, error);
+                if (!error.empty())
+                    return error + " of the array '" + name + "'";
+
+                size_t required;
+                if (!parse_npy_header(npy, array, required, error)) {
+                    if (error.empty() && header_only && required > length && length < entry.size) {
+                        length = (size_t) std::min<uint64_t>(entry.size, required);
+                        continue;
+                    }
+                    return (error.empty() ? "Truncated header" : error) + " in the array '" + name + "'";
+                }
+
+                if (header_only) {
+                    array.data.clear();
+                }
+                else {
+                    if ((uint32_t) crc32(0L, (const Bytef *) npy.data(), (uInt) npy.size()) != entry.crc)
+                        return "Corrupted array '" + name + "'";
+                    array.data = npy.substr(required);
+                }
+                return "";
+            }
+        }
+    }
+}
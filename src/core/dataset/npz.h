@@ -0,0 +1,139 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+
+#include "opencv2/opencv.hpp"
+
+namespace core {
+    namespace dataset {
+        class NpzReader;
+
+        /**
+         * Array of a .npy file
+         */
+        struct NpyArray {
+            std::string descr;
+            bool fortran_order = false;
+            std::vector<size_t> shape;
+            // Raw data of the array, empty if only the header has been read
+            std::string data;
+
+            /**
+             * Copies the data into a matrix, only C ordered 2D arrays of the types supported by NpzWriter
+             * (and booleans, read as CV_8U) can be converted
+             * @return false if the array can not be converted
+             */
+            bool toMat(cv::Mat &matrix) const;
+        };
+
+        /**
+         * @brief Writes numpy .npz archives, readable with numpy.load (same format as numpy.savez_compressed)
+         *
+         * The arrays are first serialized in the .npy format, then encode() compresses them into a zip
+         * archive in memory, which can be written to the disk with writeFile(). The two steps are separated
+         * so that the compression and the writing can run on different threads.
+         */
+        class NpzWriter {
+        private:
+            struct Entry {
+                std::string name;
+                std::string npy;
+
+                // Entry copied from another archive, without decompressing it
+                bool is_raw = false;
+                uint16_t method = 0;
+                uint32_t crc = 0;
+                uint64_t size = 0;
+                std::string compressed;
+            };
+            std::vector<Entry> entries_;
+
+            void add_array(const std::string &name, const std::string &descr, const std::vector<size_t> &shape,
+                           const char *data, size_t size);
+        public:
+            /**
+             * Adds a 2D matrix, only CV_8U, CV_16S, CV_32S, CV_32F and CV_64F single channel matrices are supported
+             */
+            void add(const std::string &name, const cv::Mat &matrix);
+
+            /**
+             * Adds a 1D array of float64
+             */
+            void add(const std::string &name, const std::vector<double> &values);
+
+            /**
+             * Adds a 1D array of int64
+             */
+            void add(const std::string &name, const std::vector<int64_t> &values);
+
+            /**
+             * Copies an array of another archive as it is (still compressed)
+             * @return false if the reader has no such array
+             */
+            bool copy(const NpzReader &reader, const std::string &name);
+
+            /**
+             * Compresses the arrays into a zip archive (deflate)
+             * @param archive content of the .npz file
+             * @param level zlib compression level
+             * @return error message if the compression failed
+             */
+            std::string encode(std::string &archive, int level = 6) const;
+
+            /**
+             * Writes the data into a temporary file which is then renamed, so that a reader never sees a
+             * partially written file
+             * @return error message if the file could not be written
+             */
+            static std::string writeFile(const std::string &filename, const std::string &data);
+        };
+
+        /**
+         * @brief Reads numpy .npz archives (numpy.savez or numpy.savez_compressed), one array at a time
+         *
+         * Only the arrays that are needed are decompressed, and the header of an array can be read without its
+         * data (e.g. to know its shape). Arrays of objects (pickled) can only be inspected through their header.
+         */
+        class NpzReader {
+        private:
+            struct Entry {
+                uint16_t method = 0;
+                uint32_t crc = 0;
+                uint64_t compressed_size = 0;
+                uint64_t size = 0;
+                uint64_t offset = 0;
+            };
+            std::string archive_;
+            // Entries by array name (without the .npy extension), in the order of the archive
+            std::vector<std::string> names_;
+            std::map<std::string, Entry> entries_;
+
+            friend class NpzWriter;
+        public:
+            /**
+             * Reads the archive and its list of arrays
+             * @return error message if the file could not be read or is not a valid archive
+             */
+            std::string open(const std::string &filename);
+
+            /**
+             * Same as open, with the content of the archive
+             */
+            std::string parse(std::string archive);
+
+            bool contains(const std::string &name) const { return entries_.find(name) != entries_.end(); }
+
+            const std::vector<std::string> &getNames() const { return names_; }
+
+            /**
+             * Reads an array of the archive
+             * @param header_only only the header (type and shape) is read
+             * @return error message
+             */
+            std::string read(const std::string &name, NpyArray &array, bool header_only = false) const;
+        };
+    }
+}
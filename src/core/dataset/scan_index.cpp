@@ -0,0 +1,177 @@
+#include "scan_index.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <functional>
+
+#include "binary_file.h"
+
+namespace core {
+    namespace dataset {
+        namespace fs = std::filesystem;
+
+        namespace {
+            // Index files are stored next to settings.toml, in the directory from which the app has been started
+            // (the working directory can change afterwards, e.g. with the file dialogs)
+            const fs::path INDEX_FOLDER = [] {
+                std::error_code error;
+                fs::path folder = fs::absolute("dicom_index", error);
+                return error ? fs::path("dicom_index") : folder;
+            }();
+            const char *INDEX_MAGIC = "BMIDX1";
+
+            // The index is compacted once there are more than COMPACT_RATIO records per existing file
+            const size_t COMPACT_RATIO = 2;
+
+            void write_record(std::ostream &out, const std::string &path, const ScanIndexEntry &entry) {
+                writeString(out, path);
+                writeU64(out, entry.size);
+                writeU64(out, (uint64_t) entry.mtime);
+                char flags = (char) ((entry.found ? 1 : 0) | (entry.has_case ? 2 : 0));
+                out.write(&flags, 1);
+                if (entry.has_case) {
+                    const Case &c = entry.case_;
+                    for (auto str: {&c.patientID, &c.studyDate, &c.studyTime, &c.studyDescription,
+                                     &c.seriesNumber, &c.modality, &c.instanceNumber}) {
+                        writeString(out, *str);
+                    }
+                }
+            }
+
+            /**
+             * Reads one record, returns false if the end of the file is reached or if the record is incomplete
+             * (e.g. the application stopped while appending)
+             */
+            bool read_record(std::istream &in, std::string &path, ScanIndexEntry &entry, uint64_t max_size) {
+                uint64_t mtime;
+                char flags;
+                if (!readString(in, path, max_size) || !readU64(in, entry.size) || !readU64(in, mtime))
+                    return false;
+                in.read(&flags, 1);
+                if (in.gcount() != 1)
+                    return false;
+                entry.mtime = (int64_t) mtime;
+                entry.found = flags & 1;
+                entry.has_case = flags & 2;
+                entry.case_ = Case();
+                if (entry.has_case) {
+                    Case &c = entry.case_;
+                    for (auto str: {&c.patientID, &c.studyDate, &c.studyTime, &c.studyDescription,
+                                     &c.seriesNumber, &c.modality, &c.instanceNumber}) {
+                        if (!readString(in, *str, max_size))
+                            return false;
+                    }
+                    c.path = path;
+                }
+                return true;
+            }
+        }
+
+        ScanIndex::ScanIndex(const std::string &root, const std::string &index_folder) {
+            std::error_code error;
+            fs::path absolute = fs::absolute(root, error);
+            root_ = (error ? fs::path(root) : absolute).lexically_normal().generic_string();
+
+            // The root is also stored in the file, in case of hash collision
+            char name[32];
+            snprintf(name, sizeof(name), "%016llx.idx", (unsigned long long) std::hash<std::string>{}(root_));
+            filename_ = ((index_folder.empty() ? INDEX_FOLDER : fs::path(index_folder)) / name).string();
+        }
+
+        std::string ScanIndex::load() {
+            entries_.clear();
+            num_records_ = 0;
+            file_valid_ = false;
+
+            std::error_code error;
+            uint64_t file_size = fs::file_size(filename_, error);
+            if (error)
+                return "";
+
+            std::ifstream file(filename_, std::ios::binary);
+            if (!file)
+                return "Could not open the index '" + filename_ + "'";
+
+            std::string magic;
+            std::string root;
+            if (!readString(file, magic, file_size) || magic != INDEX_MAGIC || !readString(file, root, file_size)
+                || root != root_) {
+                // Index of another version or of another folder, will be overwritten
+                return "";
+            }
+            file_valid_ = true;
+
+            std::string path;
+            ScanIndexEntry entry;
+            std::streamoff end_of_records = file.tellg();
+            while (read_record(file, path, entry, file_size)) {
+                entries_[path] = entry;
+                num_records_++;
+                end_of_records = file.tellg();
+            }
+            // An incomplete record at the end of the file (which can not be told apart from the end of the file by
+            // the reads) would corrupt the next appended records, the file is then rewritten by the next save
+            if (end_of_records < 0 || (uint64_t) end_of_records != file_size)
+                file_valid_ = false;
+            return "";
+        }
+
+        ScanIndexEntry *ScanIndex::lookup(const std::string &path, uint64_t size, int64_t mtime) {
+            auto it = entries_.find(path);
+            if (it == entries_.end() || it->second.size != size || it->second.mtime != mtime)
+                return nullptr;
+            it->second.seen = true;
+            return &it->second;
+        }
+
+        std::string ScanIndex::save(std::vector<std::pair<std::string, ScanIndexEntry>> &new_entries, bool complete) {
+            for (auto &new_entry: new_entries) {
+                new_entry.second.seen = true;
+                entries_[new_entry.first] = new_entry.second;
+            }
+
+            size_t num_seen = 0;
+            for (auto &entry: entries_) {
+                if (entry.second.seen)
+                    num_seen++;
+            }
+
+            if (!file_valid_ || (complete && num_records_ + new_entries.size() > COMPACT_RATIO * num_seen))
+                return rewrite();
+            if (new_entries.empty())
+                return "";
+
+            std::ofstream file(filename_, std::ios::binary | std::ios::app);
+            if (!file)
+                return "Could not write the index '" + filename_ + "'";
+            for (auto &new_entry: new_entries) {
+                write_record(file, new_entry.first, new_entry.second);
+            }
+            num_records_ += new_entries.size();
+            return file ? "" : "Could not write the index '" + filename_ + "'";
+        }
+
+        std::string ScanIndex::rewrite() {
+            std::error_code error;
+            fs::create_directories(fs::path(filename_).parent_path(), error);
+
+            std::string error_msg = writeFileAtomically(filename_, [this](std::ostream &file) {
+                writeString(file, INDEX_MAGIC);
+                writeString(file, root_);
+                num_records_ = 0;
+                for (auto &entry: entries_) {
+                    if (!entry.second.seen)
+                        continue;
+                    write_record(file, entry.first, entry.second);
+                    num_records_++;
+                }
+            });
+            if (!error_msg.empty())
+                return "Could not write the index: " + error_msg;
+            file_valid_ = true;
+            return "";
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include "explore.h"
+
+namespace core {
+    namespace dataset {
+        /**
+         * What has been found in a file during a previous scan
+         */
+        struct ScanIndexEntry {
+            uint64_t size = 0;
+            int64_t mtime = 0;
+            bool found = false;     // The file is a DICOM image (has pixel data)
+            bool has_case = false;  // The file has been added to the tree, the case is valid
+            Case case_;
+
+            bool seen = false;      // The file has been found during the current scan
+        };
+
+        /**
+         * @brief On disk index of the files read by previous explorations of a folder
+         *
+         * Each file is identified by its path, its size and its modification time. Files that did not change
+         * since the last exploration do not need to be read again.
+         *
+         * The index is an append-only file : new or changed files are appended at the end of the file, and the
+         * last record of a path wins when loading. Once the file contains too many outdated records, it is
+         * rewritten with only the files that still exist.
+         */
+        class ScanIndex {
+        private:
+            std::string root_;
+            std::string filename_;
+            std::unordered_map<std::string, ScanIndexEntry> entries_;
+            size_t num_records_ = 0;
+            bool file_valid_ = false;
+
+            std::string rewrite();
+        public:
+            /**
+             * @param root folder that is explored, each folder has its own index file
+             * @param index_folder folder of the index files, next to settings.toml if empty
+             */
+            explicit ScanIndex(const std::string &root, const std::string &index_folder = "");
+
+            /**
+             * Loads the index from the disk, a missing or corrupted index is not an error (the index is empty)
+             * @return error message if the index could not be read
+             */
+            std::string load();
+
+            /**
+             * Looks for a file in the index and marks it as seen
+             * Can be called from multiple threads at the same time (but not concurrently with save)
+             * @return the entry if the file has not changed since it was indexed, nullptr otherwise
+             */
+            ScanIndexEntry *lookup(const std::string &path, uint64_t size, int64_t mtime);
+
+            /**
+             * Adds the new entries to the index and writes them to the disk
+             * @param new_entries files that have been read during the scan
+             * @param complete true if the whole folder has been scanned, the index can only be compacted if
+             * all the files that still exist have been seen
+             * @return error message if the index could not be written
+             */
+            std::string save(std::vector<std::pair<std::string, ScanIndexEntry>> &new_entries, bool complete);
+
+            const std::string &getFilename() const { return filename_; }
+        };
+    }
+}
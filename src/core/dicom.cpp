@@ -1,5 +1,6 @@
 #include "dicom.h"
 #include "dataset/dicom_to_image.h"
+#include "profiler.h"
 
 #include <algorithm>
 
@@ -7,28 +8,78 @@ namespace core {
 
     int DicomSeries::num_loaded_ = 0;
 
+    inline int first_non_numeric(const std::string& str) {
+        int i = 0;
+        for (char chr : str) {
+            if (chr < 48 || chr > 57)
+                return i;
+            i++;
+        }
+        return i;
+    }
+
     DicomSeries::DicomSeries(file_format format) {
         format_ = format;
     }
 
-    DicomSeries::DicomSeries(std::vector<std::string> paths, const std::string& id, file_format format) : images_path_(paths), id_(id), format_(format) {
+    DicomSeries::DicomSeries(std::vector<std::string> paths, const std::string& id, file_format format) : images_path_(paths), format_(format) {
+        setId(id);
         init();
     }
 
     void DicomSeries::setPaths(const std::vector<std::string>& paths) {
         images_path_ = paths;
+        paths_loader_ = nullptr;
+        paths_loaded_ = true;
+        init();
+    }
+
+    void DicomSeries::setPathsLoader(const std::function<std::vector<std::string>()>& loader) {
+        cancelPendingJobs();
+        generation_++;
+        images_path_.clear();
+        data_.clear();
+        ref_counter_.clear();
+        paths_loader_ = loader;
+        paths_loaded_ = false;
+    }
+
+    void DicomSeries::load_paths() {
+        if (paths_loaded_)
+            return;
+        paths_loaded_ = true;
+        images_path_ = paths_loader_();
+        paths_loader_ = nullptr;
         init();
     }
 
     void DicomSeries::setId(const std::string& id) {
         id_ = id;
         id_pair_ = parse_dicom_id(id);
+
+        sort_key_ = DicomSortKey();
+        int prefix_length = first_non_numeric(id_pair_.first);
+        sort_key_.prefix_length = (uint32_t)prefix_length;
+        // Numbers that do not fit in 64 bits are left to the comparison of the ids
+        if (prefix_length <= 19) {
+            for (int i = 0; i < prefix_length; i++) {
+                sort_key_.prefix_value = sort_key_.prefix_value * 10 + (uint64_t)(id[i] - '0');
+            }
+            // First 8 bytes of the rest of the id, as a big endian number (same order as the strings)
+            for (int i = 0; i < 8; i++) {
+                size_t pos = prefix_length + i;
+                unsigned char chr = pos < id.size() ? (unsigned char)id[pos] : 0;
+                sort_key_.remainder_head = (sort_key_.remainder_head << 8) | chr;
+            }
+        }
     }
 
     void DicomSeries::init() {
+        // Jobs that are already running can not be stopped, their results must not go into the new images
         cancelPendingJobs();
+        generation_++;
         data_.clear();
-        id_pair_ = parse_dicom_id(id_);
+        ref_counter_.clear();
         for (auto& _ : images_path_) {
             data_.emplace_back(Dicom());
         }
@@ -53,24 +104,30 @@ namespace core {
     }
 
     void DicomSeries::loadAll(const std::function<void(const Dicom&)>& when_finished_fct) {
+        load_paths();
         load_all_ = true;
         for (int i = 0; i < data_.size(); i++) {
             load_case(i, false, true, when_finished_fct);
         }
     }
 
-    jobId DicomSeries::loadCase(float percentage, bool force_replace, const std::function<void(const Dicom&)>& when_finished_fct) {
+    jobId DicomSeries::loadCase(float percentage, bool force_replace, const std::function<void(const Dicom&)>& when_finished_fct,
+                                Job::jobPriority priority) {
+        load_paths();
         if (percentage >= 0.f && percentage <= 1.f) {
-            return load_case((int)((float)(data_.size() - 1) * percentage), force_replace, false, when_finished_fct);
+            return load_case((int)((float)(data_.size() - 1) * percentage), force_replace, false, when_finished_fct, priority);
         }
         return 0;
     }
 
-    jobId DicomSeries::loadCase(int index, bool force_replace, const std::function<void(const Dicom&)>& when_finished_fct) {
-        return load_case(index, force_replace, false, when_finished_fct);
+    jobId DicomSeries::loadCase(int index, bool force_replace, const std::function<void(const Dicom&)>& when_finished_fct,
+                                Job::jobPriority priority) {
+        return load_case(index, force_replace, false, when_finished_fct, priority);
     }
 
-    jobId DicomSeries::load_case(int index, bool force_replace, bool keep_previous, const std::function<void(const Dicom&)>& when_finished_fct) {
+    jobId DicomSeries::load_case(int index, bool force_replace, bool keep_previous, const std::function<void(const Dicom&)>& when_finished_fct,
+                                 Job::jobPriority priority) {
+        load_paths();
         if (index >= 0 && index < data_.size()) {
             if (!load_all_) {
                 cancelPendingJobs();
@@ -82,26 +139,27 @@ namespace core {
 
             data_[index].error_message.clear();
             if (!force_replace && data_[index].is_set) {
+                BM_PROFILE_COUNT("dicom/cache_hits", 1);
                 add_one_to_ref(index);
                 when_finished_fct(data_[index]);
                 return 0;
             }
 
+            BM_PROFILE_COUNT("dicom/cache_misses", 1);
+            unsigned int generation = generation_;
             jobResultFct when_finished = [=](const std::shared_ptr<JobResult>& result) {
+                if (generation != generation_) {
+                    // The index may not even exist anymore, the caller is still told that its request has ended
+                    Dicom replaced;
+                    replaced.error_message = "Images replaced";
+                    when_finished_fct(replaced);
+                    return;
+                }
                 auto dicom_result = std::dynamic_pointer_cast<dataset::DicomResult>(result);
                 if (dicom_result->success) {
                     if (!data_[index].is_set) {
                         auto& dicom = dicom_result->image;
-                        cv::Rect ROI(0, 0, dicom.data.rows, dicom.data.cols);
-                        if (crop_x_.x != crop_x_.y && crop_y_.x != crop_y_.y) {
-                            ROI = {
-                                    (int)((float)dicom.data.rows * crop_x_.x / 100.f),
-                                    (int)((float)dicom.data.cols * crop_y_.x / 100.f),
-                                    (int)((float)dicom.data.rows * (crop_x_.y - crop_x_.x) / 100.f),
-                                    (int)((float)dicom.data.rows * (crop_y_.y - crop_y_.x) / 100.f)
-                            };
-                        }
-                        data_[index].data = dicom.data(ROI);
+                        data_[index].data = dicom.data(cropRegion(dicom.data, crop_x_, crop_y_));
                         data_[index].is_set = true;
                         selected_index_ = index;
                         add_one_to_ref(index); // Add one reference to this index, only if the job is finished
@@ -117,12 +175,12 @@ namespace core {
 
             jobId id;
             if (format_ == F_NP) {
-                auto job = dataset::npy_to_matrix(images_path_[index], when_finished);
+                auto job = dataset::npy_to_matrix(images_path_[index], when_finished, priority);
                 id = job->id;
                 pending_jobs_.insert(job->id);
             }
             else {
-                auto job = dataset::dicom_to_matrix(images_path_[index], when_finished);
+                auto job = dataset::dicom_to_matrix(images_path_[index], when_finished, priority);
                 pending_jobs_.insert(job->id);
                 id = job->id;
             }
@@ -172,6 +230,7 @@ namespace core {
     }
 
     Dicom& DicomSeries::getCurrentDicom() {
+        load_paths();
         return data_[selected_index_];
     }
 
@@ -238,6 +297,19 @@ namespace core {
         }
     }
 
+    cv::Rect cropRegion(const cv::Mat& image, ImVec2 crop_x, ImVec2 crop_y) {
+        cv::Rect ROI(0, 0, image.rows, image.cols);
+        if (crop_x.x != crop_x.y && crop_y.x != crop_y.y) {
+            ROI = {
+                    (int)((float)image.rows * crop_x.x / 100.f),
+                    (int)((float)image.cols * crop_y.x / 100.f),
+                    (int)((float)image.rows * (crop_x.y - crop_x.x) / 100.f),
+                    (int)((float)image.rows * (crop_y.y - crop_y.x) / 100.f)
+            };
+        }
+        return ROI;
+    }
+
     std::pair<std::string, std::string> parse_dicom_id(const std::string& id) {
         int pos = id.find("___");
 
@@ -249,33 +321,14 @@ namespace core {
         }
     }
 
-    inline int first_non_numeric(const std::string& str) {
-        int i = 0;
-        for (char chr : str) {
-            if (chr < 48 || chr > 57)
-                return i;
-            i++;
-        }
-        return i;
-    }
-
     bool OrderDicom::operator() (const std::shared_ptr<DicomSeries>& dicom1, const std::shared_ptr<DicomSeries>& dicom2) const {
-        std::string id1 = dicom1->getId();
-        std::string id2 = dicom2->getId();
-
-        std::string name1 = parse_dicom_id(id1).first;
-        std::string name2 = parse_dicom_id(id2).first;
-
-        int i = 0;
-        std::string number1 = name1.substr(0, first_non_numeric(name1));
-        std::string number2 = name2.substr(0, first_non_numeric(name2));
-
-        if (number1.size() == number2.size()) {
-            return id1 < id2;
-        }
-        else {
-            return number1.size() < number2.size();
+        // Shorter numbers first, so that ids starting with a number are ordered by this number
+        const DicomSortKey& key1 = dicom1->getSortKey();
+        const DicomSortKey& key2 = dicom2->getSortKey();
+        if (key1 == key2) {
+            return dicom1->getId() < dicom2->getId();
         }
+        return key1 < key2;
     }
 
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <cstdint>
 #include <functional>
 #include <string>
 #include <set>
@@ -55,14 +56,45 @@ namespace core {
 
     std::pair<std::string, std::string> parse_dicom_id(const std::string& id);
 
+    /**
+     * Region of an image that is kept by the crops of a series (in percents), as applied when a case is loaded
+     */
+    cv::Rect cropRegion(const cv::Mat& image, ImVec2 crop_x, ImVec2 crop_y);
+
+    /**
+     * Compact key that orders the series as OrderDicom, computed once from the id
+     *
+     * Ids whose patient starts with a shorter number come first, then the ids are ordered by this number and by the
+     * first bytes of the rest of the id. Only keys that are equal need to compare the full ids.
+     */
+    struct DicomSortKey {
+        uint32_t prefix_length = 0;
+        uint64_t prefix_value = 0;
+        uint64_t remainder_head = 0;
+
+        bool operator<(const DicomSortKey& rhs) const {
+            if (prefix_length != rhs.prefix_length)
+                return prefix_length < rhs.prefix_length;
+            if (prefix_value != rhs.prefix_value)
+                return prefix_value < rhs.prefix_value;
+            return remainder_head < rhs.remainder_head;
+        }
+        bool operator==(const DicomSortKey& rhs) const {
+            return prefix_length == rhs.prefix_length && prefix_value == rhs.prefix_value && remainder_head == rhs.remainder_head;
+        }
+    };
+
     class DicomSeries {
     public:
         enum file_format { F_DICOM, F_NP };
     private:
         std::vector<Dicom> data_;
         std::vector<std::string> images_path_;
+        std::function<std::vector<std::string>()> paths_loader_;
+        bool paths_loaded_ = true;
         std::string id_;
         std::pair<std::string, std::string> id_pair_;
+        DicomSortKey sort_key_;
         std::vector<DicomCoordinate> coordinates_;
         ImVec2 crop_x_ = ImVec2(0, 100);
         ImVec2 crop_y_ = ImVec2(0, 100);
@@ -78,6 +110,8 @@ namespace core {
         DicomCoordinate current_coordinate_;
 
         std::set<jobId> pending_jobs_;
+        // Incremented when the images are replaced, the loading jobs of the previous images are then ignored
+        unsigned int generation_ = 0;
         int selected_index_ = 0;
         int num_jobs_ = 0;
         bool load_all_ = false;
@@ -89,9 +123,11 @@ namespace core {
         void add_one_to_ref(int idx);
         void remove_one_to_ref(int idx);
 
-        jobId load_case(int index, bool force_replace, bool keep_previous, const std::function<void(const Dicom&)>& when_finished_fct = [](const Dicom&) {});
+        jobId load_case(int index, bool force_replace, bool keep_previous, const std::function<void(const Dicom&)>& when_finished_fct = [](const Dicom&) {},
+                        Job::jobPriority priority = Job::JOB_PRIORITY_NORMAL);
 
         void init();
+        void load_paths();
     public:
         DicomSeries(file_format format = F_DICOM);
         explicit DicomSeries(std::vector<std::string> paths, const std::string& id = "", file_format format = F_DICOM);
@@ -99,11 +135,28 @@ namespace core {
         ~DicomSeries();
 
         void setPaths(const std::vector<std::string> &paths);
+        /**
+         * The paths will be read with the loader the first time they are needed (size, getPaths, loadCase, ...),
+         * so that a series which is never viewed costs only its id
+         */
+        void setPathsLoader(const std::function<std::vector<std::string>()>& loader);
+        bool arePathsLoaded() const { return paths_loaded_; }
         void setId(const std::string& id);
 
         void loadAll(const std::function<void(const Dicom&)>& when_finished_fct = [](const Dicom&) {});
-        jobId loadCase(float percentage, bool force_replace = false, const std::function<void(const Dicom&)>& when_finished_fct = [](const Dicom&) {});
-        jobId loadCase(int index, bool force_replace = false, const std::function<void(const Dicom&)>& when_finished_fct = [](const Dicom&) {});
+        /**
+         * Loads a case in a job of the JobScheduler, when_finished_fct is called once the case is loaded
+         * (immediately if it was already loaded, in which case 0 is returned)
+         * If the images are replaced in the meantime (see getGeneration), when_finished_fct is called with a Dicom
+         * which is not set and has an error message
+         * Canceled jobs (cancelPendingJobs, which is also called by the next loadCase of the series) never call it
+         * @param priority priority of the loading job, e.g. higher for the cases that are visible on screen
+         * @return id of the loading job
+         */
+        jobId loadCase(float percentage, bool force_replace = false, const std::function<void(const Dicom&)>& when_finished_fct = [](const Dicom&) {},
+                       Job::jobPriority priority = Job::JOB_PRIORITY_NORMAL);
+        jobId loadCase(int index, bool force_replace = false, const std::function<void(const Dicom&)>& when_finished_fct = [](const Dicom&) {},
+                       Job::jobPriority priority = Job::JOB_PRIORITY_NORMAL);
 
         void unloadCase(int index = -1);
         void unloadAll(bool keep_current = false);
@@ -114,19 +167,23 @@ namespace core {
         ImVec2 getCropY() { return crop_y_; }
         int& getWW() { return window_width_; }
         int& getWC() { return window_center_; }
-        int size() { return images_path_.size(); }
+        int size() { load_paths(); return images_path_.size(); }
 
         int rows();
         int cols();
 
-        std::vector<Dicom>& getData() { return data_; }
+        std::vector<Dicom>& getData() { load_paths(); return data_; }
         int getCurrentIndex() const { return selected_index_; }
 
-        std::string getId() { return id_; }
+        const std::string& getId() const { return id_; }
         std::pair<std::string, std::string> getIdPair() { return id_pair_; }
+        /**
+         * Sort key of the id, computed once by setId (see OrderDicom)
+         */
+        const DicomSortKey& getSortKey() const { return sort_key_; }
         Dicom& getCurrentDicom();
 
-        std::vector<std::string>& getPaths() { return images_path_; }
+        std::vector<std::string>& getPaths() { load_paths(); return images_path_; }
 
         void removeCoordinate();
         void addCoordinate(const DicomCoordinate& coordinate);
@@ -138,6 +195,10 @@ namespace core {
         void setCropY(ImVec2 crop_y, bool no_reload = false);
 
         bool isReady();
+        /**
+         * Changes each time the images of the series are replaced
+         */
+        unsigned int getGeneration() { load_paths(); return generation_; }
     };
 
 
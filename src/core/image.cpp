@@ -3,6 +3,8 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include "profiler.h"
+
 void core::Image::reset() {
     if (success_) {
         success_ = false;
@@ -29,6 +31,8 @@ void core::Image::load_texture(unsigned char *data, int width, int height, Filte
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, gl_filter);
 
     // Upload pixels into texture
+    BM_PROFILE_SCOPE("image/texture_upload");
+    BM_PROFILE_COUNT("image/texture_upload_bytes", (int64_t)width * height * 4);
     glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
     texture_ = image_texture;
@@ -69,10 +73,11 @@ bool core::Image::setImage(unsigned char *data, int width, int height, Filtering
     return success_;
 }
 
-bool core::Image::setImageFromHU(const cv::Mat& image, float window_width, float window_center, Filtering filtering, const cv::Mat& mask, ImVec4 mask_color,
-                                 bool show_mask, bool compare_with_other_mask, const cv::Mat& other_mask,
-                                 const std::set<int> &debug_lines_x, const std::set<int> &debug_lines_y) {
-    auto* new_image = new unsigned char[(int)image.rows * (int)image.cols * 4];
+void core::huToRGBA(const cv::Mat& image, float window_width, float window_center, cv::Mat& rgba, const cv::Mat& mask,
+                    ImVec4 mask_color, bool show_mask, bool compare_with_other_mask, const cv::Mat& other_mask,
+                    const std::set<int> &debug_lines_x, const std::set<int> &debug_lines_y) {
+    rgba.create(image.rows, image.cols, CV_8UC4);
+    auto* new_image = rgba.data;
     int new_image_pixel_index = 0;
 
     bool draw_mask = mask.rows == image.rows && mask.cols == image.cols
@@ -174,8 +179,16 @@ bool core::Image::setImageFromHU(const cv::Mat& image, float window_width, float
         }
     }
 
-    load_texture_from_memory(new_image, image.cols, image.rows, filtering);
-    delete [] new_image;
+}
+
+bool core::Image::setImageFromHU(const cv::Mat& image, float window_width, float window_center, Filtering filtering, const cv::Mat& mask, ImVec4 mask_color,
+                                 bool show_mask, bool compare_with_other_mask, const cv::Mat& other_mask,
+                                 const std::set<int> &debug_lines_x, const std::set<int> &debug_lines_y) {
+    BM_PROFILE_SCOPE("image/setImageFromHU");
+    cv::Mat rgba;
+    huToRGBA(image, window_width, window_center, rgba, mask, mask_color, show_mask, compare_with_other_mask, other_mask,
+             debug_lines_x, debug_lines_y);
+    load_texture_from_memory(rgba.data, image.cols, image.rows, filtering);
     return false;
 }
 
@@ -7,6 +7,16 @@
 
 namespace core {
 
+    /**
+     * Converts a DICOM image in Houndsfield units to RGBA pixels (CPU part of Image::setImageFromHU)
+     * @param rgba output image (CV_8UC4, same size as the image)
+     * See Image::setImageFromHU for the other parameters
+     */
+    void huToRGBA(const cv::Mat& image, float window_width, float window_center, cv::Mat& rgba,
+                  const cv::Mat& mask = cv::Mat(), ImVec4 mask_color = ImVec4(0, 0, 0, 0), bool show_mask = true,
+                  bool compare_with_other_mask = false, const cv::Mat& other_mask = cv::Mat(),
+                  const std::set<int> &debug_lines_x = std::set<int>(), const std::set<int> &debug_lines_y = std::set<int>());
+
     /**
      * Image class for holding images in memory to be drawn to Dear ImGui
      */
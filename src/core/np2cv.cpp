@@ -1,3 +1,132 @@
 #include "np2cv.h"
 
+#include <pybind11/numpy.h>
+
+#include "python/executor.h"
+
 namespace py = pybind11;
+
+namespace core {
+    namespace {
+        /**
+         * Allocator of the matrices that wrap a numpy array (userdata holds the reference to the array)
+         */
+        class NumpyViewAllocator : public cv::MatAllocator {
+        private:
+            const cv::MatAllocator* std_allocator_ = cv::Mat::getStdAllocator();
+        public:
+            cv::UMatData* wrap(PyObject* object, void* data, size_t size) const {
+                auto u = new cv::UMatData(this);
+                u->data = u->origdata = static_cast<uchar*>(data);
+                u->size = size;
+                u->userdata = object;
+                return u;
+            }
+
+            // The new matrices are never numpy arrays
+            cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                                   cv::AccessFlag flags, cv::UMatUsageFlags usage_flags) const override {
+                return std_allocator_->allocate(dims, sizes, type, data, step, flags, usage_flags);
+            }
+
+            bool allocate(cv::UMatData* data, cv::AccessFlag access_flags,
+                          cv::UMatUsageFlags usage_flags) const override {
+                return std_allocator_->allocate(data, access_flags, usage_flags);
+            }
+
+            void deallocate(cv::UMatData* u) const override {
+                if (u == nullptr)
+                    return;
+                CV_Assert(u->refcount >= 0);
+                if (u->refcount == 0) {
+                    // The matrix may be released on any thread
+                    PyAPI::Executor::release(static_cast<PyObject*>(u->userdata));
+                    delete u;
+                }
+            }
+        };
+
+        NumpyViewAllocator numpy_view_allocator;
+
+        int cv_depth(const py::dtype& dtype) {
+            char kind = dtype.kind();
+            auto size = dtype.itemsize();
+            if (kind == 'b' || (kind == 'u' && size == 1))
+                return CV_8U;
+            if (kind == 'i' && size == 1)
+                return CV_8S;
+            if (kind == 'u' && size == 2)
+                return CV_16U;
+            if (kind == 'i' && size == 2)
+                return CV_16S;
+            if (kind == 'i' && size == 4)
+                return CV_32S;
+            if (kind == 'f' && size == 4)
+                return CV_32F;
+            if (kind == 'f' && size == 8)
+                return CV_64F;
+            throw std::runtime_error("Numpy arrays of type '" + std::string(1, kind) + std::to_string(size) +
+                                     "' can not be converted to cv::Mat");
+        }
+
+        py::dtype npy_dtype(int depth) {
+            switch (depth) {
+                case CV_8U: return py::dtype::of<uint8_t>();
+                case CV_8S: return py::dtype::of<int8_t>();
+                case CV_16U: return py::dtype::of<uint16_t>();
+                case CV_16S: return py::dtype::of<int16_t>();
+                case CV_32S: return py::dtype::of<int32_t>();
+                case CV_32F: return py::dtype::of<float>();
+                case CV_64F: return py::dtype::of<double>();
+                default: throw std::runtime_error("cv::Mat of depth " + std::to_string(depth) +
+                                                  " can not be converted to a numpy array");
+            }
+        }
+    }
+
+    void npy_buffer_to_cv(py::object object, cv::Mat& mat) {
+        auto array = py::array::ensure(object, py::array::c_style);
+        if (!array)
+            throw std::runtime_error("Object can not be converted to a numpy array");
+        if (!array.writeable())
+            array = py::array::ensure(array.attr("copy")(), py::array::c_style);
+        if (array.ndim() < 1 || array.ndim() > CV_MAX_DIM)
+            throw std::runtime_error("Numpy arrays of " + std::to_string(array.ndim()) +
+                                     " dimensions can not be converted to cv::Mat");
+
+        std::vector<int> sizes(array.shape(), array.shape() + array.ndim());
+        std::vector<size_t> steps(array.strides(), array.strides() + array.ndim());
+        if (sizes.size() == 1) {
+            // cv::Mat has at least 2 dimensions
+            sizes.push_back(1);
+            steps.push_back(array.itemsize());
+        }
+
+        int type = CV_MAKETYPE(cv_depth(array.dtype()), 1);
+        cv::Mat view((int)sizes.size(), sizes.data(), type, array.mutable_data(), steps.data());
+        size_t size = array.nbytes();
+        view.u = numpy_view_allocator.wrap(array.release().ptr(), view.data, size);
+        view.addref();
+        mat = view;
+    }
+
+    py::object cv_to_npy(const cv::Mat& mat) {
+        if (mat.empty())
+            return py::none();
+
+        std::vector<py::ssize_t> shape, strides;
+        for (int i = 0; i < mat.dims; i++) {
+            shape.push_back(mat.size[i]);
+            strides.push_back((py::ssize_t)mat.step[i]);
+        }
+        if (mat.channels() > 1) {
+            shape.push_back(mat.channels());
+            strides.push_back((py::ssize_t)mat.elemSize1());
+        }
+
+        // The capsule shares the data of the matrix with the array
+        auto owner = new cv::Mat(mat);
+        py::capsule base(owner, [](void* ptr) { delete static_cast<cv::Mat*>(ptr); });
+        return py::array(npy_dtype(mat.depth()), shape, strides, owner->data, base);
+    }
+}
@@ -5,5 +5,23 @@
 
 namespace core {
 
+    /**
+     * Wraps a numpy array as a cv::Mat, without copying the data
+     *
+     * The matrix holds a reference to the array, which is released by the Executor once the last matrix that
+     * shares the data is released, so that the matrix can be used outside of the GIL. Arrays that are not
+     * contiguous or not writable are copied first.
+     * Must be called with the GIL.
+     */
     void npy_buffer_to_cv(pybind11::object object, cv::Mat& mat);
-}
\ No newline at end of file
+
+    /**
+     * Exposes a cv::Mat to Python as a numpy array, without copying the data
+     *
+     * The array is a view on the data of the matrix, which is kept alive as long as the array is. The matrix
+     * should not be modified while Python uses the array.
+     * Must be called with the GIL.
+     * @return the array, None if the matrix is empty
+     */
+    pybind11::object cv_to_npy(const cv::Mat& mat);
+}
@@ -1,11 +1,87 @@
 #include "project.h"
-#include "python/py_api.h"
-#include "pybind11/pybind11.h"
-#include "pybind11/stl.h"
+
+#include <cctype>
+#include <limits>
+#include <locale>
+#include <memory>
+#include <stdexcept>
+#include <fstream>
+#include <filesystem>
+#include <toml.hpp>
+
+#include "core/dataset/directory_manifest.h"
+#include "log.h"
 
 namespace core {
     namespace project {
-        namespace py = pybind11;
+        namespace fs = std::filesystem;
+
+        namespace {
+            /**
+             * Locale used to classify the non-ASCII characters as str.isalnum, nullptr if no UTF-8 locale exists
+             */
+            const std::locale* unicode_locale() {
+                static const std::unique_ptr<std::locale> locale = [] {
+                    for (const char* name : {"C.UTF-8", "en_US.UTF-8", ".UTF-8"}) {
+                        try {
+                            return std::make_unique<std::locale>(name);
+                        }
+                        catch (const std::runtime_error&) {}
+                    }
+                    return std::unique_ptr<std::locale>();
+                }();
+                return locale.get();
+            }
+
+            /**
+             * Decodes the UTF-8 character at pos, returns 0 if it is invalid
+             * @param length number of bytes of the character
+             */
+            char32_t decode_utf8(const std::string& str, size_t pos, size_t& length) {
+                unsigned char first = (unsigned char)str[pos];
+                length = first < 0x80 ? 1 : first >= 0xF0 ? 4 : first >= 0xE0 ? 3 : first >= 0xC0 ? 2 : 0;
+                if (length == 0 || pos + length > str.size()) {
+                    length = 1;
+                    return 0;
+                }
+                char32_t code = length == 1 ? first : first & (0xFF >> (length + 1));
+                for (size_t i = 1; i < length; i++) {
+                    unsigned char next = (unsigned char)str[pos + i];
+                    if ((next & 0xC0) != 0x80) {
+                        length = i;
+                        return 0;
+                    }
+                    code = (code << 6) | (next & 0x3F);
+                }
+                return code;
+            }
+        }
+
+        std::string makeSafeFilename(const std::string& name) {
+            std::string stripped;
+            for (size_t pos = 0; pos < name.size();) {
+                size_t length;
+                char32_t code = decode_utf8(name, pos, length);
+                bool alnum;
+                if (code < 0x80)
+                    alnum = code != 0 && std::isalnum((int)code);
+                else if (unicode_locale() == nullptr)
+                    alnum = true; // Can not be classified, kept as most of them are letters
+                else
+                    alnum = code <= (char32_t)std::numeric_limits<wchar_t>::max() &&
+                            std::isalnum((wchar_t)code, *unicode_locale());
+                if (alnum) {
+                    stripped.append(name, pos, length);
+                }
+                else if (stripped.empty() || stripped.back() != '_') {
+                    stripped.push_back('_');
+                }
+                pos += length;
+            }
+            while (!stripped.empty() && stripped.back() == '_')
+                stripped.pop_back();
+            return stripped;
+        }
 
         Project::Project(const std::string &name, const std::string &description)
                 : name_(name), description_(description) {
@@ -35,41 +111,28 @@ namespace core {
             }
         }
         bool Project::setUpWorkspace(const std::string& path, const std::string& name, const std::string& extension, std::string& out_path) {
-            auto state = PyGILState_Ensure();
-            try {
-                py::module scripts = py::module::import("python.scripts.workspace");
-                py::tuple return_tuple = scripts.attr("setup_workspace")(path, name, extension).cast<py::tuple>();
-                if (return_tuple[0].cast<bool>()) {
-                    out_path = return_tuple[1].cast<std::string>();
-                }
-                else {
-                    out_path = return_tuple[1].cast<std::string>();
-                    PyGILState_Release(state);
+            // Same directories as setup_workspace in workspace.py
+            std::error_code error;
+            if (!fs::is_directory(path, error)) {
+                out_path = "Path is not a directory";
+                return false;
+            }
+            std::string safe_name = makeSafeFilename(name);
+            fs::path root = fs::path(path) / safe_name;
+            for (auto& directory : { root / "data" / "dicoms", root / "data" / "masks", root / "tmp" / "train" / "x",
+                                     root / "tmp" / "train" / "y", root / "models" }) {
+                fs::create_directories(directory, error);
+                if (error) {
+                    out_path = "Could not create directories: " + error.message();
                     return false;
                 }
             }
-            catch (const std::exception& e) {
-                out_path = e.what();
-                PyGILState_Release(state);
-                return false;
-            }
-
-            PyGILState_Release(state);
+            out_path = (root / (safe_name + "." + extension)).string();
             return true;
         }
         void Project::setSaveFile(const std::string& save_file) {
             save_file_ = save_file;
-            auto state = PyGILState_Ensure();
-            try {
-                py::module scripts = py::module::import("python.scripts.workspace");
-                root_path_ = scripts.attr("get_root")(save_file).cast<std::string>();
-            }
-            catch (const std::exception& e) {
-                PyGILState_Release(state);
-                return;
-            }
-
-            PyGILState_Release(state);
+            root_path_ = fs::path(save_file).parent_path().string();
         }
         void Project::setUsers(std::vector<std::string> users) {
             users_.clear();
@@ -85,78 +148,123 @@ namespace core {
         }
 
         std::string Project::saveSegmentations() {
-            auto state = PyGILState_Ensure();
+            // Same file as save_segmentation in segmentation.py
             for (auto& seg : segmentations_) {
-                try {
-                    py::module scripts = py::module::import("python.scripts.segmentation");
-                    auto color = seg->getMaskColor();
-                    std::vector<float> color_arr = { color.x, color.y, color.z, color.w };
-                    auto save_file = scripts.attr("save_segmentation")(save_file_, seg->getName(), seg->getDescription(), seg->getFilename(), color_arr).cast<std::string>();
-                    seg->setFilename(save_file);
-                }   
-                catch (const std::exception& e) {
-                    PyGILState_Release(state);
-                    return e.what();
+                std::string stripped_name = makeSafeFilename(seg->getName());
+                std::string save_file = seg->getFilename();
+                std::error_code error;
+                if (save_file.empty()) {
+                    save_file = (fs::path(root_path_) / "models" / (stripped_name + ".seg")).string();
+                    if (fs::is_regular_file(save_file, error))
+                        return "Segmentation with near identical name already exists";
+                    fs::create_directories(fs::path(root_path_) / "data" / "masks" / stripped_name, error);
                 }
+
+                auto color = seg->getMaskColor();
+                auto& model = seg->getModelConfig();
+                const toml::value data{
+                        {"name", seg->getName()},
+                        {"description", seg->getDescription()},
+                        {"stripped_name", stripped_name},
+                        {"color", std::vector<float>{ color.x, color.y, color.z, color.w }},
+                        {"model", toml::table{
+                                {"ww", model.ww}, {"wc", model.wc}, {"input_size", model.input_size}}}
+                };
+                std::ofstream file(save_file, std::ios::trunc);
+                file << data << std::endl;
+                if (!file)
+                    return "Could not write '" + save_file + "'";
+                seg->setFilename(save_file);
             }
-            PyGILState_Release(state);
             return "";
         }
         std::string Project::loadSegmentations() {
             segmentations_.clear();
-            auto state = PyGILState_Ensure();
             try {
-                auto dicoms = dataset_.getDicoms();
+                const auto& dicoms = dataset_.getDicoms();
                 std::map <std::string, std::shared_ptr<DicomSeries>> dicom_id_map;
 
                 for (auto& dicom : dicoms) {
                     dicom_id_map[dicom->getId()] = dicom;
                 }
 
-                py::module scripts = py::module::import("python.scripts.segmentation");
-                auto result = scripts.attr("load_segmentations")(root_path_);
-                for (auto& seg : result) {
-                    segmentation::Segmentation segmentation(seg["name"].cast<std::string>(), seg["description"].cast<std::string>());
-                    segmentation.setFilename(seg["path"].cast<std::string>());
-                    segmentation.setStrippedName(seg["stripped_name"].cast<std::string>());
-                    segmentation.setMaskColor(seg["color"].cast <std::vector<float>>());
-                    for (auto& id : seg["ids"]) {
-                        std::string _id = id.cast<std::string>();
-                        if (dicom_id_map.find(_id) == dicom_id_map.end()) {
-                            segmentation.addDicom(dicom_id_map[_id]);
+                std::filesystem::path root(root_path_);
+                if (!std::filesystem::is_directory(root))
+                    return "Project path is not a directory";
+
+                // Segmentation files (.seg) in the models directory, and their masks directories
+                std::vector<segmentation::Segmentation> segmentations;
+                std::vector<std::string> mask_directories;
+                for (auto& entry : std::filesystem::directory_iterator(root / "models")) {
+                    if (!entry.is_regular_file() || entry.path().extension() != ".seg")
+                        continue;
+                    const auto data = toml::parse(entry.path().string());
+                    segmentation::Segmentation segmentation(toml::find<std::string>(data, "name"), toml::find<std::string>(data, "description"));
+                    segmentation.setFilename(entry.path().string());
+                    segmentation.setStrippedName(toml::find<std::string>(data, "stripped_name"));
+                    std::vector<float> color;
+                    for (auto& value : toml::find<toml::array>(data, "color")) {
+                        color.push_back(value.is_integer() ? (float)value.as_integer() : (float)value.as_floating());
+                    }
+                    if (color.size() != 4)
+                        return "Invalid color in '" + entry.path().string() + "'";
+                    segmentation.setMaskColor(color);
+                    // Segmentations saved by older versions have no model table, the defaults are kept
+                    if (data.is_table() && data.as_table().count("model")) {
+                        const auto& model = toml::find(data, "model");
+                        auto& config = segmentation.getModelConfig();
+                        config.ww = toml::find_or<int>(model, "ww", config.ww);
+                        config.wc = toml::find_or<int>(model, "wc", config.wc);
+                        config.input_size = toml::find_or<int>(model, "input_size", config.input_size);
+                    }
+
+                    segmentations.push_back(segmentation);
+                    mask_directories.push_back((root / "data" / "masks" / segmentation.getStrippedName()).string());
+                }
+
+                dataset::DirectoryManifest manifest(root_path_);
+                std::string manifest_error = manifest.load();
+                if (!manifest_error.empty())
+                    BM_DEBUG(manifest_error);
+                std::vector<std::vector<std::string>> listings;
+                std::string list_error = manifest.list(mask_directories, listings);
+                if (!list_error.empty())
+                    return list_error;
+                manifest_error = manifest.save();
+                if (!manifest_error.empty())
+                    BM_DEBUG(manifest_error);
+
+                for (size_t i = 0; i < segmentations.size(); i++) {
+                    auto& segmentation = segmentations[i];
+                    // The masks are saved as <id>.npz
+                    for (auto& name : listings[i]) {
+                        if (name.size() < 4)
+                            continue;
+                        auto it = dicom_id_map.find(name.substr(0, name.size() - 4));
+                        if (it != dicom_id_map.end()) {
+                            segmentation.addDicom(it->second);
                         }
                     }
                     segmentations_.insert(std::make_shared<segmentation::Segmentation>(segmentation));
                 }
             }
             catch (const std::exception& e) {
-                PyGILState_Release(state);
                 std::cout << e.what() << std::endl;
                 return e.what();
             }
-            PyGILState_Release(state);
             return "";
         }
         std::string Project::addSegmentation(std::shared_ptr<segmentation::Segmentation> segmentation) {
-            auto state = PyGILState_Ensure();
-            try {
-                auto util = py::module::import("python.scripts.util");
-                for (auto& seg : segmentations_) {
-                    if (seg->getName() == segmentation->getName()) {
-                        return std::string("A segmentation with identical name already exists");
-                    }
-                    if (util.attr("make_safe_filename")(segmentation->getName()).cast<std::string>() == seg->getStrippedName()) {
-                        PyGILState_Release(state);
-                        return std::string("Cannot have an (almost) identical name to an existing segmentation");
-                    }
+            std::string stripped_name = makeSafeFilename(segmentation->getName());
+            for (auto& seg : segmentations_) {
+                if (seg->getName() == segmentation->getName()) {
+                    return std::string("A segmentation with identical name already exists");
+                }
+                if (stripped_name == seg->getStrippedName()) {
+                    return std::string("Cannot have an (almost) identical name to an existing segmentation");
                 }
-                segmentation->setStrippedName(util.attr("make_safe_filename")(segmentation->getName()).cast<std::string>());
-            }
-            catch (const std::exception& e) {
-                PyGILState_Release(state);
-                return e.what();
             }
-            PyGILState_Release(state);
+            segmentation->setStrippedName(stripped_name);
             segmentations_.insert(segmentation);
             return "";
         }
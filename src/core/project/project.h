@@ -11,6 +11,16 @@
 
 namespace core {
     namespace project {
+        /**
+         * Name that can be used as a filename, same as make_safe_filename in util.py
+         * (characters that are not alphanumeric are replaced by '_')
+         *
+         * The UTF-8 characters are classified with a UTF-8 locale of the C++ library, which follows the Unicode
+         * letters and digits as str.isalnum (symbols such as '°' or '€' are replaced). Numeric symbols that are not
+         * digits (e.g. '²') are replaced, whereas Python keeps them.
+         */
+        std::string makeSafeFilename(const std::string& name);
+
         class Project {
         private:
             std::string name_;
@@ -48,6 +48,14 @@ namespace core {
         }
 
         bool ProjectManager::saveProjectToFile(const std::shared_ptr<Project>& project, const std::string &filename) {
+            if (!writeProjectFile(project, filename)) {
+                return false;
+            }
+            Settings::getInstance().addRecentFile(filename);
+            return true;
+        }
+
+        bool ProjectManager::writeProjectFile(const std::shared_ptr<Project>& project, const std::string &filename) {
             if (project != nullptr) {
                 if (filename.empty()) {
                     return false;
@@ -66,7 +74,6 @@ namespace core {
 
                 project->setSaveFile(filename);
                 project->setSavedState();
-                Settings::getInstance().addRecentFile(filename);
                 return true;
             } 
             else {
@@ -83,6 +90,13 @@ namespace core {
                 }
             }
 
+            std::shared_ptr<Project> new_project = readProjectFile(filename);
+            projects_.insert(new_project);
+            Settings::getInstance().addRecentFile(filename);
+            return new_project;
+        }
+
+        std::shared_ptr<Project> ProjectManager::readProjectFile(const std::string &filename) {
             std::ifstream file(filename, std::ios_base::binary);
             if (!file) {
                 throw ProjectManagerError("Could not open '" + filename + "'");
@@ -120,9 +134,6 @@ namespace core {
             //    throw ProjectManagerError(err);
             //}
 
-
-            projects_.insert(new_project);
-            Settings::getInstance().addRecentFile(filename);
             return new_project;
         }
 
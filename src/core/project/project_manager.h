@@ -88,6 +88,19 @@ namespace core {
              */
             static bool saveProjectToFile(const std::shared_ptr<Project>& project, const std::string &filename);
 
+            /**
+             * Reads a project file, without adding the project to the ProjectManager nor to the recent files
+             * (can be used without the UI, e.g. by the command line)
+             * @throw std::exception if the file could not be read
+             */
+            static std::shared_ptr<Project> readProjectFile(const std::string &filename);
+
+            /**
+             * Writes a project file, without adding it to the recent files
+             * @return true if successful, false if not
+             */
+            static bool writeProjectFile(const std::shared_ptr<Project>& project, const std::string &filename);
+
             /**
              * Iterator function for C++14 usage of for(auto p: ProjectManager)
              * @return iterator on Project*
@@ -0,0 +1,608 @@
+#include "python/executor.h"
+
+#include "batch.h"
+
+#include <mutex>
+#include <thread>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+
+#include "core/dataset/npz.h"
+#include "core/segmentation/mask.h"
+#include "core/segmentation/segmentation.h"
+
+namespace core {
+    namespace segmentation {
+        namespace fs = std::filesystem;
+        using ::core::dataset::NpzReader;
+        using ::core::dataset::NpzWriter;
+        using ::core::dataset::NpyArray;
+
+        namespace {
+            // Names of the layers in the mask collection files
+            const std::pair<MaskLayers::Layer, const char *> LAYER_NAMES[] = {
+                    {MaskLayers::LAYER_CURRENT,   "current"},
+                    {MaskLayers::LAYER_VALIDATED, "validated"},
+                    {MaskLayers::LAYER_PREDICTED, "predicted"}
+            };
+
+            bool is_equal(const cv::Mat &lhs, const cv::Mat &rhs) {
+                if (lhs.size() != rhs.size() || lhs.type() != rhs.type())
+                    return false;
+                return lhs.empty() || cv::countNonZero(lhs != rhs) == 0;
+            }
+
+            std::string read_layers(const NpzReader &reader, int layers_to_read, MaskLayers &layers) {
+                for (auto &layer: LAYER_NAMES) {
+                    if (!reader.contains(layer.second))
+                        continue;
+                    // Masks that do not exist are saved as 0-d arrays, same test as load_mask_collection
+                    NpyArray array;
+                    std::string error = reader.read(layer.second, array, true);
+                    if (!error.empty())
+                        return error;
+                    if (array.shape.empty())
+                        continue;
+                    layers.present |= layer.first;
+
+                    if (layers_to_read & layer.first) {
+                        error = reader.read(layer.second, array);
+                        if (!error.empty())
+                            return error;
+                        if (!array.toMat(layers.get(layer.first)) || layers.get(layer.first).type() != CV_8U)
+                            return std::string("Unsupported mask type for '") + layer.second + "'";
+                    }
+                }
+                if (reader.contains("users")) {
+                    // The users are pickled, only their number is needed
+                    NpyArray users;
+                    std::string error = reader.read("users", users, true);
+                    if (!error.empty())
+                        return error;
+                    layers.num_users = users.shape.size() == 1 ? users.shape[0] : 0;
+                }
+                return "";
+            }
+
+            /**
+             * Builds the new archive of a case, the arrays that have not been modified are copied from the reader
+             */
+            std::string encode_layers(const NpzReader &reader, MaskLayers &layers, std::string &archive) {
+                NpzWriter writer;
+                int written = 0;
+                for (auto &name: reader.getNames()) {
+                    auto layer = std::find_if(std::begin(LAYER_NAMES), std::end(LAYER_NAMES),
+                                              [&name](const std::pair<MaskLayers::Layer, const char *> &layer) {
+                                                  return name == layer.second;
+                                              });
+                    if (layer != std::end(LAYER_NAMES) && (layers.modified & layer->first)) {
+                        if (!layers.get(layer->first).empty())
+                            writer.add(name, layers.get(layer->first));
+                        written |= layer->first;
+                    }
+                    else if (name != "users" || !layers.clear_users) {
+                        // Untouched arrays are not decompressed
+                        writer.copy(reader, name);
+                    }
+                }
+                for (auto &layer: LAYER_NAMES) {
+                    if ((layers.modified & layer.first) && !(written & layer.first) && !layers.get(layer.first).empty())
+                        writer.add(layer.second, layers.get(layer.first));
+                }
+
+                return writer.encode(archive);
+            }
+
+            std::string read_image(BatchCase &batch_case) {
+                NpzReader reader;
+                std::string error = reader.open(batch_case.image_path);
+                NpyArray array;
+                if (error.empty())
+                    error = reader.read("matrix", array);
+                if (!error.empty())
+                    return error;
+                cv::Mat image;
+                if (!array.toMat(image) || image.type() != CV_16S)
+                    return "Unsupported image type in '" + batch_case.image_path + "'";
+                // The crop shares the data of the image, it is not copied
+                batch_case.image = image(cropRegion(image, batch_case.crop_x, batch_case.crop_y));
+
+                // Same spacing as load_scan_from_dicom, the first value is used for both directions
+                NpyArray spacing;
+                if (reader.contains("spacing") && reader.read("spacing", spacing).empty() && spacing.descr == "<f8"
+                    && spacing.data.size() >= sizeof(double)) {
+                    std::memcpy(&batch_case.pixel_spacing, spacing.data.data(), sizeof(double));
+                }
+                return "";
+            }
+
+            // Number of times a case is processed again when its collection is edited during the operation
+            const int MAX_ATTEMPTS = 3;
+
+            bool is_loaded(const BatchCase &batch_case) {
+                return batch_case.collection != nullptr && batch_case.collection->isSet();
+            }
+
+            std::string read_masks(const BatchOperation &operation, const BatchCase &batch_case, NpzReader &reader,
+                                   MaskLayers &layers) {
+                std::string filename = batch_case.mask_basename + ".npz";
+                std::error_code fs_error;
+                if (!fs::exists(filename, fs_error))
+                    return "";
+                std::string error = reader.open(filename);
+                if (error.empty())
+                    error = read_layers(reader, operation.getLayers(), layers);
+                return error;
+            }
+
+            /**
+             * Reads the layers of a case, and its image if the operation needs it
+             * The layers of a case whose collection is loaded are read in the queue of the PyAPI::Executor, so that
+             * they are never read while MaskCollection::saveCollection writes them
+             * @param revision revision of the collection when the layers have been read (see write_case)
+             */
+            std::string read_case(const BatchOperation &operation, BatchCase &batch_case, NpzReader &reader,
+                                  MaskLayers &layers, unsigned int &revision) {
+                std::string error;
+                if (is_loaded(batch_case)) {
+                    try {
+                        error = PyAPI::Executor::getInstance().submit([&] {
+                            revision = batch_case.collection->getRevision();
+                            return read_masks(operation, batch_case, reader, layers);
+                        }).get();
+                    }
+                    catch (const std::exception &e) {
+                        error = e.what();
+                    }
+                }
+                else {
+                    revision = batch_case.collection != nullptr ? batch_case.collection->getRevision() : 0;
+                    error = read_masks(operation, batch_case, reader, layers);
+                }
+                if (!error.empty())
+                    return error;
+                if (operation.needsImage(layers))
+                    error = read_image(batch_case);
+                return error;
+            }
+
+            /**
+             * Writes the layers of a case, in the queue of the PyAPI::Executor if its collection is loaded (as its
+             * saves), and only if the collection has not changed since the layers have been read: the save of the
+             * edit would otherwise be overwritten by a version of the file without it
+             * @param edited set if the case has not been written because its collection has changed
+             */
+            std::string write_case(const BatchCase &batch_case, const NpzReader &reader, MaskLayers &layers,
+                                   unsigned int revision, bool &edited) {
+                std::string filename = batch_case.mask_basename + ".npz";
+                std::string archive;
+                std::string error = encode_layers(reader, layers, archive);
+                edited = false;
+                if (!error.empty())
+                    return error;
+                if (!is_loaded(batch_case)) {
+                    edited = batch_case.collection != nullptr && batch_case.collection->getRevision() != revision;
+                    return edited ? "" : NpzWriter::writeFile(filename, archive);
+                }
+                // The archive is compressed on this thread, only the writing waits in the queue of the Executor
+                try {
+                    return PyAPI::Executor::getInstance().submit([&]() -> std::string {
+                        edited = batch_case.collection->getRevision() != revision;
+                        return edited ? "" : NpzWriter::writeFile(filename, archive);
+                    }).get();
+                }
+                catch (const std::exception &e) {
+                    return e.what();
+                }
+            }
+
+            /**
+             * Processes one case on its own, until it is written without being edited in the meantime
+             */
+            BatchOperation::Result process_case(const BatchOperation &operation, BatchCase &batch_case,
+                                                std::string &error) {
+                for (int attempt = 0; attempt < MAX_ATTEMPTS; attempt++) {
+                    NpzReader reader;
+                    std::vector<MaskLayers> layers(1);
+                    unsigned int revision = 0;
+                    error = read_case(operation, batch_case, reader, layers[0], revision);
+                    if (!error.empty())
+                        return BatchOperation::RESULT_FAILED;
+                    std::vector<BatchOperation::Result> results(1, BatchOperation::RESULT_FAILED);
+                    std::vector<std::string> errors(1);
+                    operation.applyBatch({&batch_case}, layers, results, errors);
+                    error = errors[0];
+                    if (results[0] != BatchOperation::RESULT_MODIFIED)
+                        return results[0];
+
+                    bool edited;
+                    error = write_case(batch_case, reader, layers[0], revision, edited);
+                    if (!error.empty())
+                        return BatchOperation::RESULT_FAILED;
+                    if (!edited)
+                        return results[0];
+                }
+                error = "The masks have been edited during the operation";
+                return BatchOperation::RESULT_FAILED;
+            }
+        }
+
+        void BatchOperation::applyBatch(const std::vector<const BatchCase *> &cases, std::vector<MaskLayers> &layers,
+                                        std::vector<Result> &results, std::vector<std::string> &errors) const {
+            for (size_t i = 0; i < cases.size(); i++) {
+                results[i] = apply(*cases[i], layers[i], errors[i]);
+            }
+        }
+
+        cv::Mat &MaskLayers::get(Layer layer) {
+            switch (layer) {
+                case LAYER_VALIDATED:
+                    return validated;
+                case LAYER_PREDICTED:
+                    return predicted;
+                default:
+                    return current;
+            }
+        }
+
+        BatchOperation::Result UnvalidateOperation::apply(const BatchCase &batch_case, MaskLayers &layers,
+                                                          std::string &error) const {
+            if (layers.num_users == 0 && !(layers.present & MaskLayers::LAYER_VALIDATED))
+                return RESULT_SKIPPED;
+            layers.validated = cv::Mat();
+            layers.modified |= MaskLayers::LAYER_VALIDATED;
+            layers.clear_users = true;
+            return RESULT_MODIFIED;
+        }
+
+        BatchOperation::Result CopyPredictionOperation::apply(const BatchCase &batch_case, MaskLayers &layers,
+                                                              std::string &error) const {
+            if (layers.predicted.empty() || is_equal(layers.current, layers.predicted))
+                return RESULT_SKIPPED;
+            if (!overwrite_ && !layers.current.empty() && cv::countNonZero(layers.current) > 0)
+                return RESULT_SKIPPED;
+            layers.current = layers.predicted.clone();
+            layers.modified |= MaskLayers::LAYER_CURRENT;
+            return RESULT_MODIFIED;
+        }
+
+        std::string PredictOperation::prepare() const {
+            // Reading the network takes a few seconds
+            if (model_->isLoaded())
+                return "";
+            std::string error = model_->load(model_filename_);
+            if (!error.empty())
+                return "Could not load the model of the segmentation: " + error;
+            return "";
+        }
+
+        BatchOperation::Result PredictOperation::apply(const BatchCase &batch_case, MaskLayers &layers,
+                                                       std::string &error) const {
+            std::vector<MaskLayers> batch_layers(1);
+            std::swap(batch_layers[0], layers);
+            std::vector<Result> results(1);
+            std::vector<std::string> errors(1);
+            applyBatch({&batch_case}, batch_layers, results, errors);
+            std::swap(batch_layers[0], layers);
+            error = errors[0];
+            return results[0];
+        }
+
+        void PredictOperation::applyBatch(const std::vector<const BatchCase *> &cases, std::vector<MaskLayers> &layers,
+                                          std::vector<Result> &results, std::vector<std::string> &errors) const {
+            std::vector<size_t> to_predict;
+            std::vector<cv::Mat> images;
+            for (size_t i = 0; i < cases.size(); i++) {
+                if (!needsImage(layers[i])) {
+                    results[i] = RESULT_SKIPPED;
+                    continue;
+                }
+                to_predict.push_back(i);
+                images.push_back(cases[i]->image);
+            }
+            if (images.empty())
+                return;
+
+            std::vector<cv::Mat> predictions;
+            std::string error = model_->predict(images, predictions);
+            for (size_t j = 0; j < to_predict.size(); j++) {
+                size_t i = to_predict[j];
+                if (!error.empty()) {
+                    results[i] = RESULT_FAILED;
+                    errors[i] = error;
+                }
+                else if (predictions[j].size() != images[j].size() || predictions[j].type() != CV_8U) {
+                    results[i] = RESULT_FAILED;
+                    errors[i] = "The prediction of '" + cases[i]->id + "' does not have the size of its image";
+                }
+                else {
+                    layers[i].predicted = predictions[j];
+                    layers[i].modified |= MaskLayers::LAYER_PREDICTED;
+                    results[i] = RESULT_MODIFIED;
+                }
+            }
+        }
+
+        BatchOperation::Result ThresholdCleanOperation::apply(const BatchCase &batch_case, MaskLayers &layers,
+                                                              std::string &error) const {
+            if (layers.current.empty())
+                return RESULT_SKIPPED;
+            if (batch_case.image.size() != layers.current.size()) {
+                error = "The mask of '" + batch_case.id + "' does not have the size of its image";
+                return RESULT_FAILED;
+            }
+
+            cv::Mat in_range;
+            cv::inRange(batch_case.image, cv::Scalar(min_hu_), cv::Scalar(max_hu_), in_range);
+            cv::Mat cleaned = cv::Mat::zeros(layers.current.size(), CV_8U);
+            layers.current.copyTo(cleaned, in_range);
+
+            Mask mask;
+            mask.setData(cleaned);
+            if (min_object_size_ > 0)
+                mask.remove_small_objects(min_object_size_);
+
+            if (is_equal(mask.getData(), layers.current))
+                return RESULT_SKIPPED;
+            layers.current = mask.getData();
+            layers.modified |= MaskLayers::LAYER_CURRENT;
+            return RESULT_MODIFIED;
+        }
+
+        BatchOperation::Result ExportOperation::apply(const BatchCase &batch_case, MaskLayers &layers,
+                                                      std::string &error) const {
+            // Same order as MaskCollection::getMostAdvancedMask
+            const cv::Mat *mask = nullptr;
+            if (layers.num_users > 0 && !layers.validated.empty())
+                mask = &layers.validated;
+            else if (!layers.current.empty())
+                mask = &layers.current;
+            else if (!layers.predicted.empty())
+                mask = &layers.predicted;
+            if (mask == nullptr)
+                return RESULT_SKIPPED;
+
+            std::error_code fs_error;
+            fs::path path = fs::path(directory_) / (batch_case.id + ".png");
+            auto png_time = fs::last_write_time(path, fs_error);
+            if (!fs_error && png_time >= fs::last_write_time(batch_case.mask_basename + ".npz", fs_error) && !fs_error)
+                return RESULT_SKIPPED;
+
+            fs::create_directories(directory_, fs_error);
+            cv::Mat png;
+            mask->convertTo(png, CV_8U, 255);
+            try {
+                if (!cv::imwrite(path.string(), png)) {
+                    error = "Could not write '" + path.string() + "'";
+                    return RESULT_FAILED;
+                }
+            }
+            catch (const cv::Exception &e) {
+                error = e.what();
+                return RESULT_FAILED;
+            }
+            return RESULT_DONE;
+        }
+
+        BatchOperation::Result HuThresholdOperation::apply(const BatchCase &batch_case, MaskLayers &layers,
+                                                           std::string &error) const {
+            if (!needsImage(layers))
+                return RESULT_SKIPPED;
+
+            Mask mask = huThresholdMask(batch_case.image, min_hu_, max_hu_, min_object_size_ > 0, closing_size_,
+                                        opening_size_, min_object_size_);
+
+            if (is_equal(mask.getData(), layers.current))
+                return RESULT_SKIPPED;
+            layers.current = mask.getData();
+            layers.modified |= MaskLayers::LAYER_CURRENT;
+            return RESULT_MODIFIED;
+        }
+
+        BatchOperation::Result StatisticsOperation::apply(const BatchCase &batch_case, MaskLayers &layers,
+                                                          std::string &error) const {
+            // Same order as ExportOperation
+            MaskStatistics statistics;
+            const cv::Mat *mask = nullptr;
+            if (layers.num_users > 0 && !layers.validated.empty()) {
+                mask = &layers.validated;
+                statistics.layer = "validated";
+            }
+            else if (!layers.current.empty()) {
+                mask = &layers.current;
+                statistics.layer = "current";
+            }
+            else if (!layers.predicted.empty()) {
+                mask = &layers.predicted;
+                statistics.layer = "predicted";
+            }
+            if (mask == nullptr)
+                return RESULT_SKIPPED;
+            if (batch_case.image.size() != mask->size()) {
+                error = "The mask of '" + batch_case.id + "' does not have the size of its image";
+                return RESULT_FAILED;
+            }
+
+            statistics.id = batch_case.id;
+            statistics.num_pixels = cv::countNonZero(*mask);
+            statistics.area_mm2 = statistics.num_pixels * batch_case.pixel_spacing * batch_case.pixel_spacing;
+            if (statistics.num_pixels > 0) {
+                cv::Scalar mean, std_dev;
+                cv::meanStdDev(batch_case.image, mean, std_dev, *mask);
+                statistics.mean_hu = mean[0];
+                statistics.std_hu = std_dev[0];
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            statistics_.push_back(statistics);
+            return RESULT_DONE;
+        }
+
+        std::vector<MaskStatistics> StatisticsOperation::getStatistics() const {
+            std::vector<MaskStatistics> statistics;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                statistics = statistics_;
+            }
+            std::sort(statistics.begin(), statistics.end(), [](const MaskStatistics &lhs, const MaskStatistics &rhs) {
+                return lhs.id < rhs.id;
+            });
+            return statistics;
+        }
+
+        std::string StatisticsOperation::writeCSV(const std::string &filename) const {
+            std::ofstream file(filename, std::ios::trunc);
+            if (!file)
+                return "Could not open '" + filename + "'";
+            file << "id,layer,num_pixels,area_mm2,mean_hu,std_hu\n";
+            for (auto &statistics: getStatistics()) {
+                file << statistics.id << "," << statistics.layer << "," << statistics.num_pixels << ","
+                     << statistics.area_mm2 << "," << statistics.mean_hu << "," << statistics.std_hu << "\n";
+            }
+            if (!file)
+                return "Could not write '" + filename + "'";
+            return "";
+        }
+
+        std::shared_ptr<Job> runBatchOperation(const std::shared_ptr<Segmentation> &segmentation,
+                                               const std::vector<std::shared_ptr<DicomSeries>> &dicoms,
+                                               const std::string &root_path,
+                                               std::shared_ptr<const BatchOperation> operation,
+                                               std::shared_ptr<BatchProgress> progress,
+                                               jobResultFct result_fct) {
+            // The series belong to the main thread, everything the workers need is copied here
+            auto cases = std::make_shared<std::vector<BatchCase>>();
+            for (auto &dicom: dicoms) {
+                BatchCase batch_case;
+                batch_case.dicom = dicom;
+                batch_case.id = dicom->getId();
+                batch_case.mask_basename = segmentation->getMaskBasename(dicom);
+                // The first image of a series, as saved by the import
+                batch_case.image_path = (fs::path(root_path) / "data" / "dicoms" / batch_case.id / "0.npz").string();
+                batch_case.crop_x = dicom->getCropX();
+                batch_case.crop_y = dicom->getCropY();
+                auto collection = segmentation->getMasks().find(dicom);
+                if (collection != segmentation->getMasks().end())
+                    batch_case.collection = collection->second;
+                cases->push_back(batch_case);
+            }
+            if (progress == nullptr)
+                progress = std::make_shared<BatchProgress>();
+            progress->num_cases = (int) cases->size();
+
+            jobFct job = [=](float &job_progress, bool &abort) -> std::shared_ptr<JobResult> {
+                auto result = std::make_shared<BatchResult>();
+                result->error_msg = operation->prepare();
+                if (!result->error_msg.empty()) {
+                    progress->num_failed = (int) cases->size();
+                    progress->num_done = (int) cases->size();
+                    return result;
+                }
+                std::vector<char> modified(cases->size(), 0);
+                std::atomic<size_t> next_case{0};
+                std::mutex error_mutex;
+
+                // The cases are spread on the workers by batches, this job being one of them
+                auto &scheduler = JobScheduler::getInstance();
+                auto caller = std::this_thread::get_id();
+                size_t batch_size = (size_t) std::max(operation->getBatchSize(), 1);
+                int num_helpers = std::max(scheduler.getNumberOfWorkers() - 1, 0);
+                if (operation->getNumThreads() > 0)
+                    num_helpers = std::min(num_helpers, operation->getNumThreads() - 1);
+
+                scheduler.parallelRun("batch_mask_helper", num_helpers, [&](bool &abort) {
+                    bool is_caller = std::this_thread::get_id() == caller;
+                    while (!abort) {
+                        size_t first = next_case.fetch_add(batch_size);
+                        if (first >= cases->size())
+                            return;
+                        size_t last = std::min(first + batch_size, cases->size());
+
+                        std::vector<NpzReader> readers(last - first);
+                        std::vector<MaskLayers> layers(last - first);
+                        std::vector<BatchOperation::Result> results(last - first, BatchOperation::RESULT_FAILED);
+                        std::vector<std::string> errors(last - first);
+                        std::vector<unsigned int> revisions(last - first, 0);
+
+                        // Only the cases that could be read are given to the operation
+                        std::vector<size_t> read;
+                        std::vector<const BatchCase *> batch;
+                        std::vector<MaskLayers> batch_layers;
+                        for (size_t i = first; i < last; i++) {
+                            errors[i - first] = read_case(*operation, (*cases)[i], readers[i - first], layers[i - first],
+                                                          revisions[i - first]);
+                            if (errors[i - first].empty()) {
+                                read.push_back(i - first);
+                                batch.push_back(&(*cases)[i]);
+                                batch_layers.push_back(std::move(layers[i - first]));
+                            }
+                        }
+                        if (!batch.empty()) {
+                            std::vector<BatchOperation::Result> batch_results(batch.size(), BatchOperation::RESULT_FAILED);
+                            std::vector<std::string> batch_errors(batch.size());
+                            operation->applyBatch(batch, batch_layers, batch_results, batch_errors);
+                            for (size_t j = 0; j < read.size(); j++) {
+                                layers[read[j]] = std::move(batch_layers[j]);
+                                results[read[j]] = batch_results[j];
+                                errors[read[j]] = batch_errors[j];
+                            }
+                        }
+
+                        for (size_t i = first; i < last; i++) {
+                            auto &result_case = results[i - first];
+                            auto &error = errors[i - first];
+                            if (result_case == BatchOperation::RESULT_MODIFIED) {
+                                bool edited;
+                                error = write_case((*cases)[i], readers[i - first], layers[i - first],
+                                                   revisions[i - first], edited);
+                                if (!error.empty())
+                                    result_case = BatchOperation::RESULT_FAILED;
+                                else if (edited)
+                                    result_case = process_case(*operation, (*cases)[i], error);
+                            }
+
+                            switch (result_case) {
+                                case BatchOperation::RESULT_MODIFIED:
+                                    modified[i] = 1;
+                                    progress->num_modified++;
+                                    EventQueue::getInstance().post(
+                                            Event_ptr(new MaskWrittenEvent(segmentation, (*cases)[i].dicom)));
+                                    break;
+                                case BatchOperation::RESULT_SKIPPED:
+                                    progress->num_skipped++;
+                                    break;
+                                case BatchOperation::RESULT_FAILED: {
+                                    progress->num_failed++;
+                                    std::lock_guard<std::mutex> lock(error_mutex);
+                                    // Only the first error is reported
+                                    if (result->error_msg.empty())
+                                        result->error_msg = (*cases)[i].id + ": " + error;
+                                    break;
+                                }
+                                default:
+                                    break;
+                            }
+                            (*cases)[i].image.release();
+                            progress->num_done++;
+                        }
+                        if (is_caller)
+                            job_progress = float(progress->num_done) / float(cases->size());
+                    }
+                }, abort);
+
+                for (size_t i = 0; i < cases->size(); i++) {
+                    if (modified[i])
+                        result->modified.push_back((*cases)[i].dicom);
+                }
+                result->success = !abort && progress->num_failed == 0;
+                // The first error of a case stays the reported error
+                if (abort && result->error_msg.empty())
+                    result->error_msg = "Job canceled";
+                return result;
+            };
+            return JobScheduler::getInstance().addJob("batch_mask_operation", job, result_fct);
+        }
+    }
+}
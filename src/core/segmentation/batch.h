@@ -0,0 +1,352 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+
+#include "opencv2/opencv.hpp"
+
+#include "core/dicom.h"
+#include "core/segmentation/ml.h"
+#include "events.h"
+#include "jobscheduler.h"
+
+namespace core {
+    namespace segmentation {
+        class Segmentation;
+        class MaskCollection;
+
+        /**
+         * Layers of a mask collection file (<basename>.npz, see save_mask_collection in segmentation.py)
+         *
+         * Only the layers asked by the operation are read, the others are copied as they are (still compressed)
+         * when the file is written again.
+         */
+        struct MaskLayers {
+            enum Layer { LAYER_CURRENT = 1, LAYER_VALIDATED = 2, LAYER_PREDICTED = 4 };
+
+            // Layers present in the file, whether they have been read or not
+            int present = 0;
+            // Number of users that validated the mask
+            size_t num_users = 0;
+
+            cv::Mat current;
+            cv::Mat validated;
+            cv::Mat predicted;
+
+            // Set by the operation: layers to write again (removed if their matrix is empty)
+            int modified = 0;
+            bool clear_users = false;
+
+            cv::Mat& get(Layer layer);
+        };
+
+        /**
+         * Case of a batch operation, prepared on the calling thread so that the workers never touch the series
+         */
+        struct BatchCase {
+            std::shared_ptr<DicomSeries> dicom;
+            std::string id;
+            std::string mask_basename;
+            std::string image_path;
+            ImVec2 crop_x;
+            ImVec2 crop_y;
+            // First image of the series (cropped), only loaded if the operation needs it
+            cv::Mat image;
+            // Spacing of the pixels of the image in mm, read with the image
+            double pixel_spacing = 1.;
+            // Collection of the case in the segmentation, nullptr if there is none
+            std::shared_ptr<MaskCollection> collection;
+        };
+
+        /**
+         * Transformation applied to the masks of many cases by runBatchOperation
+         *
+         * apply() is called from several threads at once, on different cases
+         */
+        class BatchOperation {
+        public:
+            enum Result { RESULT_SKIPPED, RESULT_MODIFIED, RESULT_DONE, RESULT_FAILED };
+
+            virtual ~BatchOperation() = default;
+
+            virtual std::string getName() const = 0;
+
+            /**
+             * Layers (MaskLayers::Layer) that must be read
+             */
+            virtual int getLayers() const = 0;
+
+            /**
+             * @param layers layers read from the file of the case
+             * @return true if the first image of the case must be loaded before apply()
+             */
+            virtual bool needsImage(const MaskLayers& layers) const { return false; }
+
+            /**
+             * Maximum number of cases given at once to applyBatch()
+             */
+            virtual int getBatchSize() const { return 1; }
+
+            /**
+             * Maximum number of threads that run the operation, 0 to use all the workers of the JobScheduler
+             */
+            virtual int getNumThreads() const { return 0; }
+
+            /**
+             * Called once by the job before the cases are processed, for what is too long for the main thread
+             * @return error message, none of the cases are processed if it is not empty
+             */
+            virtual std::string prepare() const { return ""; }
+
+            /**
+             * @return RESULT_MODIFIED if the file must be written, RESULT_SKIPPED if the case was already in the
+             * target state, RESULT_DONE if there is nothing to write (e.g. an export), RESULT_FAILED with an error
+             */
+            virtual Result apply(const BatchCase& batch_case, MaskLayers& layers, std::string& error) const = 0;
+
+            /**
+             * Applies the operation on several cases at once, by default by calling apply() on each case
+             * @param results result of each case, see apply()
+             * @param errors error of each case that failed
+             */
+            virtual void applyBatch(const std::vector<const BatchCase*>& cases, std::vector<MaskLayers>& layers,
+                                    std::vector<Result>& results, std::vector<std::string>& errors) const;
+        };
+
+        /**
+         * Removes the validation (validated mask and users) of the cases
+         */
+        class UnvalidateOperation : public BatchOperation {
+        public:
+            std::string getName() const override { return "Unvalidate"; }
+            int getLayers() const override { return 0; }
+            Result apply(const BatchCase& batch_case, MaskLayers& layers, std::string& error) const override;
+        };
+
+        /**
+         * Copies the ML prediction into the current mask
+         */
+        class CopyPredictionOperation : public BatchOperation {
+        private:
+            bool overwrite_;
+        public:
+            /**
+             * @param model_filename loaded by the job if the model is not loaded yet
+             * @param overwrite if not set, cases whose current mask is not empty are skipped
+             */
+            explicit CopyPredictionOperation(bool overwrite = false) : overwrite_(overwrite) {}
+
+            std::string getName() const override { return "Copy prediction"; }
+            int getLayers() const override { return MaskLayers::LAYER_CURRENT | MaskLayers::LAYER_PREDICTED; }
+            Result apply(const BatchCase& batch_case, MaskLayers& layers, std::string& error) const override;
+        };
+
+        /**
+         * Removes from the current mask the pixels whose HU value is outside of a range, then the objects that
+         * are smaller than a given size
+         */
+        class ThresholdCleanOperation : public BatchOperation {
+        private:
+            int min_hu_;
+            int max_hu_;
+            int min_object_size_;
+        public:
+            ThresholdCleanOperation(int min_hu, int max_hu, int min_object_size)
+                    : min_hu_(min_hu), max_hu_(max_hu), min_object_size_(min_object_size) {}
+
+            std::string getName() const override { return "Threshold clean"; }
+            int getLayers() const override { return MaskLayers::LAYER_CURRENT; }
+            bool needsImage(const MaskLayers& layers) const override { return !layers.current.empty(); }
+            Result apply(const BatchCase& batch_case, MaskLayers& layers, std::string& error) const override;
+        };
+
+        /**
+         * Exports the most advanced mask (validated, current, then prediction) of each case as <id>.png
+         * Cases whose png is more recent than their masks are skipped
+         */
+        class ExportOperation : public BatchOperation {
+        private:
+            std::string directory_;
+        public:
+            explicit ExportOperation(const std::string& directory) : directory_(directory) {}
+
+            std::string getName() const override { return "Export"; }
+            int getLayers() const override {
+                return MaskLayers::LAYER_CURRENT | MaskLayers::LAYER_VALIDATED | MaskLayers::LAYER_PREDICTED;
+            }
+            Result apply(const BatchCase& batch_case, MaskLayers& layers, std::string& error) const override;
+        };
+
+        /**
+         * Replaces the current mask by the pixels whose HU value is in a range (see huThresholdMask), followed by
+         * a closing, an opening and the removal of the small objects and holes
+         */
+        class HuThresholdOperation : public BatchOperation {
+        private:
+            int min_hu_;
+            int max_hu_;
+            int closing_size_;
+            int opening_size_;
+            int min_object_size_;
+            bool overwrite_;
+        public:
+            /**
+             * @param min_object_size objects and holes smaller than this are removed, 0 to keep them
+             * @param overwrite if not set, cases whose current mask is not empty are skipped
+             */
+            HuThresholdOperation(int min_hu, int max_hu, int closing_size = 0, int opening_size = 0,
+                                 int min_object_size = 0, bool overwrite = false)
+                    : min_hu_(min_hu), max_hu_(max_hu), closing_size_(closing_size), opening_size_(opening_size),
+                      min_object_size_(min_object_size), overwrite_(overwrite) {}
+
+            std::string getName() const override { return "HU threshold"; }
+            int getLayers() const override { return MaskLayers::LAYER_CURRENT; }
+            bool needsImage(const MaskLayers& layers) const override {
+                return overwrite_ || layers.current.empty() || cv::countNonZero(layers.current) == 0;
+            }
+            Result apply(const BatchCase& batch_case, MaskLayers& layers, std::string& error) const override;
+        };
+
+        /**
+         * Statistics of the most advanced mask of a case, on the first image of its series
+         */
+        struct MaskStatistics {
+            std::string id;
+            // "validated", "current" or "predicted"
+            std::string layer;
+            int num_pixels = 0;
+            double area_mm2 = 0.;
+            double mean_hu = 0.;
+            double std_hu = 0.;
+        };
+
+        /**
+         * Computes the statistics (area, HU values) of the most advanced mask of each case
+         *
+         * The statistics are kept by the operation, they can be read or written as CSV once the job is finished.
+         */
+        class StatisticsOperation : public BatchOperation {
+        private:
+            mutable std::mutex mutex_;
+            mutable std::vector<MaskStatistics> statistics_;
+        public:
+            std::string getName() const override { return "Statistics"; }
+            int getLayers() const override {
+                return MaskLayers::LAYER_CURRENT | MaskLayers::LAYER_VALIDATED | MaskLayers::LAYER_PREDICTED;
+            }
+            bool needsImage(const MaskLayers& layers) const override { return layers.present != 0; }
+            Result apply(const BatchCase& batch_case, MaskLayers& layers, std::string& error) const override;
+
+            /**
+             * @return statistics of the cases that have a mask, ordered by id
+             */
+            std::vector<MaskStatistics> getStatistics() const;
+
+            /**
+             * Writes the statistics as CSV, one line per case
+             * @return error message if the file could not be written
+             */
+            std::string writeCSV(const std::string& filename) const;
+        };
+
+        /**
+         * Predicts the masks of the cases with a model and saves them as their prediction
+         *
+         * The images are given to the model by mini-batches, one forward pass per batch.
+         */
+        class PredictOperation : public BatchOperation {
+        private:
+            std::shared_ptr<ML_Model> model_;
+            std::string model_filename_;
+            bool overwrite_;
+            int batch_size_;
+            int num_threads_;
+        public:
+            /**
+             * @param overwrite if not set, cases that already have a prediction are skipped, so that an
+             * interrupted prediction can be continued
+             * @param batch_size number of images per forward pass
+             * @param num_threads number of threads that predict at once, 0 to use all the workers
+             */
+            PredictOperation(std::shared_ptr<ML_Model> model, std::string model_filename, bool overwrite = false,
+                             int batch_size = 8, int num_threads = 0)
+                    : model_(std::move(model)), model_filename_(std::move(model_filename)), overwrite_(overwrite),
+                      batch_size_(batch_size), num_threads_(num_threads) {}
+
+            std::string getName() const override { return "Predict"; }
+            int getLayers() const override { return 0; }
+            bool needsImage(const MaskLayers& layers) const override {
+                return overwrite_ || !(layers.present & MaskLayers::LAYER_PREDICTED);
+            }
+            int getBatchSize() const override { return batch_size_; }
+            int getNumThreads() const override { return num_threads_; }
+            std::string prepare() const override;
+            Result apply(const BatchCase& batch_case, MaskLayers& layers, std::string& error) const override;
+            void applyBatch(const std::vector<const BatchCase*>& cases, std::vector<MaskLayers>& layers,
+                            std::vector<Result>& results, std::vector<std::string>& errors) const override;
+        };
+
+        /**
+         * Progress of a batch operation, can be read from the UI while the job runs
+         */
+        struct BatchProgress {
+            int num_cases = 0;
+            std::atomic<int> num_done{0};
+            std::atomic<int> num_modified{0};
+            std::atomic<int> num_skipped{0};
+            std::atomic<int> num_failed{0};
+        };
+
+        struct BatchResult : public JobResult {
+            // Cases whose mask file has been written
+            std::vector<std::shared_ptr<DicomSeries>> modified;
+            std::string error_msg;
+        };
+
+        /**
+         * Posted (from the workers) each time the mask file of a case has been written by a batch operation
+         *
+         * The collection of the case may be loaded in memory, in which case it is out of date.
+         */
+        class MaskWrittenEvent : public Event {
+        private:
+            std::shared_ptr<Segmentation> segmentation_;
+            std::shared_ptr<DicomSeries> dicom_;
+        public:
+            MaskWrittenEvent(std::shared_ptr<Segmentation> segmentation, std::shared_ptr<DicomSeries> dicom)
+                    : Event("mask/written/" + dicom->getId()), segmentation_(std::move(segmentation)),
+                      dicom_(std::move(dicom)) {}
+
+            std::shared_ptr<Segmentation> getSegmentation() { return segmentation_; }
+            std::shared_ptr<DicomSeries> getDicom() { return dicom_; }
+        };
+
+        /**
+         * Runs an operation on the masks of a segmentation, as one job of the JobScheduler whose cases are
+         * spread on the idle workers
+         *
+         * The mask files are read and written natively, without the masks that are loaded in memory. A
+         * MaskWrittenEvent is posted for each case that has been modified, so that the loaded collections can be
+         * reloaded while the job runs.
+         * The files of the cases whose collection is loaded (e.g. open in the editor) are read and written in the
+         * queue of the PyAPI::Executor, as the saves of MaskCollection, while the operation itself runs on the
+         * workers. A case is only written if its collection has not changed since it has been read (see
+         * MaskCollection::getRevision), otherwise it is processed again, so that an edit saved during the job is
+         * never overwritten by an older version of the file.
+         * Stopping the job (JobScheduler::stopJob) cancels the cases that have not started yet.
+         *
+         * @param root_path root of the project, where the images of the series are
+         * @param progress updated by the job, can be nullptr
+         * @return the job
+         */
+        std::shared_ptr<Job> runBatchOperation(const std::shared_ptr<Segmentation>& segmentation,
+                                               const std::vector<std::shared_ptr<DicomSeries>>& dicoms,
+                                               const std::string& root_path,
+                                               std::shared_ptr<const BatchOperation> operation,
+                                               std::shared_ptr<BatchProgress> progress,
+                                               jobResultFct result_fct);
+    }
+}
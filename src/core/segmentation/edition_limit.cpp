@@ -0,0 +1,214 @@
+#include "edition_limit.h"
+
+namespace core {
+    namespace segmentation {
+
+        bool EditionLimitParams::operator==(const EditionLimitParams &other) const {
+            return use_hu_range == other.use_hu_range
+                   && hu_min == other.hu_min
+                   && hu_max == other.hu_max
+                   && ignore_small_objects == other.ignore_small_objects
+                   && opening_size == other.opening_size
+                   && use_vertebra_distance == other.use_vertebra_distance
+                   && vertebra_min_hu == other.vertebra_min_hu
+                   && vertebra_min_distance == other.vertebra_min_distance
+                   && use_visceral_fat_help == other.use_visceral_fat_help
+                   && muscle_masks == other.muscle_masks
+                   && muscle_revision == other.muscle_revision
+                   && use_other_mask == other.use_other_mask
+                   && other_masks == other.other_masks
+                   && other_revision == other.other_revision;
+        }
+
+        EditionLimitPipeline::EditionLimitPipeline() : state_(std::make_shared<State>()) {
+        }
+
+        EditionLimitPipeline::~EditionLimitPipeline() {
+            // The running job (if any) keeps the state alive, it just won't publish anything
+            state_->alive = false;
+            state_->outdated = true;
+            state_->publish_fct = [](const std::shared_ptr<EditionLimitResult> &) {};
+        }
+
+        void EditionLimitPipeline::setPublishFunction(const publishFct &fct) {
+            state_->publish_fct = fct;
+        }
+
+        void EditionLimitPipeline::setImage(const cv::Mat &image) {
+            state_->image = image;
+            state_->generation++;
+            state_->request++;
+            if (state_->job_running) {
+                state_->outdated = true;
+            }
+        }
+
+        void EditionLimitPipeline::request(const EditionLimitParams &params) {
+            if (state_->image.empty())
+                return;
+
+            bool same_request = params == state_->params && state_->requested_generation == state_->generation;
+            if (same_request)
+                return;
+
+            state_->params = params;
+            state_->requested_generation = state_->generation;
+            state_->request++;
+            if (state_->job_running) {
+                state_->dirty = true;
+            } else {
+                launch(state_);
+            }
+        }
+
+        bool EditionLimitPipeline::isReady() const {
+            return state_->published_request == state_->request;
+        }
+
+        void EditionLimitPipeline::reset() {
+            setImage(cv::Mat());
+            state_->params = EditionLimitParams();
+            state_->dirty = false;
+        }
+
+        void EditionLimitPipeline::launch(const std::shared_ptr<State> &state) {
+            state->job_running = true;
+            state->dirty = false;
+            state->outdated = false;
+
+            cv::Mat image = state->image;
+            int generation = state->generation;
+            int request = state->request;
+            EditionLimitParams params = state->params;
+
+            jobFct job = [state, image, generation, request, params](float &progress, bool &abort) -> std::shared_ptr<JobResult> {
+                auto result = std::make_shared<EditionLimitResult>();
+                result->generation = generation;
+                result->request = request;
+                result->success = compute(state->cache, image, generation, params, *result, state->outdated, abort);
+                return result;
+            };
+
+            jobResultFct when_finished = [state](const std::shared_ptr<JobResult> &result) {
+                state->job_running = false;
+                if (!state->alive)
+                    return;
+
+                auto limit_result = std::dynamic_pointer_cast<EditionLimitResult>(result);
+                if (limit_result != nullptr && limit_result->success && limit_result->generation == state->generation) {
+                    state->published_request = limit_result->request;
+                    state->publish_fct(limit_result);
+                }
+
+                if (state->dirty && !state->image.empty()) {
+                    launch(state);
+                }
+            };
+
+            JobScheduler::getInstance().addJob("edition_limit", job, when_finished, Job::JOB_PRIORITY_HIGH);
+        }
+
+        bool EditionLimitPipeline::compute(Cache &cache, const cv::Mat &image, int generation,
+                                           const EditionLimitParams &params, EditionLimitResult &result,
+                                           const std::atomic<bool> &outdated, const bool &abort) {
+            if (cache.generation != generation) {
+                cache.generation = generation;
+                cache.hu_valid = false;
+                cache.vertebra_valid = false;
+                cache.visceral_valid = false;
+                cache.other_valid = false;
+            }
+            auto &cached = cache.params;
+
+            Mask edition_limit(image.rows, image.cols, true);
+            result.use_edition_limit = false;
+
+            if (params.use_hu_range) {
+                if (!cache.hu_valid || cached.hu_min != params.hu_min || cached.hu_max != params.hu_max
+                    || cached.ignore_small_objects != params.ignore_small_objects
+                    || cached.opening_size != params.opening_size) {
+                    cache.hu_threshold = cache.hu_cache.update(image, params.hu_min, params.hu_max,
+                                                               params.ignore_small_objects,
+                                                               params.opening_size, params.opening_size, generation);
+                    cached.hu_min = params.hu_min;
+                    cached.hu_max = params.hu_max;
+                    cached.ignore_small_objects = params.ignore_small_objects;
+                    cached.opening_size = params.opening_size;
+                    cache.hu_valid = true;
+                }
+                edition_limit.intersect_with(cache.hu_threshold);
+                result.use_edition_limit = true;
+            }
+            if (outdated || abort)
+                return false;
+
+            if (params.use_vertebra_distance) {
+                if (!cache.vertebra_valid || cached.vertebra_min_hu != params.vertebra_min_hu
+                    || cached.vertebra_min_distance != params.vertebra_min_distance) {
+                    cache.vertebra_distance = vertebraDistanceMask(image, params.vertebra_min_hu,
+                                                                   params.vertebra_min_distance);
+                    cached.vertebra_min_hu = params.vertebra_min_hu;
+                    cached.vertebra_min_distance = params.vertebra_min_distance;
+                    cache.vertebra_valid = true;
+                }
+                edition_limit.intersect_with(cache.vertebra_distance);
+                result.use_edition_limit = true;
+            }
+            if (outdated || abort)
+                return false;
+
+            if (params.use_visceral_fat_help) {
+                if (!cache.visceral_valid || cached.muscle_masks != params.muscle_masks
+                    || (params.muscle_masks != nullptr && cache.muscle_revision != params.muscle_masks->getRevision())) {
+                    cache.debug_rows.clear();
+                    cache.debug_cols.clear();
+                    if (params.muscle_masks != nullptr) {
+                        params.muscle_masks->loadData(true);
+                        params.muscle_masks->lock();
+                        Mask muscle_mask = params.muscle_masks->getMostAdvancedMask().copy();
+                        cache.muscle_revision = params.muscle_masks->getRevision();
+                        params.muscle_masks->unlock();
+                        cache.visceral_fat = visceralFatMask(muscle_mask, cache.debug_rows, cache.debug_cols);
+                    } else {
+                        cache.visceral_fat = Mask();
+                    }
+                    cached.muscle_masks = params.muscle_masks;
+                    cache.visceral_valid = true;
+                }
+                edition_limit.intersect_with(cache.visceral_fat);
+                result.debug_rows = cache.debug_rows;
+                result.debug_cols = cache.debug_cols;
+                result.use_edition_limit = true;
+            }
+            if (outdated || abort)
+                return false;
+
+            if (params.use_other_mask) {
+                if (!cache.other_valid || cached.other_masks != params.other_masks
+                    || (params.other_masks != nullptr && cache.other_revision != params.other_masks->getRevision())) {
+                    cache.other_segmentation = Mask();
+                    if (params.other_masks != nullptr) {
+                        params.other_masks->loadData(true);
+                        params.other_masks->lock();
+                        Mask other_mask = params.other_masks->getMostAdvancedMask();
+                        cache.other_revision = params.other_masks->getRevision();
+                        if (!other_mask.empty()) {
+                            cache.other_segmentation = other_mask.copy();
+                            cache.other_segmentation.invert();
+                        }
+                        params.other_masks->unlock();
+                    }
+                    cached.other_masks = params.other_masks;
+                    cache.other_valid = true;
+                }
+                edition_limit.intersect_with(cache.other_segmentation);
+                result.use_edition_limit = true;
+            }
+            if (outdated || abort)
+                return false;
+
+            result.edition_limit = edition_limit;
+            return true;
+        }
+    }
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <memory>
+#include <set>
+#include <atomic>
+#include <functional>
+
+#include "opencv2/opencv.hpp"
+
+#include "jobscheduler.h"
+#include "mask.h"
+#include "hu_threshold.h"
+
+namespace core {
+    namespace segmentation {
+
+        /**
+         * All the parameters that define the edition limit of a slice
+         */
+        struct EditionLimitParams {
+            bool use_hu_range = false;
+            int hu_min = 0;
+            int hu_max = 0;
+            bool ignore_small_objects = false;
+            int opening_size = 0;
+
+            bool use_vertebra_distance = false;
+            int vertebra_min_hu = 0;
+            int vertebra_min_distance = 0;
+
+            bool use_visceral_fat_help = false;
+            std::shared_ptr<MaskCollection> muscle_masks = nullptr;
+            unsigned int muscle_revision = 0; // MaskCollection::getRevision when requested
+
+            bool use_other_mask = false;
+            std::shared_ptr<MaskCollection> other_masks = nullptr;
+            unsigned int other_revision = 0;
+
+            bool operator==(const EditionLimitParams &other) const;
+            bool operator!=(const EditionLimitParams &other) const { return !(*this == other); }
+        };
+
+        /**
+         * Result of the edition limit job, published as a whole to the editor
+         */
+        struct EditionLimitResult : public JobResult {
+            Mask edition_limit;
+            bool use_edition_limit = false;
+            std::set<int> debug_rows;
+            std::set<int> debug_cols;
+            int generation = 0;
+            int request = 0;
+        };
+
+        /**
+         * Computes the edition limit mask of a slice in the background
+         *
+         * Only one job is in flight at a time. Each partial mask (HU threshold, vertebra distance, visceral fat
+         * help, other segmentation) is cached with the parameters that built it, so that a new request only
+         * recomputes the parts whose parameters changed. Requests arriving while a job is running are merged,
+         * and the last one is run once the job is finished.
+         *
+         * Results are published on the main thread (through JobScheduler::finalizeJobs), and only if they
+         * belong to the current image.
+         */
+        class EditionLimitPipeline {
+        public:
+            using publishFct = std::function<void(const std::shared_ptr<EditionLimitResult> &)>;
+        private:
+            /**
+             * Partial masks, only touched by the running job
+             */
+            struct Cache {
+                int generation = -1;
+                EditionLimitParams params;
+
+                HuThresholdCache hu_cache;
+                Mask hu_threshold;
+                bool hu_valid = false;
+
+                Mask vertebra_distance;
+                bool vertebra_valid = false;
+
+                Mask visceral_fat;
+                std::set<int> debug_rows;
+                std::set<int> debug_cols;
+                unsigned int muscle_revision = 0; // Revision of the collection from which the mask has been built
+                bool visceral_valid = false;
+
+                Mask other_segmentation;
+                unsigned int other_revision = 0;
+                bool other_valid = false;
+            };
+
+            struct State {
+                // Main thread only
+                bool alive = true;
+                bool job_running = false;
+                bool dirty = false;
+                cv::Mat image;
+                int generation = 0;
+                int requested_generation = -1;
+                // Incremented by each new request (and each new image), the published limit is up to date once it
+                // comes from the last request
+                int request = 0;
+                int published_request = -1;
+                EditionLimitParams params;
+                publishFct publish_fct = [](const std::shared_ptr<EditionLimitResult> &) {};
+
+                // Set by the main thread when the running job computes something that is not needed anymore
+                std::atomic<bool> outdated{false};
+
+                Cache cache;
+            };
+
+            std::shared_ptr<State> state_;
+
+            static void launch(const std::shared_ptr<State> &state);
+
+            static bool compute(Cache &cache, const cv::Mat &image, int generation, const EditionLimitParams &params,
+                                EditionLimitResult &result, const std::atomic<bool> &outdated, const bool &abort);
+
+        public:
+            EditionLimitPipeline();
+
+            ~EditionLimitPipeline();
+
+            EditionLimitPipeline(const EditionLimitPipeline &) = delete;
+            void operator=(const EditionLimitPipeline &) = delete;
+
+            /**
+             * Sets the function called on the main thread when a new edition limit is available
+             */
+            void setPublishFunction(const publishFct &fct);
+
+            /**
+             * Sets the slice on which the edition limit is computed
+             * Results for the previous slice will not be published anymore
+             */
+            void setImage(const cv::Mat &image);
+
+            /**
+             * Asks for the edition limit with the given parameters
+             * Does nothing if these parameters are already computed or being computed for the current image
+             */
+            void request(const EditionLimitParams &params);
+
+            /**
+             * @return true if the edition limit of the last request has been published
+             */
+            bool isReady() const;
+
+            void reset();
+        };
+    }
+}
@@ -0,0 +1,178 @@
+#include "hu_threshold.h"
+
+#include <algorithm>
+#include <climits>
+
+namespace core {
+    namespace segmentation {
+
+        void HuThresholdCache::build_index() {
+            const int num_pixels = image_.rows * image_.cols;
+            auto *image_array = (short int *) image_.data;
+
+            sorted_pixels_.clear();
+            sorted_values_.clear();
+            if (num_pixels == 0)
+                return;
+
+            short min_value = SHRT_MAX;
+            short max_value = SHRT_MIN;
+            for (int pixel_index = 0; pixel_index < num_pixels; pixel_index++) {
+                min_value = std::min(min_value, image_array[pixel_index]);
+                max_value = std::max(max_value, image_array[pixel_index]);
+            }
+
+            // Counting sort on the HU values, the range of a CT slice is small compared to the number of pixels
+            std::vector<int> offsets((int) max_value - (int) min_value + 2, 0);
+            for (int pixel_index = 0; pixel_index < num_pixels; pixel_index++) {
+                offsets[image_array[pixel_index] - min_value + 1]++;
+            }
+            for (size_t i = 1; i < offsets.size(); i++) {
+                offsets[i] += offsets[i - 1];
+            }
+
+            sorted_pixels_.resize(num_pixels);
+            sorted_values_.resize(num_pixels);
+            for (int pixel_index = 0; pixel_index < num_pixels; pixel_index++) {
+                int position = offsets[image_array[pixel_index] - min_value]++;
+                sorted_pixels_[position] = pixel_index;
+                sorted_values_[position] = image_array[pixel_index];
+            }
+        }
+
+        void HuThresholdCache::full_threshold() {
+            raw_.create(image_.rows, image_.cols, CV_8U);
+
+            auto *image_array = (short int *) image_.data;
+            uchar *raw_array = raw_.data;
+            for (int pixel_index = 0; pixel_index < image_.rows * image_.cols; pixel_index++) {
+                raw_array[pixel_index] = min_hu_ <= image_array[pixel_index] && image_array[pixel_index] <= max_hu_;
+            }
+        }
+
+        cv::Rect HuThresholdCache::move_bounds(int min_hu, int max_hu) {
+            int min_row = image_.rows, max_row = -1;
+            int min_col = image_.cols, max_col = -1;
+
+            uchar *raw_array = raw_.data;
+            auto flip = [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    uchar value = min_hu <= sorted_values_[i] && sorted_values_[i] <= max_hu;
+                    int pixel_index = sorted_pixels_[i];
+                    if (raw_array[pixel_index] != value) {
+                        raw_array[pixel_index] = value;
+                        int row = pixel_index / image_.cols;
+                        int col = pixel_index % image_.cols;
+                        min_row = std::min(min_row, row);
+                        max_row = std::max(max_row, row);
+                        min_col = std::min(min_col, col);
+                        max_col = std::max(max_col, col);
+                    }
+                }
+            };
+
+            auto begin = sorted_values_.begin();
+            auto end = sorted_values_.end();
+            // Values in [lower, upper[ for the min bound, ]lower, upper] for the max bound
+            if (min_hu != min_hu_) {
+                auto first = std::lower_bound(begin, end, std::min(min_hu, min_hu_));
+                auto last = std::lower_bound(begin, end, std::max(min_hu, min_hu_));
+                flip(first - begin, last - begin);
+            }
+            if (max_hu != max_hu_) {
+                auto first = std::upper_bound(begin, end, std::min(max_hu, max_hu_));
+                auto last = std::upper_bound(begin, end, std::max(max_hu, max_hu_));
+                flip(first - begin, last - begin);
+            }
+            min_hu_ = min_hu;
+            max_hu_ = max_hu;
+
+            if (max_row < 0)
+                return cv::Rect();
+            return cv::Rect(min_col, min_row, max_col - min_col + 1, max_row - min_row + 1);
+        }
+
+        void HuThresholdCache::apply_morphology(const cv::Rect &changed) {
+            const cv::Rect image_rect(0, 0, image_.cols, image_.rows);
+
+            // A closing (resp. opening) of radius r only looks 2r pixels away
+            int reach = 2 * closing_size_ + 2 * opening_size_;
+            cv::Rect output = (changed + cv::Size(2 * reach, 2 * reach) - cv::Point(reach, reach)) & image_rect;
+            cv::Rect input = (output + cv::Size(2 * reach, 2 * reach) - cv::Point(reach, reach)) & image_rect;
+
+            if (output.area() == 0)
+                return;
+
+            // Work on a copy so that OpenCV does not read outside of the input rectangle
+            cv::Mat area = raw_(input).clone();
+            if (closing_size_ > 0) {
+                int diameter = closing_size_ * 2 + 1;
+                auto kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(diameter, diameter));
+                cv::morphologyEx(area, area, cv::MORPH_CLOSE, kernel);
+            }
+            if (opening_size_ > 0) {
+                int diameter = opening_size_ * 2 + 1;
+                auto kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(diameter, diameter));
+                cv::morphologyEx(area, area, cv::MORPH_OPEN, kernel);
+            }
+            area(output - input.tl()).copyTo(morph_(output));
+        }
+
+        Mask HuThresholdCache::update(const cv::Mat &image_matrix, int min_hu, int max_hu, bool ignore_small_objects,
+                                      int closing_size, int opening_size, int image_generation) {
+            if (image_matrix.empty())
+                return Mask();
+
+            // The buffer alone does not tell that the values are the same, the image may have been written in place
+            bool new_image = !is_valid_ || image_generation != source_generation_ || image_matrix.data != source_.data
+                             || image_matrix.size() != source_.size() || image_matrix.step[0] != source_.step[0];
+
+            if (new_image) {
+                // Keeping a reference on the source guarantees that its buffer cannot be reused by another slice
+                source_ = image_matrix;
+                source_generation_ = image_generation;
+                // Cropped slices are views on the full slice, the index needs contiguous data
+                image_ = image_matrix.isContinuous() ? image_matrix : image_matrix.clone();
+                build_index();
+            }
+
+            if (new_image || closing_size != closing_size_ || opening_size != opening_size_) {
+                min_hu_ = min_hu;
+                max_hu_ = max_hu;
+                closing_size_ = closing_size;
+                opening_size_ = opening_size;
+                full_threshold();
+                morph_.create(image_.rows, image_.cols, CV_8U);
+                apply_morphology(cv::Rect(0, 0, image_.cols, image_.rows));
+                is_valid_ = true;
+            } else {
+                cv::Rect changed = move_bounds(min_hu, max_hu);
+                if (changed.area() > 0)
+                    apply_morphology(changed);
+            }
+
+            Mask threshold_mask;
+            cv::Mat data = morph_.clone();
+            threshold_mask.setData(data);
+
+            // Small objects depend on whole connected components, this step stays global (but linear)
+            if (ignore_small_objects) {
+                threshold_mask.remove_small_objects(100);
+                threshold_mask.invert();
+                threshold_mask.remove_small_objects(100);
+                threshold_mask.invert();
+            }
+            return threshold_mask;
+        }
+
+        void HuThresholdCache::reset() {
+            is_valid_ = false;
+            source_ = cv::Mat();
+            image_ = cv::Mat();
+            raw_ = cv::Mat();
+            morph_ = cv::Mat();
+            sorted_pixels_.clear();
+            sorted_values_.clear();
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+#include "mask.h"
+
+namespace core {
+    namespace segmentation {
+
+        /**
+         * Incremental version of huThresholdMask for a single slice
+         *
+         * The HU values of the slice are indexed once (pixels sorted by HU value). When only the HU bounds
+         * change, only the pixels whose value crosses a moved bound are flipped, and the closing / opening
+         * are re-run on the neighbourhood of the flipped pixels instead of the whole image.
+         * Changing the image or the morphology sizes falls back to a full rebuild.
+         */
+        class HuThresholdCache {
+        private:
+            cv::Mat source_;
+            int source_generation_ = 0;
+            cv::Mat image_;
+
+            // Pixel indices sorted by HU value, and the matching sorted HU values
+            std::vector<int> sorted_pixels_;
+            std::vector<short> sorted_values_;
+
+            // Plain threshold, and threshold after closing + opening
+            cv::Mat raw_;
+            cv::Mat morph_;
+
+            int min_hu_ = 0;
+            int max_hu_ = 0;
+            int closing_size_ = 0;
+            int opening_size_ = 0;
+            bool is_valid_ = false;
+
+            void build_index();
+
+            void full_threshold();
+
+            /**
+             * Flips the pixels whose value lies between an old and a new bound
+             * @return bounding box of the flipped pixels (empty if nothing changed)
+             */
+            cv::Rect move_bounds(int min_hu, int max_hu);
+
+            /**
+             * Recomputes morph_ inside the area that can be affected by a change of raw_ in `changed`
+             */
+            void apply_morphology(const cv::Rect &changed);
+
+        public:
+            HuThresholdCache() = default;
+
+            /**
+             * Returns the same mask as huThresholdMask called with the same arguments
+             * The result is a copy, the cache can be updated while the returned mask is in use
+             * @param image_generation must change when the values of the image are changed in place
+             */
+            Mask update(const cv::Mat &image_matrix, int min_hu, int max_hu, bool ignore_small_objects,
+                        int closing_size, int opening_size, int image_generation = 0);
+
+            /**
+             * Forgets the cached slice, the next call to update will do a full rebuild
+             */
+            void reset();
+        };
+    }
+}
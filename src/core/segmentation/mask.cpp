@@ -1,5 +1,6 @@
 #include "mask.h"
 #include "core/np2cv.h"
+#include "python/executor.h"
 #include "pybind11/stl.h"
 
 namespace core {
@@ -7,17 +8,6 @@ namespace core {
         namespace py = pybind11;
         using namespace py::literals;
 
-        void npy_buffer_to_cv(py::object object, cv::Mat &mat) {
-            auto buffer = object.cast<py::buffer>();
-            py::buffer_info info = buffer.request();
-            int rows = info.shape[0];
-            int cols = info.shape[1];
-
-            auto array = static_cast<unsigned char *>(info.ptr);
-            mat.create(rows, cols, CV_8U);
-            memcpy(mat.data, array, sizeof(unsigned char) * rows * cols);
-        }
-
         Mask::Mask(int rows, int cols, bool ones) : rows_(rows), cols_(cols) {
             setDimensions(rows, cols, false, ones);
         }
@@ -151,13 +141,14 @@ namespace core {
             auto *labels_array = (int *) labels.data;
             unsigned char *mask_array = data_.data;
 
+            // One lookup per pixel instead of one pass over the image per region
+            std::vector<unsigned char> remove_region(regions_count, 0);
             for (int region_index = 0; region_index < regions_count; region_index++) {
-                if (stats.at<int>(region_index, cv::CC_STAT_AREA) < min_object_size) {
-                    for (int pixel_index = 0; pixel_index < cols() * rows(); pixel_index++) {
-                        if (labels_array[pixel_index] == region_index) {
-                            mask_array[pixel_index] = 0;
-                        }
-                    }
+                remove_region[region_index] = stats.at<int>(region_index, cv::CC_STAT_AREA) < min_object_size;
+            }
+            for (int pixel_index = 0; pixel_index < cols() * rows(); pixel_index++) {
+                if (remove_region[labels_array[pixel_index]]) {
+                    mask_array[pixel_index] = 0;
                 }
             }
         }
@@ -305,6 +296,7 @@ namespace core {
             }
 
             it_ = history_.end();
+            revision_++;
         }
 
         void MaskCollection::push_new() {
@@ -334,49 +326,71 @@ namespace core {
             jobFct job = [=](float &progress, bool &abort) -> std::shared_ptr<JobResult> {
                 auto result = std::make_shared<JobResult>();
 
-                auto state = PyGILState_Ensure();
-                try {
+                std::string basename;
+                {
                     std::lock_guard<std::recursive_mutex> lock(ref_mutex_);
-                    py::module script = py::module::import("python.scripts.segmentation");
-
-                    auto &dict = script.attr("load_mask_collection")(basename_path_).cast<py::dict>();
-
-                    clearHistory();
-
-                    if (dict.contains("current")) {
-                        Mask mask;
-                        npy_buffer_to_cv(dict["current"], mask.getData());
-                        mask.setNotEmpty();
-                        mask.setState(Mask::MASK_EDITED);
-                        mask.updateDimensions();
-                        push(mask);
-                    }
-                    if (dict.contains("predicted")) {
-                        npy_buffer_to_cv(dict["predicted"], prediction_.getData());
-                        prediction_.setState(Mask::MASK_PREDICTION);
-                        prediction_.setNotEmpty();
-                        prediction_.updateDimensions();
-                    }
-                    if (dict.contains("validated")) {
-                        npy_buffer_to_cv(dict["validated"], validated_.getData());
-                        prediction_.setState(Mask::MASK_VALIDATED);
-                        validated_.setNotEmpty();
-                        validated_.updateDimensions();
-                    }
-
-                    auto &users = dict["users"].cast<std::vector<std::string>>();
-                    for (auto &user: users) {
-                        setValidatedBy(user);
-                    }
+                    basename = basename_path_;
+                }
 
-                    is_valid_ = true;
+                // The collection is only locked once Python has read the file
+                bool has_current = false, has_predicted = false, has_validated = false;
+                cv::Mat current, predicted, validated;
+                std::vector<std::string> users;
+                auto &executor = PyAPI::Executor::getInstance();
+                try {
+                    executor.call([&] {
+                        auto dict = executor.functions().load_mask_collection(basename).cast<py::dict>();
+                        if (dict.contains("current")) {
+                            npy_buffer_to_cv(dict["current"], current);
+                            has_current = true;
+                        }
+                        if (dict.contains("predicted")) {
+                            npy_buffer_to_cv(dict["predicted"], predicted);
+                            has_predicted = true;
+                        }
+                        if (dict.contains("validated")) {
+                            npy_buffer_to_cv(dict["validated"], validated);
+                            has_validated = true;
+                        }
+                        users = dict["users"].cast<std::vector<std::string>>();
+                    });
                 }
                 catch (const std::exception &e) {
-                    py::print(e.what());
+                    std::cout << e.what() << std::endl;
                     result->err = e.what();
+                    return result;
+                }
+
+                std::lock_guard<std::recursive_mutex> lock(ref_mutex_);
+                clearHistory();
+
+                if (has_current) {
+                    Mask mask;
+                    mask.getData() = current;
+                    mask.setNotEmpty();
+                    mask.setState(Mask::MASK_EDITED);
+                    mask.updateDimensions();
+                    push(mask);
+                }
+                if (has_predicted) {
+                    prediction_.getData() = predicted;
+                    prediction_.setState(Mask::MASK_PREDICTION);
+                    prediction_.setNotEmpty();
+                    prediction_.updateDimensions();
+                }
+                if (has_validated) {
+                    validated_.getData() = validated;
+                    prediction_.setState(Mask::MASK_VALIDATED);
+                    validated_.setNotEmpty();
+                    validated_.updateDimensions();
+                }
+
+                for (auto &user: users) {
+                    setValidatedBy(user);
                 }
 
-                PyGILState_Release(state);
+                is_valid_ = true;
+                revision_++;
                 return result;
             };
 
@@ -425,6 +439,7 @@ namespace core {
                 clearHistory();
                 is_set_ = false;
                 is_valid_ = false;
+                revision_++;
             }
         }
 
@@ -452,39 +467,48 @@ namespace core {
             return pending_jobs_.size();
         }
 
-        std::string MaskCollection::saveCollection(const std::string &basename) {
+        std::future<std::string> MaskCollection::saveCollection(const std::string &basename) {
             basename_path_ = basename;
             return saveCollection();
         }
 
-        std::string MaskCollection::saveCollection() {
+        std::future<std::string> MaskCollection::saveCollection() {
             if (basename_path_.empty()) {
-                return "Cannot save mask because basename path is missing";
+                std::promise<std::string> error;
+                error.set_value("Cannot save mask because basename path is missing");
+                return error.get_future();
             }
 
-            std::string error_msg;
-            auto state = PyGILState_Ensure();
-            try {
-                NDArrayConverter::init_numpy();
-                py::module np = py::module::import("numpy");
-                auto &current = getCurrent();
-
-                py::module seg = py::module::import("python.scripts.segmentation");
-                std::vector<std::string> users;
+            // The masks are copied, so that the collection can be modified while the Executor saves them
+            std::vector<std::string> users;
+            cv::Mat current, validated, prediction;
+            std::string basename;
+            {
+                std::lock_guard<std::recursive_mutex> lock(ref_mutex_);
                 for (auto &user: validated_by_) {
                     users.push_back(user);
                 }
-                seg.attr("save_mask_collection")(users, current.getData(), validated_.getData(), prediction_.getData(),
-                                                 basename_path_);
+                current = getCurrent().getData().clone();
+                validated = validated_.getData().clone();
+                prediction = prediction_.getData().clone();
+                basename = basename_path_;
                 is_set_ = true;
             }
-            catch (const std::exception &e) {
-                std::cout << e.what() << std::endl;
-                error_msg = e.what();
-            }
-            PyGILState_Release(state);
 
-            return error_msg;
+            // The calls of the Executor are executed in order, a later loadData reads this save
+            return PyAPI::Executor::getInstance().submit([=]() -> std::string {
+                auto &executor = PyAPI::Executor::getInstance();
+                try {
+                    // The copies are given to Python as views, they are not copied again
+                    executor.functions().save_mask_collection(users, cv_to_npy(current), cv_to_npy(validated),
+                                                              cv_to_npy(prediction), basename);
+                }
+                catch (const std::exception &e) {
+                    std::cout << e.what() << std::endl;
+                    return e.what();
+                }
+                return "";
+            });
         }
 
         MaskCollection MaskCollection::copy() {
@@ -505,6 +529,7 @@ namespace core {
             if (is_valid_) {
                 history_.clear();
                 it_ = history_.end();
+                revision_++;
                 //is_valid_ = false;
             }
         }
@@ -521,6 +546,9 @@ namespace core {
                 }
             }
             dicom->loadCase(0, false, [this, &dicom](const core::Dicom &dicom_res) {
+                // Not loaded (error, or images replaced), no reference has been taken on the case
+                if (!dicom_res.is_set)
+                    return;
                 std::lock_guard<std::recursive_mutex> lock(ref_mutex_);
                 rows_ = dicom_res.data.rows;
                 cols_ = dicom_res.data.cols;
@@ -543,6 +571,7 @@ namespace core {
             }
             if (it_ != ++history_.begin()) {
                 it_--;
+                revision_++;
             }
             return getCurrent();
         }
@@ -553,6 +582,7 @@ namespace core {
             }
             if (it_ != history_.end()) {
                 it_++;
+                revision_++;
             }
             return getCurrent();
         }
@@ -594,12 +624,14 @@ namespace core {
         void MaskCollection::setValidatedBy(std::string name) {
             validated_by_.insert(name);
             is_validated_ = true;
+            revision_++;
         }
 
         void MaskCollection::removeAllValidatedBy() {
             is_validated_ = false;
             validated_by_.clear();
             validated_ = Mask();
+            revision_++;
         }
 
         void MaskCollection::removeValidatedBy(std::string name) {
@@ -610,6 +642,7 @@ namespace core {
                 is_validated_ = false;
                 validated_ = Mask();
             }
+            revision_++;
         }
 
         Mask MaskCollection::getMostAdvancedMask() {
@@ -629,17 +662,13 @@ namespace core {
 
 
         Mask huThresholdMask(const cv::Mat &image_matrix, int min_hu, int max_hu, bool ignore_small_objects,
-                             int closing_size, int opening_size) {
-
-            Mask threshold_mask(image_matrix.rows, image_matrix.cols);
-
-            auto *image_matrix_array = (short int *) image_matrix.data;
-            uchar *threshold_mask_matrix_array = threshold_mask.getData().data;
-
-            for (int pixel_index = 0; pixel_index < image_matrix.cols * image_matrix.rows; pixel_index++) {
-                threshold_mask_matrix_array[pixel_index] =
-                        min_hu <= image_matrix_array[pixel_index] && image_matrix_array[pixel_index] <= max_hu;
-            }
+                             int closing_size, int opening_size, int min_object_size) {
+            // inRange goes through the image row by row, it can be a crop of a larger image
+            cv::Mat in_range;
+            cv::inRange(image_matrix, cv::Scalar(min_hu), cv::Scalar(max_hu), in_range);
+            cv::bitwise_and(in_range, cv::Scalar(1), in_range);
+            Mask threshold_mask;
+            threshold_mask.setData(in_range);
 
             if (closing_size > 0) {
                 threshold_mask.closing(closing_size);
@@ -649,10 +678,10 @@ namespace core {
                 threshold_mask.opening(opening_size);
             }
 
-            if (ignore_small_objects) {
-                threshold_mask.remove_small_objects(100);
+            if (ignore_small_objects && min_object_size > 0) {
+                threshold_mask.remove_small_objects(min_object_size);
                 threshold_mask.invert();
-                threshold_mask.remove_small_objects(100);
+                threshold_mask.remove_small_objects(min_object_size);
                 threshold_mask.invert();
             }
 
@@ -678,6 +707,147 @@ namespace core {
             return vertebra_distance_mask;
         }
 
+        Mask visceralFatMask(Mask &muscle_mask, std::set<int> &debug_rows, std::set<int> &debug_cols) {
+            Mask visceral_fat_mask(muscle_mask.rows(), muscle_mask.cols());
+            visceral_fat_mask.fill(1);
+
+            if (!muscle_mask.empty()) {
+                int top_muscle_row = muscle_mask.top_row();
+                debug_rows.insert(top_muscle_row);
+                int bottom_muscle_row = muscle_mask.bottom_row();
+                debug_rows.insert(bottom_muscle_row);
+                int base_row = top_muscle_row + (bottom_muscle_row - top_muscle_row) / 4;
+                debug_rows.insert(base_row);
+
+                int left_column = 0;
+                while (left_column < muscle_mask.cols() && muscle_mask.get_pixel(base_row, left_column) == 0) {
+                    left_column++;
+                }
+                int right_column = muscle_mask.cols() - 1;
+                while (right_column >= 0 && muscle_mask.get_pixel(base_row, right_column) == 0) {
+                    right_column--;
+                }
+
+                int columns_margin = (right_column - left_column) / 8;
+                left_column += columns_margin;
+                right_column -= columns_margin;
+                debug_cols.insert(left_column);
+                debug_cols.insert(right_column);
+
+                cv::Point first_muscle_point = muscle_mask.find_first_pixel(base_row, muscle_mask.rows(), left_column,
+                                                                            right_column);
+                debug_rows.insert(first_muscle_point.y);
+                debug_cols.insert(first_muscle_point.x);
+
+                cv::Point second_muscle_point_candidate1 = muscle_mask.find_first_pixel(base_row, muscle_mask.rows(),
+                                                                                        left_column,
+                                                                                        first_muscle_point.x -
+                                                                                        columns_margin);
+                cv::Point second_muscle_point_candidate2 = muscle_mask.find_first_pixel(base_row, muscle_mask.rows(),
+                                                                                        right_column,
+                                                                                        first_muscle_point.x +
+                                                                                        columns_margin);
+
+                cv::Point second_muscle_point = second_muscle_point_candidate1.y < second_muscle_point_candidate2.y ?
+                                                second_muscle_point_candidate1 : second_muscle_point_candidate2;
+                debug_rows.insert(second_muscle_point.y);
+                debug_cols.insert(second_muscle_point.x);
+
+                cv::line(visceral_fat_mask.getData(),
+                         first_muscle_point,
+                         second_muscle_point,
+                         0);
+            }
+            return visceral_fat_mask;
+        }
+
+        void editMaskArea(Mask &target, const Mask &area, const Mask *edition_limit, bool add, bool remove,
+                          bool only_if_limitation_used) {
+            cv::Mat &data = target.getData();
+            const cv::Mat &area_data = area.getData();
+            if (data.empty() || data.size() != area_data.size()) {
+                return;
+            }
+            const uchar *limit_array = nullptr;
+            if (edition_limit != nullptr && edition_limit->getData().size() == data.size()) {
+                limit_array = edition_limit->getData().data;
+            }
+
+            uchar *data_array = data.data;
+            const uchar *area_array = area_data.data;
+            const int num_pixels = data.rows * data.cols;
+
+            if (only_if_limitation_used) {
+                bool touches_inside = false;
+                bool touches_outside = false;
+                if (limit_array != nullptr) {
+                    for (int pixel_index = 0; pixel_index < num_pixels; pixel_index++) {
+                        if (area_array[pixel_index] != 0) {
+                            if (limit_array[pixel_index] != 0)
+                                touches_inside = true;
+                            else
+                                touches_outside = true;
+                        }
+                    }
+                }
+                add = add && touches_outside;
+                remove = remove && touches_inside;
+            }
+            if (!add && !remove) {
+                return;
+            }
+
+            for (int pixel_index = 0; pixel_index < num_pixels; pixel_index++) {
+                if (area_array[pixel_index] != 0) {
+                    bool inside_limit = limit_array == nullptr || limit_array[pixel_index] != 0;
+                    if (add && inside_limit) {
+                        data_array[pixel_index] = 1;
+                    }
+                    if (remove && (limit_array == nullptr || !inside_limit)) {
+                        data_array[pixel_index] = 0;
+                    }
+                }
+            }
+        }
+
+        void autoBrushBorders(Mask &mask, const Mask &edition_limit, float radius) {
+            cv::Mat &data = mask.getData();
+            const cv::Mat &limit = edition_limit.getData();
+            if (data.empty() || data.size() != limit.size()) {
+                return;
+            }
+            // Same rounding as cv::circle
+            auto brush_radius = (float) (int) radius;
+
+            // Border pixels: set, with at least one 4-neighbour not set (outside of the image does not count)
+            cv::Mat eroded;
+            auto cross = cv::getStructuringElement(cv::MORPH_CROSS, cv::Size(3, 3));
+            cv::erode(data, eroded, cross, cv::Point(-1, -1), 1, cv::BORDER_CONSTANT, cv::Scalar(1));
+            cv::Mat border = (data == 1) & (eroded == 0);
+
+            cv::Mat inside_limit = limit != 0;
+            cv::Mat outside_limit = limit == 0;
+
+            // Distance transform gives, for each pixel, the distance to the closest zero pixel
+            cv::Mat distance_to_outside;
+            cv::Mat distance_to_inside;
+            cv::distanceTransform(inside_limit, distance_to_outside, cv::DIST_L2, cv::DIST_MASK_PRECISE);
+            cv::distanceTransform(outside_limit, distance_to_inside, cv::DIST_L2, cv::DIST_MASK_PRECISE);
+
+            // Brush dabs that are cut by the limit
+            cv::Mat add_centers = border & (distance_to_outside <= brush_radius);
+            cv::Mat remove_centers = border & (distance_to_inside <= brush_radius);
+
+            cv::Mat distance_to_centers;
+            if (cv::countNonZero(add_centers) > 0) {
+                cv::distanceTransform(~add_centers, distance_to_centers, cv::DIST_L2, cv::DIST_MASK_PRECISE);
+                data.setTo(1, (distance_to_centers <= brush_radius) & inside_limit);
+            }
+            if (cv::countNonZero(remove_centers) > 0) {
+                cv::distanceTransform(~remove_centers, distance_to_centers, cv::DIST_L2, cv::DIST_MASK_PRECISE);
+                data.setTo(0, (distance_to_centers <= brush_radius) & outside_limit);
+            }
+        }
 
         void lassoSelectToMask(const std::vector<cv::Point> &pts, Mask &mask, int value) {
             if (!pts.empty() && mask.getData().rows > 0 && mask.getData().cols > 0)
@@ -1,9 +1,11 @@
 #pragma once
 
+#include <future>
 #include <string>
 #include <list>
 #include <memory>
 #include <mutex>
+#include <atomic>
 
 #include "opencv2/opencv.hpp"
 #include "python/py_api.h"
@@ -16,8 +18,6 @@ namespace core {
 			std::string name;
 		};
 
-		void npy_buffer_to_cv(pybind11::object object, cv::Mat& mat);
-
 		/**
 		 * Little container class around cv::Mat to store and manipulate masks 
 		 * 
@@ -65,6 +65,7 @@ namespace core {
 			 * Returns the opencv matrix that represent the mask 
 			*/
 			cv::Mat& getData() { return data_; }
+			const cv::Mat& getData() const { return data_; }
 
 			void setData(cv::Mat& data);
 
@@ -136,6 +137,8 @@ namespace core {
 			bool is_validated_ = false;
 			bool keep_ = false;
 			bool is_loading_ = false;
+			// Incremented each time one of the masks changes
+			std::atomic<unsigned int> revision_{0};
 
 			static int global_counter_;
 
@@ -189,7 +192,13 @@ namespace core {
 			void lock();
 			void unlock();
 
-			bool isSet() { return is_set_; }
+			bool isSet() { std::lock_guard<std::recursive_mutex> lock(ref_mutex_); return is_set_; }
+
+			/**
+			 * Changes each time the history, the prediction or the validation of the collection changes, so that
+			 * what has been computed from the masks can be kept as long as the revision stays the same
+			*/
+			unsigned int getRevision() const { return revision_; }
 
 			/**
 			 * Goes back into the history of the mask collection
@@ -221,26 +230,62 @@ namespace core {
 
 			void setBasenamePath(const std::string& basename);
 
-			std::string saveCollection(const std::string& basename);
-			std::string saveCollection();
+			/**
+			 * Saves the collection in <basename>.npz, asynchronously on the PyAPI::Executor (the masks are copied
+			 * first, the collection can be modified right away)
+			 * @return future of the error message, empty once the file has been written
+			 */
+			std::future<std::string> saveCollection(const std::string& basename);
+			std::future<std::string> saveCollection();
 
 			bool getIsValidated() { return is_validated_; }
 			std::set<std::string> getValidatedBy() { return validated_by_; }
 
-			void setValidated(Mask& mask) { validated_ = mask.copy(); }
+			void setValidated(Mask& mask) { validated_ = mask.copy(); revision_++; }
 			void setValidatedBy(std::string name);
 			void removeAllValidatedBy();
 			void removeValidatedBy(std::string name);
 
-			void setPrediction(const Mask& mask) { prediction_ = prediction_; }
+			void setPrediction(const Mask& mask) { prediction_ = prediction_; revision_++; }
 		};
 
+        /**
+         * Pixels whose HU value is in [min_hu, max_hu], followed by a closing, an opening and the removal of the
+         * objects and holes smaller than min_object_size pixels (if ignore_small_objects is set)
+         * @param image_matrix HU values (CV_16S), does not need to be continuous (e.g. a crop)
+         */
         Mask huThresholdMask(const cv::Mat &image_matrix, int min_hu, int max_hu, bool ignore_small_objects,
                              int closing_size,
-                             int opening_size);
+                             int opening_size,
+                             int min_object_size = 100);
 
         Mask vertebraDistanceMask(const cv::Mat &image_matrix, int vertebra_min_hu, int vertebra_min_distance);
 
+        /**
+         * Builds the visceral fat help mask from a muscle mask: everything is editable, except a line
+         * between the two first muscle points found below the top quarter of the muscles
+         * The rows and columns used to find these points are stored in debug_rows / debug_cols
+         */
+        Mask visceralFatMask(Mask &muscle_mask, std::set<int> &debug_rows, std::set<int> &debug_cols);
+
+        /**
+         * Adds and/or removes an area from the target mask, in place
+         * With an edition limit, only the part of the area inside the limit is added, and only the part outside
+         * of the limit is removed. If only_if_limitation_used is set, the addition (resp. removal) is only done
+         * if the limit actually cuts the area.
+         */
+        void editMaskArea(Mask &target, const Mask &area, const Mask *edition_limit, bool add, bool remove,
+                          bool only_if_limitation_used = false);
+
+        /**
+         * Runs the brush (of the given radius) along the border of the mask, and keeps only the changes that
+         * are constrained by the edition limit: parts of the brush inside the limit are added when the brush
+         * touches the outside of the limit, parts outside of the limit are removed when it touches the inside.
+         *
+         * Computed with distance transforms, so the cost is linear in the image size
+         */
+        void autoBrushBorders(Mask &mask, const Mask &edition_limit, float radius);
+
 		void lassoSelectToMask(const std::vector<cv::Point>& pts, Mask& mask, int value = 1);
 
 		//void boxSelectToMask(const ImVec2& top_left, const ImVec2& bottom_right, Mask& mask, int value = 1);
@@ -1,13 +1,343 @@
 #include "ml.h"
 
-#include <iostream>
+#include <set>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+#include "mask.h"
 
 namespace core {
 	namespace segmentation {
 		ML_Model::ML_Model(const std::string& name, int ww, int wc, int input_size)
 			: name_(name), ww_(ww), wc_(wc), input_size_(input_size)
 		{
-			std::cout << "Hello world" << std::endl;
+		}
+
+		namespace {
+			/**
+			 * Windows the HU values of an image to [0, 1], in one pass written so that the compiler vectorises it
+			 */
+			void window_image(const cv::Mat& image, float wc, float ww, cv::Mat& windowed) {
+				windowed.create(image.size(), CV_32F);
+				const float scale = 1.f / ww;
+				const float shift = -(wc - ww / 2.f) / ww;
+				for (int row = 0; row < image.rows; row++) {
+					const short* src = image.ptr<short>(row);
+					float* dst = windowed.ptr<float>(row);
+					for (int col = 0; col < image.cols; col++) {
+						float value = (float)src[col] * scale + shift;
+						dst[col] = std::min(std::max(value, 0.f), 1.f);
+					}
+				}
+			}
+
+			/**
+			 * Field of a protobuf message, value is set for the integers, data and size for the length-delimited
+			 * fields (strings and sub-messages)
+			 */
+			struct ProtoField {
+				uint32_t number = 0;
+				uint64_t value = 0;
+				const unsigned char* data = nullptr;
+				size_t size = 0;
+			};
+
+			bool read_varint(const unsigned char*& pos, const unsigned char* end, uint64_t& value) {
+				value = 0;
+				for (int shift = 0; pos < end && shift < 64; shift += 7) {
+					unsigned char byte = *pos++;
+					value |= (uint64_t)(byte & 0x7F) << shift;
+					if (!(byte & 0x80))
+						return true;
+				}
+				return false;
+			}
+
+			/**
+			 * Splits a protobuf message into its fields (only the wire format is read)
+			 * @return fields, empty if the message is invalid
+			 */
+			std::vector<ProtoField> read_message(const unsigned char* data, size_t size) {
+				std::vector<ProtoField> fields;
+				const unsigned char* pos = data;
+				const unsigned char* end = data + size;
+				while (pos < end) {
+					uint64_t key;
+					ProtoField field;
+					if (!read_varint(pos, end, key))
+						return {};
+					field.number = (uint32_t)(key >> 3);
+					switch (key & 7) {
+					case 0:
+						if (!read_varint(pos, end, field.value))
+							return {};
+						break;
+					case 1:
+					case 5: {
+						size_t length = (key & 7) == 1 ? 8 : 4;
+						if ((size_t)(end - pos) < length)
+							return {};
+						pos += length;
+						break;
+					}
+					case 2:
+						if (!read_varint(pos, end, field.value) || field.value > (uint64_t)(end - pos))
+							return {};
+						field.data = pos;
+						field.size = (size_t)field.value;
+						pos += field.size;
+						break;
+					default:
+						return {};
+					}
+					fields.push_back(field);
+				}
+				return fields;
+			}
+
+			/**
+			 * @return sub-messages (or strings) of a message with the given field number
+			 */
+			std::vector<ProtoField> get_fields(const ProtoField& message, uint32_t number) {
+				std::vector<ProtoField> fields;
+				for (auto& field : read_message(message.data, message.size)) {
+					if (field.number == number && field.data != nullptr)
+						fields.push_back(field);
+				}
+				return fields;
+			}
+
+			/**
+			 * Reads the shape of the first input of an ONNX model (ModelProto.graph.input), the dimensions that are
+			 * not fixed are set to -1
+			 * @return empty if the shape could not be read
+			 */
+			std::vector<int64_t> onnx_input_shape(const std::vector<char>& model) {
+				ProtoField model_message;
+				model_message.data = (const unsigned char*)model.data();
+				model_message.size = model.size();
+				auto graphs = get_fields(model_message, 7);
+				if (graphs.empty())
+					return {};
+
+				// Older exports also list the weights (initializers) in the inputs
+				std::set<std::string> initializers;
+				for (auto& tensor : get_fields(graphs[0], 5)) {
+					for (auto& name : get_fields(tensor, 8))
+						initializers.insert(std::string((const char*)name.data, name.size));
+				}
+
+				// ValueInfoProto { name = 1, type = 2 }, TypeProto { tensor_type = 1 }, Tensor { shape = 2 },
+				// TensorShapeProto { dim = 1 }, Dimension { dim_value = 1, dim_param = 2 }
+				for (auto& input : get_fields(graphs[0], 11)) {
+					auto names = get_fields(input, 1);
+					if (!names.empty() && initializers.count(std::string((const char*)names[0].data, names[0].size)))
+						continue;
+					std::vector<int64_t> shape;
+					for (auto& type : get_fields(input, 2)) {
+						for (auto& tensor : get_fields(type, 1)) {
+							for (auto& tensor_shape : get_fields(tensor, 2)) {
+								for (auto& dim : get_fields(tensor_shape, 1)) {
+									int64_t dim_value = -1;
+									for (auto& dim_field : read_message(dim.data, dim.size)) {
+										if (dim_field.number == 1 && dim_field.data == nullptr && (int64_t)dim_field.value > 0)
+											dim_value = (int64_t)dim_field.value;
+									}
+									shape.push_back(dim_value);
+								}
+							}
+						}
+					}
+					return shape;
+				}
+				return {};
+			}
+
+			std::string forward(cv::dnn::Net& net, const cv::Mat& blob, cv::Mat& output) {
+				try {
+					net.setInput(blob);
+					// The output is copied, as the next forward pass of the network reuses its memory
+					output = net.forward().clone();
+				}
+				catch (const cv::Exception& e) {
+					return e.what();
+				}
+				return "";
+			}
+		}
+
+		std::string ML_Model::load(const std::string& filename) {
+			std::ifstream file(filename, std::ios::binary | std::ios::ate);
+			if (!file)
+				return "Could not open the model '" + filename + "'";
+			std::vector<char> buffer((size_t)file.tellg());
+			file.seekg(0);
+			if (!file.read(buffer.data(), (std::streamsize)buffer.size()))
+				return "Could not read the model '" + filename + "'";
+
+			// The first network checks that the model can be used
+			cv::dnn::Net net;
+			try {
+				net = cv::dnn::readNetFromONNX(buffer.data(), buffer.size());
+				net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+				net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+			}
+			catch (const cv::Exception& e) {
+				return "Could not load the model '" + filename + "': " + e.what();
+			}
+
+			// The size of the images is the one of the network (NCHW or NHWC with a single channel), the size
+			// given to the constructor is only used if the network accepts any size
+			int input_size = input_size_;
+			bool channels_last = false;
+			std::vector<int64_t> shape = onnx_input_shape(buffer);
+			if (shape.size() == 4) {
+				if (shape[1] > 1 && shape[3] > 1)
+					return "The model '" + filename + "' must take a batch of images with one channel";
+				channels_last = shape[3] == 1 && shape[1] != 1;
+				int64_t height = channels_last ? shape[1] : shape[2];
+				int64_t width = channels_last ? shape[2] : shape[3];
+				if (height > 0 && width > 0 && height != width)
+					return "The model '" + filename + "' must take square images";
+				if (height > 0)
+					input_size = (int)height;
+				else if (width > 0)
+					input_size = (int)width;
+			}
+			else if (!shape.empty()) {
+				return "The model '" + filename + "' must take a batch of images with one channel";
+			}
+
+			std::lock_guard<std::mutex> lock(mutex_);
+			input_size_ = input_size;
+			channels_last_ = channels_last;
+			buffer_ = std::move(buffer);
+			free_nets_.clear();
+			free_nets_.push_back(net);
+			return "";
+		}
+
+		bool ML_Model::isLoaded() {
+			std::lock_guard<std::mutex> lock(mutex_);
+			return !buffer_.empty();
+		}
+
+		std::string ML_Model::acquire_net(cv::dnn::Net& net) {
+			std::vector<char> buffer;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (buffer_.empty())
+					return "The model '" + name_ + "' has not been loaded";
+				if (!free_nets_.empty()) {
+					net = free_nets_.back();
+					free_nets_.pop_back();
+					return "";
+				}
+				buffer = buffer_;
+			}
+			// Each thread that predicts at the same time needs its own network
+			try {
+				net = cv::dnn::readNetFromONNX(buffer.data(), buffer.size());
+				net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+				net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+			}
+			catch (const cv::Exception& e) {
+				return e.what();
+			}
+			return "";
+		}
+
+		void ML_Model::release_net(cv::dnn::Net& net) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			free_nets_.push_back(net);
+		}
+
+		std::string ML_Model::predict(const cv::Mat& image, cv::Mat& prediction) {
+			std::vector<cv::Mat> predictions;
+			std::string error = predict(std::vector<cv::Mat>{ image }, predictions);
+			if (error.empty())
+				prediction = predictions[0];
+			return error;
+		}
+
+		std::string ML_Model::predict(const std::vector<cv::Mat>& images, std::vector<cv::Mat>& predictions) {
+			predictions.clear();
+			if (images.empty())
+				return "";
+			for (auto& image : images) {
+				if (image.empty() || image.type() != CV_16S)
+					return "The image to predict must be in HU values (CV_16S)";
+			}
+
+			// The images are windowed and resized directly in the input of the network. With a single channel, the
+			// memory of an NCHW blob is the one of an NHWC blob, only the shape given to the network differs.
+			const int plane_size = input_size_ * input_size_;
+			const int dims[] = { (int)images.size(), channels_last_ ? input_size_ : 1, input_size_,
+			                     channels_last_ ? 1 : input_size_ };
+			cv::Mat blob(4, dims, CV_32F);
+			cv::Mat windowed;
+			for (size_t i = 0; i < images.size(); i++) {
+				cv::Mat plane(input_size_, input_size_, CV_32F, blob.ptr<float>() + i * plane_size);
+				if (images[i].size() == plane.size()) {
+					window_image(images[i], (float)wc_, (float)ww_, plane);
+				}
+				else {
+					window_image(images[i], (float)wc_, (float)ww_, windowed);
+					cv::resize(windowed, plane, plane.size(), 0, 0, cv::INTER_AREA);
+				}
+			}
+
+			cv::dnn::Net net;
+			std::string error = acquire_net(net);
+			if (!error.empty())
+				return error;
+			cv::Mat output;
+			std::string forward_error;
+			if (images.size() == 1 || batch_supported_)
+				forward_error = forward(net, blob, output);
+			if (images.size() > 1 && (!batch_supported_ || !forward_error.empty())) {
+				// Networks exported with a fixed batch size of 1 predict the images one by one
+				batch_supported_ = false;
+				output.create(4, dims, CV_32F);
+				forward_error.clear();
+				for (size_t i = 0; i < images.size() && forward_error.empty(); i++) {
+					const int plane_dims[] = { 1, dims[1], dims[2], dims[3] };
+					cv::Mat plane(4, plane_dims, CV_32F, blob.ptr<float>() + i * plane_size);
+					cv::Mat plane_output;
+					forward_error = forward(net, plane, plane_output);
+					if (forward_error.empty() && plane_output.total() != (size_t)plane_size)
+						forward_error = "The output of the model '" + name_ + "' does not have the size of its input";
+					else if (forward_error.empty())
+						memcpy(output.ptr<float>() + i * plane_size, plane_output.ptr<float>(), plane_size * sizeof(float));
+				}
+			}
+			release_net(net);
+			if (!forward_error.empty())
+				return forward_error;
+
+			// The output is one probability per pixel (NCHW or NHWC with a single channel)
+			if (output.total() != images.size() * plane_size)
+				return "The output of the model '" + name_ + "' does not have the size of its input";
+			predictions.resize(images.size());
+			cv::Mat probabilities;
+			for (size_t i = 0; i < images.size(); i++) {
+				cv::Mat plane(input_size_, input_size_, CV_32F, output.ptr<float>() + i * plane_size);
+				cv::resize(plane, probabilities, images[i].size(), 0, 0, cv::INTER_LINEAR);
+				cv::threshold(probabilities, probabilities, 0.5, 1., cv::THRESH_BINARY);
+				probabilities.convertTo(predictions[i], CV_8U);
+			}
+			return "";
+		}
+
+		std::string ML_Model::predict(const cv::Mat& image, Mask& prediction) {
+			std::string error = predict(image, prediction.getData());
+			if (error.empty()) {
+				prediction.setState(Mask::MASK_PREDICTION);
+				prediction.setNotEmpty();
+				prediction.updateDimensions();
+			}
+			return error;
 		}
 	}
 }
@@ -1,11 +1,23 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
 
-//#include <torch/torch.h>
+#include "opencv2/opencv.hpp"
+#include "opencv2/dnn.hpp"
 
 namespace core {
 	namespace segmentation {
+		class Mask;
+
+		/**
+		 * Segmentation network, run on the CPU with the dnn module of OpenCV
+		 *
+		 * The network is an ONNX export of the model (e.g. with tf2onnx), which takes a batch of windowed images
+		 * (values in [0, 1]) of size input_size x input_size and returns the probability of each pixel.
+		 */
 		class ML_Model {
 		private:
 			std::string name_;
@@ -13,8 +25,57 @@ namespace core {
 			int wc_ = 40;
 
 			int input_size_ = 256;
+			// Set if the network takes NHWC images (e.g. TensorFlow export without --inputs-as-nchw)
+			bool channels_last_ = false;
+
+			// The networks cannot run two predictions at once, each thread that predicts takes one from the pool
+			std::vector<char> buffer_;
+			std::vector<cv::dnn::Net> free_nets_;
+			std::mutex mutex_;
+
+			// Cleared if the network only accepts one image per forward pass
+			std::atomic<bool> batch_supported_{true};
+
+			std::string acquire_net(cv::dnn::Net& net);
+			void release_net(cv::dnn::Net& net);
 		public:
+			/**
+			 * @param ww, wc windowing of the images given to the network
+			 * @param input_size size of the images if the network accepts any size, otherwise the size of its input
+			 * is used (see load)
+			 */
 			ML_Model(const std::string& name, int ww, int wc, int input_size);
+
+			/**
+			 * Loads the network from an ONNX file, input_size is set to the size of the input of the network if it
+			 * is fixed
+			 * @return error message
+			 */
+			std::string load(const std::string& filename);
+
+			bool isLoaded();
+
+			/**
+			 * Predicts the mask of an image, can be called from any thread
+			 * @param image HU values of the image (CV_16S)
+			 * @param prediction mask of the same size as the image (CV_8U, 0 or 1)
+			 * @return error message
+			 */
+			std::string predict(const cv::Mat& image, cv::Mat& prediction);
+			std::string predict(const cv::Mat& image, Mask& prediction);
+
+			/**
+			 * Predicts the masks of several images with one forward pass of the network
+			 *
+			 * The images do not need to have the same size, each prediction has the size of its image.
+			 * @return error message
+			 */
+			std::string predict(const std::vector<cv::Mat>& images, std::vector<cv::Mat>& predictions);
+
+			const std::string& getName() const { return name_; }
+			int getWW() const { return ww_; }
+			int getWC() const { return wc_; }
+			int getInputSize() const { return input_size_; }
 		};
 	}
-}
\ No newline at end of file
+}
@@ -1,4 +1,7 @@
 #include "segmentation.h"
+
+#include <filesystem>
+
 #include "python/py_api.h"
 #include "pybind11/pybind11.h"
 
@@ -15,7 +18,8 @@ namespace core {
 		}
 
 		std::shared_ptr<MaskCollection> Segmentation::getMask(std::shared_ptr<DicomSeries> dicom) {
-			addDicom(dicom);
+			if (dicom->size() > 0)
+				addDicom(dicom);
 			return segmentations_[dicom];
 		}
 
@@ -38,27 +42,24 @@ namespace core {
 		}
 
 		std::string Segmentation::getMaskBasename(std::shared_ptr<DicomSeries> dicom) {
-			std::string id = dicom->getId();
-			std::string name;
-			auto state = PyGILState_Ensure();
-			try {
-				auto script = py::module::import("python.scripts.segmentation");
-				name = script.attr("get_mask_path")(id, filename_, stripped_name_).cast<std::string>();
-			}
-			catch (const std::exception& e) {
-				std::cout << e.what() << std::endl;
-				name = "";
-			}
-			PyGILState_Release(state);
-			return name;
+			// Same as get_mask_path in segmentation.py, the .seg file is in the models directory of the project
+			if (filename_.empty())
+				return "";
+			std::filesystem::path root = std::filesystem::path(filename_).parent_path().parent_path();
+			return (root / "data" / "masks" / stripped_name_ / dicom->getId()).string();
+		}
+
+		std::string Segmentation::getModelFilename() {
+			if (filename_.empty())
+				return "";
+			return (std::filesystem::path(filename_).parent_path() / (stripped_name_ + ".onnx")).string();
 		}
 
 		void Segmentation::addDicom(std::shared_ptr<DicomSeries> dicom) {
+			// Does not check the images of the series, so that their paths are not read when loading the project
 			if (segmentations_.find(dicom) == segmentations_.end()) {
-				if (dicom->size() > 0) {
-					segmentations_[dicom] = std::make_shared<MaskCollection>();
-					segmentations_[dicom]->setBasenamePath(getMaskBasename(dicom));
-				}
+				segmentations_[dicom] = std::make_shared<MaskCollection>();
+				segmentations_[dicom]->setBasenamePath(getMaskBasename(dicom));
 			}
 		}
 
@@ -14,6 +14,17 @@
 namespace core {
 	namespace segmentation {
 
+		/**
+		 * Parameters of the model of a segmentation, saved in the [model] table of its .seg file
+		 */
+		struct ModelConfig {
+			// Windowing of the images given to the network
+			int ww = 400;
+			int wc = 40;
+			// Size of the images if the network accepts any size (see ML_Model)
+			int input_size = 256;
+		};
+
 		class Segmentation {
 		private:
 			std::string name_;
@@ -24,6 +35,7 @@ namespace core {
 
 			std::map<std::shared_ptr<DicomSeries>, std::shared_ptr<MaskCollection>> segmentations_;
 			std::vector<std::shared_ptr<ML_Model>> models_;
+			ModelConfig model_config_;
 		public:
 			Segmentation(const std::string& name, const std::string& description, ImVec4 color = { 1.f, 0.f, 0.f, 0.5f });
 			Segmentation() = default;
@@ -48,6 +60,8 @@ namespace core {
 
 			void addModel(std::shared_ptr<ML_Model> model) { models_.push_back(model); }
 			std::vector<std::shared_ptr<ML_Model>>& getModels() { return models_; }
+			ModelConfig& getModelConfig() { return model_config_; }
+			void setModelConfig(const ModelConfig& config) { model_config_ = config; }
 
 			/**
 			 * Unload from memory all masks that may be present
@@ -68,6 +82,11 @@ namespace core {
 
 			std::string getMaskBasename(std::shared_ptr<DicomSeries> dicom);
 
+			/**
+			 * Returns the path of the ONNX model of the segmentation (models/<stripped name>.onnx)
+			*/
+			std::string getModelFilename();
+
 			void addDicom(std::shared_ptr<DicomSeries> dicom);
 
 			//void addDicom(std::shared_ptr<DicomSeries> dicom, MaskCollection masks);
@@ -0,0 +1,205 @@
+#include "stroke.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace core {
+    namespace segmentation {
+
+        void StrokeEngine::begin(int rows, int cols) {
+            rows_ = rows;
+            cols_ = cols;
+            // clear() keeps the capacity of the buffers
+            spans_.clear();
+            min_row_ = rows;
+            max_row_ = -1;
+            min_col_ = cols;
+            max_col_ = -1;
+        }
+
+        void StrokeEngine::add_span(int row, int col_start, int col_end) {
+            if (row < 0 || row >= rows_)
+                return;
+            col_start = std::max(col_start, 0);
+            col_end = std::min(col_end, cols_ - 1);
+            if (col_start > col_end)
+                return;
+
+            spans_.push_back({row, col_start, col_end});
+            min_row_ = std::min(min_row_, row);
+            max_row_ = std::max(max_row_, row);
+            min_col_ = std::min(min_col_, col_start);
+            max_col_ = std::max(max_col_, col_end);
+        }
+
+        void StrokeEngine::addDab(float x, float y, float radius) {
+            int center_col = (int) x;
+            int center_row = (int) y;
+            int int_radius = (int) radius;
+            if (int_radius < 0)
+                return;
+
+            for (int dy = -int_radius; dy <= int_radius; dy++) {
+                auto half_width = (int) std::sqrt((float) (int_radius * int_radius - dy * dy));
+                add_span(center_row + dy, center_col - half_width, center_col + half_width);
+            }
+        }
+
+        void StrokeEngine::addPolygon(const std::vector<cv::Point> &points) {
+            if (points.size() < 3)
+                return;
+
+            int top = points[0].y;
+            int bottom = points[0].y;
+            for (auto &point: points) {
+                top = std::min(top, point.y);
+                bottom = std::max(bottom, point.y);
+            }
+            top = std::max(top, 0);
+            bottom = std::min(bottom, rows_ - 1);
+
+            for (int row = top; row <= bottom; row++) {
+                crossings_.clear();
+                for (size_t i = 0; i < points.size(); i++) {
+                    const cv::Point &a = points[i];
+                    const cv::Point &b = points[(i + 1) % points.size()];
+                    // Half open interval so that shared vertices are only counted once
+                    if ((a.y <= row && row < b.y) || (b.y <= row && row < a.y)) {
+                        crossings_.push_back(a.x + (float) (row - a.y) * (float) (b.x - a.x) / (float) (b.y - a.y));
+                    }
+                }
+                std::sort(crossings_.begin(), crossings_.end());
+                for (size_t i = 0; i + 1 < crossings_.size(); i += 2) {
+                    add_span(row, (int) std::lround(crossings_[i]), (int) std::lround(crossings_[i + 1]));
+                }
+            }
+        }
+
+        bool StrokeEngine::addFloodFill(const Mask &mask, const Mask *edition_limit, int x, int y) {
+            const cv::Mat &data = mask.getData();
+            if (data.rows != rows_ || data.cols != cols_ || x < 0 || y < 0 || x >= cols_ || y >= rows_)
+                return false;
+
+            const cv::Mat *limit = nullptr;
+            if (edition_limit != nullptr && edition_limit->getData().size() == data.size())
+                limit = &edition_limit->getData();
+
+            auto state = [&](int row, int col) -> int {
+                int value = data.ptr<uchar>(row)[col] != 0;
+                if (limit != nullptr)
+                    value |= (limit->ptr<uchar>(row)[col] != 0) << 1;
+                return value;
+            };
+
+            if (visited_.size() != (size_t) rows_ * cols_)
+                visited_.assign((size_t) rows_ * cols_, 0);
+
+            const int seed_state = state(y, x);
+            auto fillable = [&](int row, int col) {
+                return !visited_[(size_t) row * cols_ + col] && state(row, col) == seed_state;
+            };
+
+            const size_t first_span = spans_.size();
+            seeds_.clear();
+            seeds_.emplace_back(x, y);
+            while (!seeds_.empty()) {
+                cv::Point seed = seeds_.back();
+                seeds_.pop_back();
+                int row = seed.y;
+                if (!fillable(row, seed.x))
+                    continue;
+
+                // Extend the seed to the whole run of the row
+                int left = seed.x;
+                int right = seed.x;
+                while (left > 0 && fillable(row, left - 1))
+                    left--;
+                while (right < cols_ - 1 && fillable(row, right + 1))
+                    right++;
+
+                std::fill(visited_.begin() + (size_t) row * cols_ + left,
+                          visited_.begin() + (size_t) row * cols_ + right + 1, 1);
+                add_span(row, left, right);
+
+                // One seed per run of fillable pixels in the rows above and below
+                for (int next_row: {row - 1, row + 1}) {
+                    if (next_row < 0 || next_row >= rows_)
+                        continue;
+                    bool in_run = false;
+                    for (int col = left; col <= right; col++) {
+                        if (fillable(next_row, col)) {
+                            if (!in_run)
+                                seeds_.emplace_back(col, next_row);
+                            in_run = true;
+                        } else {
+                            in_run = false;
+                        }
+                    }
+                }
+            }
+
+            // Only clear what has been visited, so that the next fill does not pay for the whole image
+            for (size_t i = first_span; i < spans_.size(); i++) {
+                auto &span = spans_[i];
+                std::fill(visited_.begin() + (size_t) span.row * cols_ + span.col_start,
+                          visited_.begin() + (size_t) span.row * cols_ + span.col_end + 1, 0);
+            }
+            return true;
+        }
+
+        cv::Rect StrokeEngine::getBounds() const {
+            if (max_row_ < 0)
+                return cv::Rect();
+            return cv::Rect(min_col_, min_row_, max_col_ - min_col_ + 1, max_row_ - min_row_ + 1);
+        }
+
+        bool StrokeEngine::apply(Mask &target, const Mask *edition_limit, bool add, bool remove,
+                                 bool only_if_limitation_used) const {
+            cv::Mat &data = target.getData();
+            if (data.rows != rows_ || data.cols != cols_ || spans_.empty())
+                return false;
+
+            const cv::Mat *limit = nullptr;
+            if (edition_limit != nullptr && edition_limit->getData().size() == data.size())
+                limit = &edition_limit->getData();
+
+            if (only_if_limitation_used) {
+                // The limitation is used if the stroke covers both sides of the limit
+                bool touches_inside = false;
+                bool touches_outside = false;
+                if (limit != nullptr) {
+                    for (auto &span: spans_) {
+                        const uchar *limit_row = limit->ptr<uchar>(span.row);
+                        for (int col = span.col_start; col <= span.col_end; col++) {
+                            if (limit_row[col])
+                                touches_inside = true;
+                            else
+                                touches_outside = true;
+                        }
+                    }
+                }
+                add = add && touches_outside;
+                remove = remove && touches_inside;
+            }
+
+            bool changed = false;
+            for (auto &span: spans_) {
+                uchar *data_row = data.ptr<uchar>(span.row);
+                const uchar *limit_row = limit != nullptr ? limit->ptr<uchar>(span.row) : nullptr;
+                for (int col = span.col_start; col <= span.col_end; col++) {
+                    bool inside_limit = limit_row == nullptr || limit_row[col];
+                    if (add && inside_limit && data_row[col] != 1) {
+                        data_row[col] = 1;
+                        changed = true;
+                    }
+                    bool outside_limit = limit_row == nullptr || !limit_row[col];
+                    if (remove && outside_limit && data_row[col] != 0) {
+                        data_row[col] = 0;
+                        changed = true;
+                    }
+                }
+            }
+            return changed;
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+#include "mask.h"
+
+namespace core {
+    namespace segmentation {
+
+        /**
+         * Horizontal run of pixels, from col_start to col_end (both included)
+         */
+        struct Span {
+            int row;
+            int col_start;
+            int col_end;
+        };
+
+        /**
+         * Rasterizes brush dabs and lasso polygons into a list of spans instead of full size masks
+         *
+         * The span buffer is kept between strokes, so once it has grown to the size of a typical stroke,
+         * a stroke does not allocate anything and only touches the pixels under the brush.
+         */
+        class StrokeEngine {
+        private:
+            int rows_ = 0;
+            int cols_ = 0;
+
+            std::vector<Span> spans_;
+            std::vector<float> crossings_;
+
+            // Scratch buffers of the flood fill, visited_ is all zeros between two fills
+            std::vector<uchar> visited_;
+            std::vector<cv::Point> seeds_;
+
+            int min_row_ = 0;
+            int max_row_ = -1;
+            int min_col_ = 0;
+            int max_col_ = -1;
+
+            void add_span(int row, int col_start, int col_end);
+
+        public:
+            StrokeEngine() = default;
+
+            /**
+             * Starts a new stroke on an image of the given size, previous spans are forgotten
+             */
+            void begin(int rows, int cols);
+
+            /**
+             * Adds a filled disk, rasterized like cv::circle (center and radius are truncated to integers)
+             * @param x column of the center
+             * @param y row of the center
+             */
+            void addDab(float x, float y, float radius);
+
+            /**
+             * Adds a filled polygon (even-odd rule)
+             */
+            void addPolygon(const std::vector<cv::Point> &points);
+
+            /**
+             * Adds the 4-connected region around (x, y) whose pixels have the same state as the seed, where the
+             * state of a pixel is the pair (mask value, edition limit value). This is the region that
+             * cv::floodFill finds on the mask combined with the limit, but nothing is copied: the masks are
+             * read directly and the cost only depends on the size of the region.
+             * The limit is ignored if it is null or does not have the size of the mask.
+             * @return false if the seed is outside of the image
+             */
+            bool addFloodFill(const Mask &mask, const Mask *edition_limit, int x, int y);
+
+            const std::vector<Span> &getSpans() const { return spans_; }
+
+            /**
+             * @return bounding box of the stroke (empty if nothing was drawn)
+             */
+            cv::Rect getBounds() const;
+
+            bool empty() const { return spans_.empty(); }
+
+            /**
+             * Edits the target with the area covered by the stroke, same behaviour as editMaskArea
+             * @return true if the target has been modified
+             */
+            bool apply(Mask &target, const Mask *edition_limit, bool add, bool remove,
+                       bool only_if_limitation_used = false) const;
+        };
+    }
+}
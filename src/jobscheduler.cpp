@@ -4,8 +4,10 @@
 #include <mutex>
 #include <condition_variable>
 #include <chrono>
+#include <thread>
 
 #include "log.h"
+#include "profiler.h"
 
 jobResultFct JobScheduler::no_op_fct = [] (const std::shared_ptr<JobResult>&) {};
 
@@ -93,10 +95,13 @@ void JobScheduler::worker_fct(JobScheduler::Worker &worker) {
 
 
         if(execute_job) {
+            auto start = Profiler::Clock::now();
+            Profiler::getInstance().addTime("jobs/" + current_job->name + "/wait", current_job->queued_time, start, false);
             // Execute job
             try {
                 worker.state = WORKER_STATE_WORKING;
                 auto result = current_job->fct(current_job->progress, current_job->abort);
+                Profiler::getInstance().addTime("jobs/" + current_job->name + "/run", start, Profiler::Clock::now());
                 {
                     std::lock_guard<std::recursive_mutex> guard(jobs_mutex_);
                     if (current_job->abort) {
@@ -135,6 +140,7 @@ std::shared_ptr<Job> & JobScheduler::addJob(std::string name, jobFct &function,
     job.fct = function;
     job.priority = priority;
     job.result_fct = result_fct;
+    job.queued_time = std::chrono::steady_clock::now();
 
     std::lock_guard<std::recursive_mutex> guard(jobs_mutex_);
     jobs_list_.emplace_back(std::make_shared<Job>(job));
@@ -158,13 +164,90 @@ bool JobScheduler::stopJob(jobId jobId) {
     return true;
 }
 
+void JobScheduler::parallelRun(const std::string &name, int num_helpers, const std::function<void(bool &)> &function,
+                               bool &abort, Job::jobPriority priority) {
+    struct SharedState {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool finished = false;
+        int running = 0;
+    };
+    auto state = std::make_shared<SharedState>();
+    bool *caller_abort = &abort;
+
+    jobFct helper = [state, function, caller_abort](float &, bool &) -> std::shared_ptr<JobResult> {
+        auto result = std::make_shared<JobResult>();
+        {
+            std::lock_guard<std::mutex> guard(state->mutex);
+            // The caller has already returned, the abort flag may not exist anymore
+            if (state->finished)
+                return result;
+            state->running++;
+        }
+        try {
+            function(*caller_abort);
+            result->success = true;
+        }
+        catch (std::exception &e) {
+            BM_DEBUG(e.what());
+        }
+        {
+            std::lock_guard<std::mutex> guard(state->mutex);
+            state->running--;
+        }
+        state->cv.notify_all();
+        return result;
+    };
+
+    for (int i = 0; i < num_helpers; i++) {
+        addJob(name, helper, no_op_fct, priority);
+    }
+
+    auto wait_for_helpers = [&state]() {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished = true;
+        state->cv.wait(lock, [&state]() { return state->running == 0; });
+    };
+    try {
+        function(abort);
+    }
+    catch (...) {
+        wait_for_helpers();
+        throw;
+    }
+    wait_for_helpers();
+}
+
 void JobScheduler::clean() {
-    for(auto &worker : workers_) {
-        if(worker.state == WORKER_STATE_KILLED) {
-            worker.thread->join();
-            delete worker.thread;
+    std::lock_guard<std::mutex> guard(kill_mutex_);
+    for(auto it = workers_.begin(); it != workers_.end();) {
+        if(it->state == WORKER_STATE_KILLED) {
+            it->thread->join();
+            delete it->thread;
+            it = workers_.erase(it);
         }
+        else {
+            ++it;
+        }
+    }
+}
+
+JobScheduler::~JobScheduler() {
+    abortAll();
+
+    // The workers must be stopped before the semaphore they wait on is destroyed
+    {
+        std::lock_guard<std::mutex> guard(kill_mutex_);
+        kill_x_workers_ += num_active_workers_;
+        for (int i = 0; i < num_active_workers_; i++)
+            semaphore_.post();
+        num_active_workers_ = 0;
     }
+    for (auto &worker : workers_) {
+        worker.thread->join();
+        delete worker.thread;
+    }
+    workers_.clear();
 }
 
 
@@ -237,3 +320,24 @@ void JobScheduler::finalizeJobs() {
     finalize_jobs_list_.clear();
 }
 
+bool JobScheduler::runUntil(const std::function<bool()> &done, double timeout_s, const std::function<void()> &report) {
+    auto now = std::chrono::steady_clock::now();
+    auto deadline = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(timeout_s));
+    auto last_report = now;
+    while (true) {
+        finalizeJobs();
+        event_queue_.pollEvents();
+        if (done())
+            return true;
+        now = std::chrono::steady_clock::now();
+        if (now > deadline)
+            return false;
+        if (report && now - last_report > std::chrono::seconds(1)) {
+            report();
+            last_report = now;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
+
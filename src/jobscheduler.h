@@ -10,6 +10,7 @@
 #include <functional>
 #include <condition_variable>
 #include <utility>
+#include <chrono>
 
 #include "events.h"
 
@@ -83,6 +84,8 @@ struct Job {
     jobState state = JOB_STATE_PENDING;
     jobPriority priority = JOB_PRIORITY_NORMAL;
     float progress = 0.f;
+    // Time at which the job has been added, to measure how long it waited in the queue
+    std::chrono::steady_clock::time_point queued_time;
 
     std::exception exception;
     bool abort = false;
@@ -273,8 +276,35 @@ public:
      */
     bool stopJob(jobId jobId);
 
+    /**
+     * Runs the same function on the calling thread and on (at most) num_helpers additional jobs
+     *
+     * The function should pull its work from a shared queue and return once the queue is exhausted, as there is
+     * no guarantee that the helpers start before the caller has finished : helpers that start once the caller
+     * has returned from the function do nothing. The call returns once the caller and all the helpers that
+     * actually started have returned. It is meant to be called from a job, to spread its work on the idle workers.
+     *
+     * @param name name of the helper jobs
+     * @param num_helpers number of helper jobs to launch
+     * @param function work function, receives the abort flag of the caller
+     * @param abort abort flag of the caller, must outlive the call
+     */
+    void parallelRun(const std::string &name, int num_helpers, const std::function<void(bool &)> &function,
+                     bool &abort, Job::jobPriority priority = Job::JOB_PRIORITY_NORMAL);
+
     void finalizeJobs();
 
+    /**
+     * Runs the results of the jobs and the events, as the main loop of the app, until done returns true
+     *
+     * For the programs without a window (command line, harness), which wait for their jobs on the main thread.
+     * @param timeout_s maximum waiting time in seconds
+     * @param report called about once per second while waiting, can be empty
+     * @return false if the timeout has been reached
+     */
+    bool runUntil(const std::function<bool()> &done, double timeout_s = 24 * 3600,
+                  const std::function<void()> &report = nullptr);
+
     /**
      * Get the information about a certain job at a given time (copy of the job)
      *
@@ -320,8 +350,5 @@ public:
      */
     void clean();
 
-    ~JobScheduler() {
-        abortAll();
-        clean();
-    }
+    ~JobScheduler();
 };
@@ -0,0 +1,157 @@
+#include "profiler.h"
+
+#include <fstream>
+#include <algorithm>
+
+std::string escapeJson(const std::string& str) {
+    std::string escaped;
+    for (char c : str) {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        if ((unsigned char)c >= 0x20)
+            escaped += c;
+    }
+    return escaped;
+}
+
+uint32_t Profiler::thread_index() {
+    auto it = threads_.find(std::this_thread::get_id());
+    if (it == threads_.end())
+        it = threads_.emplace(std::this_thread::get_id(), (uint32_t)threads_.size()).first;
+    return it->second;
+}
+
+void Profiler::addTime(const std::string& name, Clock::time_point start, Clock::time_point end, bool trace) {
+    double duration_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& stats = timers_[name];
+    stats.count++;
+    stats.total_ms += duration_ms;
+    stats.max_ms = std::max(stats.max_ms, duration_ms);
+    stats.last_ms = duration_ms;
+
+    if (trace && tracing_) {
+        if (trace_.size() >= MAX_TRACE_EVENTS) {
+            tracing_ = false;
+            return;
+        }
+        trace_.push_back(TraceEvent{
+                name, 'X',
+                std::chrono::duration_cast<std::chrono::microseconds>(start - origin_).count(),
+                std::chrono::duration_cast<std::chrono::microseconds>(end - start).count(),
+                0, thread_index()});
+    }
+}
+
+void Profiler::addCount(const std::string& name, int64_t value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& counter = counters_[name];
+    counter += value;
+
+    if (tracing_) {
+        if (trace_.size() >= MAX_TRACE_EVENTS) {
+            tracing_ = false;
+            return;
+        }
+        trace_.push_back(TraceEvent{
+                name, 'C',
+                std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - origin_).count(),
+                0, counter, thread_index()});
+    }
+}
+
+void Profiler::addFrame(Clock::time_point start, Clock::time_point end) {
+    addTime("frame", start, end);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    main_thread_ = std::this_thread::get_id();
+    float duration_ms = std::chrono::duration<float, std::milli>(end - start).count();
+    if (frame_times_.size() < FRAME_HISTORY) {
+        frame_times_.push_back(duration_ms);
+    }
+    else {
+        frame_times_[frame_index_] = duration_ms;
+        frame_index_ = (frame_index_ + 1) % FRAME_HISTORY;
+    }
+}
+
+std::map<std::string, TimerStats> Profiler::getTimers() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return timers_;
+}
+
+std::map<std::string, int64_t> Profiler::getCounters() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return counters_;
+}
+
+std::vector<float> Profiler::getFrameTimes() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<float> frame_times(frame_times_.begin() + frame_index_, frame_times_.end());
+    frame_times.insert(frame_times.end(), frame_times_.begin(), frame_times_.begin() + frame_index_);
+    return frame_times;
+}
+
+void Profiler::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    timers_.clear();
+    counters_.clear();
+    frame_times_.clear();
+    frame_index_ = 0;
+}
+
+void Profiler::startTrace() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    trace_.clear();
+    tracing_ = true;
+}
+
+void Profiler::stopTrace() {
+    tracing_ = false;
+}
+
+size_t Profiler::getTraceSize() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return trace_.size();
+}
+
+std::string Profiler::exportTrace(const std::string& filename) {
+    std::vector<TraceEvent> trace;
+    std::map<std::thread::id, uint32_t> threads;
+    std::thread::id main_thread;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        trace = trace_;
+        threads = threads_;
+        main_thread = main_thread_;
+    }
+
+    std::ofstream file(filename, std::ios::trunc);
+    if (!file)
+        return "Could not open '" + filename + "'";
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (auto& thread : threads) {
+        file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.second
+             << ",\"args\":{\"name\":\"" << (thread.first == main_thread ? "main" : "thread " + std::to_string(thread.second))
+             << "\"}}";
+        first = false;
+    }
+    for (auto& event : trace) {
+        file << (first ? "" : ",") << "\n{\"name\":\"" << escapeJson(event.name) << "\",\"ph\":\"" << event.phase
+             << "\",\"pid\":1,\"tid\":" << event.thread << ",\"ts\":" << event.start_us;
+        if (event.phase == 'X')
+            file << ",\"dur\":" << event.duration_us;
+        else
+            file << ",\"args\":{\"value\":" << event.value << "}";
+        file << "}";
+        first = false;
+    }
+    file << "\n]}\n";
+
+    if (!file)
+        return "Could not write '" + filename + "'";
+    return "";
+}
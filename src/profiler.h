@@ -0,0 +1,155 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+/**
+ * Statistics of a timer of the Profiler
+ */
+struct TimerStats {
+    uint64_t count = 0;
+    double total_ms = 0.;
+    double max_ms = 0.;
+    double last_ms = 0.;
+};
+
+/**
+ * @brief Always-on instrumentation of the app : scoped timers, counters and frame times
+ *
+ * The timers and counters are accumulated by name (e.g. "jobs/dicom_to_image/run") from any thread, and can be
+ * shown in the Performance window. While a trace is recorded, each measure is also kept as a trace event, which
+ * can be exported in the Chrome trace-event format (chrome://tracing, Perfetto).
+ *
+ * Example:
+ * \code{.cpp}
+ * void decode() {
+ *     BM_PROFILE_SCOPE("dicom/decode");
+ *     ...
+ *     BM_PROFILE_COUNT("image/texture_upload_bytes", width * height * 4);
+ * }
+ * \endcode
+ */
+class Profiler {
+public:
+    typedef std::chrono::steady_clock Clock;
+private:
+    struct TraceEvent {
+        std::string name;
+        // 'X' for a duration, 'C' for a counter
+        char phase;
+        int64_t start_us;
+        int64_t duration_us;
+        int64_t value;
+        uint32_t thread;
+    };
+
+    // Maximum number of events of a trace, the trace stops once it is full
+    static constexpr size_t MAX_TRACE_EVENTS = 1000000;
+    static constexpr size_t FRAME_HISTORY = 256;
+
+    Clock::time_point origin_ = Clock::now();
+
+    std::mutex mutex_;
+    std::map<std::string, TimerStats> timers_;
+    std::map<std::string, int64_t> counters_;
+    std::vector<float> frame_times_;
+    size_t frame_index_ = 0;
+
+    std::atomic<bool> tracing_{false};
+    std::vector<TraceEvent> trace_;
+    std::map<std::thread::id, uint32_t> threads_;
+    // Thread that draws the frames, named in the trace
+    std::thread::id main_thread_;
+
+    Profiler() = default;
+
+    /**
+     * Should only be called when mutex_ is already hold
+     */
+    uint32_t thread_index();
+public:
+    Profiler(Profiler const &) = delete;
+    void operator=(Profiler const &) = delete;
+
+    /**
+     * @return instance of the Singleton of the Profiler
+     */
+    static Profiler& getInstance() {
+        static Profiler instance;
+        return instance;
+    }
+
+    /**
+     * Adds a measure to a timer
+     * @param trace if not set, the measure is never added to the trace (e.g. time spent waiting in a queue,
+     * which did not happen on the calling thread)
+     */
+    void addTime(const std::string& name, Clock::time_point start, Clock::time_point end, bool trace = true);
+
+    /**
+     * Adds a value to a counter
+     */
+    void addCount(const std::string& name, int64_t value = 1);
+
+    /**
+     * Adds the duration of a frame of the app
+     */
+    void addFrame(Clock::time_point start, Clock::time_point end);
+
+    std::map<std::string, TimerStats> getTimers();
+    std::map<std::string, int64_t> getCounters();
+
+    /**
+     * @return durations of the last frames in ms, from the oldest to the newest
+     */
+    std::vector<float> getFrameTimes();
+
+    /**
+     * Clears the timers, counters and frame times (not the trace)
+     */
+    void reset();
+
+    /**
+     * Starts recording a new trace, the previous one is cleared
+     */
+    void startTrace();
+    void stopTrace();
+    bool isTracing() const { return tracing_; }
+    size_t getTraceSize();
+
+    /**
+     * Writes the recorded trace in the Chrome trace-event JSON format
+     * @return error message if the file could not be written
+     */
+    std::string exportTrace(const std::string& filename);
+};
+
+/**
+ * Escapes a string to be written between the quotes of a JSON string (exports of the Profiler), the control
+ * characters are dropped
+ */
+std::string escapeJson(const std::string& str);
+
+/**
+ * Measures the time spent in a scope (see BM_PROFILE_SCOPE)
+ */
+class ProfileScope {
+private:
+    std::string name_;
+    Profiler::Clock::time_point start_;
+public:
+    explicit ProfileScope(std::string name) : name_(std::move(name)), start_(Profiler::Clock::now()) {}
+    ~ProfileScope() { Profiler::getInstance().addTime(name_, start_, Profiler::Clock::now()); }
+};
+
+#define BM_PROFILE_CONCAT_(a, b) a##b
+#define BM_PROFILE_CONCAT(a, b) BM_PROFILE_CONCAT_(a, b)
+#define BM_PROFILE_SCOPE(name) ProfileScope BM_PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define BM_PROFILE_COUNT(name, value) Profiler::getInstance().addCount((name), (value))
@@ -0,0 +1,119 @@
+#include "executor.h"
+
+#include "profiler.h"
+
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+namespace PyAPI {
+    std::atomic<bool> Executor::running_{false};
+
+    Executor::Executor() {
+        thread_ = std::thread(&Executor::run, this);
+        thread_id_ = thread_.get_id();
+        running_ = true;
+    }
+
+    Executor::~Executor() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        if (thread_.joinable())
+            thread_.join();
+        running_ = false;
+    }
+
+    void Executor::push(std::function<void()> request) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(request));
+            std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+            stats_.max_queue_size = std::max(stats_.max_queue_size, queue_.size());
+        }
+        cv_.notify_one();
+    }
+
+    void Executor::run() {
+        while (true) {
+            std::vector<std::function<void()>> batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+                // The calls that are still queued are executed before stopping
+                if (queue_.empty())
+                    break;
+                while (!queue_.empty() && batch.size() < MAX_BATCH_SIZE) {
+                    batch.push_back(std::move(queue_.front()));
+                    queue_.pop_front();
+                }
+            }
+
+            size_t num_calls = batch.size();
+            auto start = std::chrono::steady_clock::now();
+            auto state = PyGILState_Ensure();
+            for (auto& request : batch) {
+                // Exceptions are stored in the future of the request
+                request();
+            }
+            batch.clear();
+            PyGILState_Release(state);
+            auto end = std::chrono::steady_clock::now();
+            Profiler::getInstance().addTime("python/gil", start, end);
+            Profiler::getInstance().addCount("python/calls", (int64_t)num_calls);
+            double elapsed = std::chrono::duration<double, std::milli>(end - start).count();
+
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.num_calls += num_calls;
+            stats_.num_batches++;
+            stats_.gil_held_ms += elapsed;
+            stats_.max_batch_ms = std::max(stats_.max_batch_ms, elapsed);
+        }
+
+        // The modules must be released with the GIL
+        auto state = PyGILState_Ensure();
+        functions_.reset();
+        modules_.clear();
+        PyGILState_Release(state);
+    }
+
+    py::module& Executor::module(const std::string& name) {
+        auto it = modules_.find(name);
+        if (it == modules_.end())
+            it = modules_.emplace(name, py::module::import(name.c_str())).first;
+        return it->second;
+    }
+
+    const Functions& Executor::functions() {
+        if (functions_ == nullptr) {
+            using namespace py::literals;
+            // Only kept if all the functions could be resolved, so that a failed import is tried again
+            auto functions = std::make_unique<Functions>();
+            functions->numpy_load = module("numpy").attr("load");
+            functions->numpy_load_kwargs = py::dict("allow_pickle"_a = true);
+            functions->load_scan_from_dicom = module("python.scripts.load_dicom").attr("load_scan_from_dicom");
+            functions->load_mask_collection = module("python.scripts.segmentation").attr("load_mask_collection");
+            functions->save_mask_collection = module("python.scripts.segmentation").attr("save_mask_collection");
+            functions->import_dicom = module("python.scripts.import_data").attr("import_dicom");
+            functions_ = std::move(functions);
+        }
+        return *functions_;
+    }
+
+    void Executor::release(PyObject* object) {
+        if (object == nullptr || !running_)
+            return;
+        auto& executor = getInstance();
+        if (std::this_thread::get_id() == executor.thread_id_)
+            Py_DECREF(object);
+        else
+            executor.push([object] { Py_DECREF(object); });
+    }
+
+    ExecutorStats Executor::getStats() {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        return stats_;
+    }
+}
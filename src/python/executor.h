@@ -0,0 +1,162 @@
+#pragma once
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <stdexcept>
+#include <functional>
+#include <type_traits>
+#include <condition_variable>
+
+#include "py_api.h"
+
+namespace PyAPI {
+    /**
+     * Time spent in Python by the Executor
+     */
+    struct ExecutorStats {
+        uint64_t num_calls = 0;
+        uint64_t num_batches = 0;
+        // Time during which the Executor held the GIL
+        double gil_held_ms = 0.;
+        double max_batch_ms = 0.;
+        size_t max_queue_size = 0;
+    };
+
+    /**
+     * Python functions called on the hot paths, resolved once (import and attribute lookup) by the Executor
+     */
+    struct Functions {
+        // numpy.load, with its keyword arguments
+        py::object numpy_load;
+        py::dict numpy_load_kwargs;
+        // python.scripts.load_dicom
+        py::object load_scan_from_dicom;
+        // python.scripts.segmentation
+        py::object load_mask_collection;
+        py::object save_mask_collection;
+        // python.scripts.import_data
+        py::object import_dicom;
+    };
+
+    /**
+     * @brief Thread that owns all the calls to Python
+     *
+     * The calls are queued and executed one after the other on the thread of the Executor, which takes the GIL
+     * once for all the calls that are waiting (a batch), so that no other thread ever waits on the GIL. The
+     * modules are imported once and kept.
+     *
+     * The functions given to the Executor should only return C++ values (no py::object), as the results are
+     * used outside of the GIL. Python exceptions are converted to std::runtime_error.
+     *
+     * Example:
+     * \code{.cpp}
+     * auto& executor = PyAPI::Executor::getInstance();
+     * std::future<size_t> num_users = executor.submit([&] {
+     *     return executor.functions().load_mask_collection(basename)["users"].cast<py::list>().size();
+     * });
+     * \endcode
+     */
+    class Executor {
+    private:
+        // Maximum number of calls executed while holding the GIL
+        static constexpr size_t MAX_BATCH_SIZE = 64;
+
+        std::thread thread_;
+        std::thread::id thread_id_;
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::deque<std::function<void()>> queue_;
+        bool stop_ = false;
+
+        std::mutex stats_mutex_;
+        ExecutorStats stats_;
+
+        // Cleared when the Executor is destroyed, the references released afterwards are leaked
+        static std::atomic<bool> running_;
+
+        // Only used on the thread of the Executor, with the GIL
+        std::map<std::string, py::module> modules_;
+        std::unique_ptr<Functions> functions_;
+
+        Executor();
+
+        void run();
+        void push(std::function<void()> request);
+    public:
+        Executor(Executor const &) = delete;
+        void operator=(Executor const &) = delete;
+
+        ~Executor();
+
+        /**
+         * @return instance of the Singleton of the Executor, the Python interpreter must have been initialized
+         * (see Handler)
+         */
+        static Executor& getInstance() {
+            static Executor instance;
+            return instance;
+        }
+
+        /**
+         * Queues a call to Python
+         * @param fct function executed on the thread of the Executor, with the GIL
+         * @return future of the result of the function
+         */
+        template<typename Fct>
+        auto submit(Fct&& fct) -> std::future<decltype(fct())> {
+            using Result = decltype(fct());
+            auto task = std::make_shared<std::packaged_task<Result()>>(
+                    [fct = std::forward<Fct>(fct)]() mutable -> Result {
+                        try {
+                            return fct();
+                        }
+                        catch (const std::exception& e) {
+                            // The Python exceptions hold Python objects, they must not leave the GIL
+                            throw std::runtime_error(e.what());
+                        }
+                    });
+            auto future = task->get_future();
+            push([task]() { (*task)(); });
+            return future;
+        }
+
+        /**
+         * Calls Python and waits for the result, should not be used on the main thread
+         *
+         * If called from the thread of the Executor (inside another call), the function is executed directly.
+         */
+        template<typename Fct>
+        auto call(Fct&& fct) -> decltype(fct()) {
+            if (std::this_thread::get_id() == thread_id_)
+                return fct();
+            return submit(std::forward<Fct>(fct)).get();
+        }
+
+        /**
+         * @return module imported once, only on the thread of the Executor
+         */
+        py::module& module(const std::string& name);
+
+        /**
+         * Functions of the hot paths, resolved by the first call (see PyAPI::init), only on the thread of the
+         * Executor
+         */
+        const Functions& functions();
+
+        /**
+         * Releases a reference to a Python object from any thread, without waiting for the GIL
+         *
+         * The reference is released directly on the thread of the Executor, otherwise it is queued.
+         */
+        static void release(PyObject* object);
+
+        ExecutorStats getStats();
+    };
+}
@@ -1,4 +1,5 @@
 #include "py_api.h"
+#include "executor.h"
 #include "jobscheduler.h"
 
 
@@ -6,17 +7,18 @@ namespace PyAPI {
     void init() {
         jobFct job = [](float& progress, bool& abort) -> std::shared_ptr<JobResult> {
             auto job_result = std::make_shared<JobResult>();
-            auto state = PyGILState_Ensure();
+            auto& executor = Executor::getInstance();
             try {
-                py::module scripts = py::module::import("python.scripts.__init__");
+                executor.call([&executor] {
+                    executor.module("python.scripts.__init__");
+                    executor.functions();
+                });
                 job_result->success = true;
             }
             catch (const std::exception& e) {
                 job_result->success = false;
             }
 
-            PyGILState_Release(state);
-
             return job_result;
         };
 
@@ -1,12 +1,15 @@
 #include "dataset_view.h"
 #include "log.h"
+#include "settings.h"
 
 #include <algorithm>
+#include <set>
 
 #include "drag_and_drop.h"
 #include "rendering/ui/widgets/util.h"
 #include "views.h"
 #include "rendering/views/project_view.h"
+#include "rendering/ui/modales/error_message.h"
 
 
 namespace py = pybind11;
@@ -20,16 +23,39 @@ Rendering::DatasetView::DatasetView() {
     // Mainly used for changing colors
     reload_seg_.callback = [=](Event_ptr& event) {
         for (auto& preview : dicom_previews_) {
-            preview.second.setSegmentation(active_seg_);
+            preview.second->setSegmentation(active_seg_);
         }
     };
     reload_seg_.filter = "segmentation/reload";
 
+    // The files have been modified on the disk by a batch operation, the masks that are in memory are read again
+    mask_written_.callback = [=](Event_ptr& event) {
+        auto written_event = std::dynamic_pointer_cast<::core::segmentation::MaskWrittenEvent>(event);
+        if (written_event == nullptr)
+            return;
+        auto& masks = written_event->getSegmentation()->getMasks();
+        auto dicom = written_event->getDicom();
+        auto it = masks.find(dicom);
+        if (it != masks.end() && it->second->isSet()) {
+            // Reloaded in the background, the viewers are notified once the new masks are there
+            it->second->unloadData(true);
+            it->second->loadData(false, true, "", [dicom] {
+                EventQueue::getInstance().post(Event_ptr(new Event("mask/changed/" + dicom->getId())));
+            });
+        }
+        else {
+            EventQueue::getInstance().post(Event_ptr(new Event("mask/changed/" + dicom->getId())));
+        }
+    };
+    mask_written_.filter = "mask/written/*";
+
     EventQueue::getInstance().subscribe(&reload_seg_);
+    EventQueue::getInstance().subscribe(&mask_written_);
 }
 
 Rendering::DatasetView::~DatasetView() {
     EventQueue::getInstance().unsubscribe(&reload_seg_);
+    EventQueue::getInstance().unsubscribe(&mask_written_);
 }
 
 void Rendering::DatasetView::ImGuiDraw(GLFWwindow* window, Rect& parent_dimension) {
@@ -37,23 +63,16 @@ void Rendering::DatasetView::ImGuiDraw(GLFWwindow* window, Rect& parent_dimensio
 	ImGui::Begin("Dataset overview");
 
 	if (project != nullptr) {
-        // Set the dicoms and the preview
-        if (project->getDataset().getDicoms().size() != dicoms_.size()) {
-            dicoms_ = project->getDataset().getDicoms();
-            dicom_previews_.clear();
-            for (auto& dicom : dicoms_) {
-                dicom_previews_.emplace(std::move(std::make_pair(dicom, Preview(validated_, edited_))));
-                dicom_sizes_.emplace(std::make_pair(dicom, Rect(ImVec2(-10000, -10000), ImVec2(0, 0))));
-            }
-            for (auto &dic : dicom_previews_) {
-                dic.second.setSeries(dic.first);
-            }
+        // The previews are created when their rows are shown, the ones of the previous dataset are released
+        if (project->getDataset().getDicoms().size() != num_dicoms_) {
+            num_dicoms_ = project->getDataset().getDicoms().size();
+            release_all_previews();
         }
 
         // Interaction for the column viewing
         {
-            if (dicom_previews_.size() < num_cols_ && !dicom_previews_.empty()) {
-                num_cols_ = dicom_previews_.size();
+            if (num_dicoms_ < num_cols_ && num_dicoms_ > 0) {
+                num_cols_ = (int)num_dicoms_;
             }
             ImGui::Text("Num. columns: %d", num_cols_);
             ImGui::SameLine();
@@ -88,14 +107,14 @@ void Rendering::DatasetView::ImGuiDraw(GLFWwindow* window, Rect& parent_dimensio
                         EventQueue::getInstance().post(Event_ptr(new ::core::segmentation::SelectSegmentationEvent(nullptr)));
                         active_seg_ = nullptr;
                         for (auto& preview : dicom_previews_) {
-                            preview.second.setSegmentation(nullptr);
+                            preview.second->setSegmentation(nullptr);
                         }
                     }
                     else {
                         EventQueue::getInstance().post(Event_ptr(new ::core::segmentation::SelectSegmentationEvent(seg_map_.at(idx - 1))));
                         active_seg_ = seg_map_.at(idx - 1);
                         for (auto& preview : dicom_previews_) {
-                            preview.second.setSegmentation(active_seg_);
+                            preview.second->setSegmentation(active_seg_);
                         }
                     }
                 });
@@ -104,35 +123,53 @@ void Rendering::DatasetView::ImGuiDraw(GLFWwindow* window, Rect& parent_dimensio
             seg_select_.ImGuiDraw("Select segmentation");
 
             if (active_seg_ != nullptr) {
-                if (ImGui::Button("Unvalidate all")) {
-                    unvalidate_confirm_prompt = true;
-                }
-                if (unvalidate_confirm_prompt) {
-                    ImGui::SameLine();
-                    ImGui::Text("Are you sure ?");
+                if (batch_job_ != 0 && !JobScheduler::getInstance().getJobInfo(batch_job_).name.empty()) {
+                    // Bulk operation in progress
+                    int num_done = batch_progress_->num_done;
+                    std::string overlay = batch_name_ + ": " + std::to_string(num_done) + " / " + std::to_string(batch_progress_->num_cases);
+                    ImGui::ProgressBar(batch_progress_->num_cases > 0 ? float(num_done) / float(batch_progress_->num_cases) : 1.f,
+                                       ImVec2(300, 0), overlay.c_str());
                     ImGui::SameLine();
-                    if (ImGui::Button("yes")) {
-                        unvalidate_confirm_prompt = false;
-                        for (auto &dicom: dicoms_) {
-                            const std::shared_ptr<core::segmentation::MaskCollection> &mask_collection = active_seg_->getMask(
-                                    dicom);
-                            mask_collection->loadData(true);
-                            mask_collection->removeAllValidatedBy();
-                            mask_collection->saveCollection();
-                            EventQueue::getInstance().post(Event_ptr(new Event("mask/changed/" + dicom->getId())));
+                    if (ImGui::Button("Cancel###batch_cancel")) {
+                        JobScheduler::getInstance().stopJob(batch_job_);
+                    }
+                }
+                else {
+                    batch_job_ = 0;
+                    if (ImGui::Button("Unvalidate all")) {
+                        unvalidate_confirm_prompt = true;
+                    }
+                    if (unvalidate_confirm_prompt) {
+                        ImGui::SameLine();
+                        ImGui::Text("Are you sure ?");
+                        ImGui::SameLine();
+                        if (ImGui::Button("yes")) {
+                            unvalidate_confirm_prompt = false;
+                            run_batch(std::make_shared<::core::segmentation::UnvalidateOperation>());
+                        }
+                        ImGui::SameLine();
+                        if (ImGui::Button("no")) {
+                            unvalidate_confirm_prompt = false;
                         }
                     }
                     ImGui::SameLine();
-                    if (ImGui::Button("no")) {
-                        unvalidate_confirm_prompt = false;
+                    if (ImGui::Button("Use predictions for empty masks")) {
+                        run_batch(std::make_shared<::core::segmentation::CopyPredictionOperation>());
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::Button("Predict from ML")) {
+                        auto& models = active_seg_->getModels();
+                        if (models.empty()) {
+                            auto& config = active_seg_->getModelConfig();
+                            active_seg_->addModel(std::make_shared<::core::segmentation::ML_Model>(
+                                    active_seg_->getName(), config.ww, config.wc, config.input_size));
+                        }
+                        // The model is loaded by the job if needed
+                        run_batch(std::make_shared<::core::segmentation::PredictOperation>(
+                                models.back(), active_seg_->getModelFilename(), false,
+                                Settings::getInstance().getPredictionBatchSize(),
+                                Settings::getInstance().getPredictionThreads()));
                     }
-                }
-                ImGui::SameLine();
-                if (ImGui::Button("Predict from ML (when finished the program will close, you will have to restart it)")) {
-                    auto state = PyGILState_Ensure();
-                    auto predict_module = py::module::import("python.scripts.predict");
-                    predict_module.attr("predict")(project->getRoot(), active_seg_->getName());
-                    std::exit(0);
                 }
             }
         }
@@ -154,21 +191,9 @@ void Rendering::DatasetView::ImGuiDraw(GLFWwindow* window, Rect& parent_dimensio
                         BM_DEBUG("Select Show all dicoms");
                     }
                     else {
+                        // The previews of the dicoms that are not in the group are released when drawing
                         EventQueue::getInstance().post(Event_ptr(new Event("dataset/group/select/" + std::to_string(idx - 1))));
                         reset_draw_ = true;
-
-                        // Unload all dicoms that are not in the group
-                        auto group_dicoms = groups_[idx - 1].getOrderedDicoms();
-                        auto all_dicoms = project->getDataset().getOrderedDicoms();
-
-                        std::sort(group_dicoms.begin(), group_dicoms.end());
-                        std::sort(all_dicoms.begin(), all_dicoms.end());
-
-                        std::vector<std::shared_ptr<::core::DicomSeries>> to_unload;
-                        std::set_difference(all_dicoms.begin(), all_dicoms.end(), group_dicoms.begin(), group_dicoms.end(), std::back_inserter(to_unload));
-                        for (auto dicom : to_unload) {
-                            dicom_previews_[dicom].unload();
-                        }
                         BM_DEBUG("Select group " + groups_[idx - 1].getName());
                     }
                 });
@@ -198,27 +223,119 @@ void Rendering::DatasetView::ImGuiDraw(GLFWwindow* window, Rect& parent_dimensio
         }
         ImVec2 mouse_pos = ImGui::GetMousePos();
 
-        ImGui::Columns(num_cols_);
-        float width = ImGui::GetContentRegionAvail().x;
-        // Show all cases
-        col_count_ = 0;
-        if (group_idx_ == 0) {
-            for (auto& dicom : dicoms_) {
-                 preview_widget(dicom_previews_[dicom], width, mouse_pos, sub_window_dim, dicom, window, parent_dimension);
+        const auto& dicoms = group_idx_ == 0 ? project->getDataset().getOrderedDicoms()
+                                             : groups_[group_idx_ - 1].getOrderedDicoms();
+        int num_rows = ((int)dicoms.size() + num_cols_ - 1) / num_cols_;
+
+        // Only the visible rows are drawn, the height of a row is measured on the previous frame
+        ImGuiListClipper clipper;
+        clipper.Begin(num_rows, row_height_ > 0.f ? row_height_ : -1.f);
+        int first_row = num_rows;
+        int last_row = 0;
+        while (clipper.Step()) {
+            first_row = std::min(first_row, clipper.DisplayStart);
+            last_row = std::max(last_row, clipper.DisplayEnd);
+
+            float start_y = ImGui::GetCursorPosY();
+            ImGui::Columns(num_cols_);
+            float width = ImGui::GetContentRegionAvail().x;
+            col_count_ = clipper.DisplayStart * num_cols_;
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                for (int col = 0; col < num_cols_; col++) {
+                    int idx = row * num_cols_ + col;
+                    if (idx >= (int)dicoms.size())
+                        break;
+                    preview_widget(get_preview(dicoms[idx]), width, mouse_pos, sub_window_dim, dicoms[idx], window, parent_dimension);
+                }
             }
+            ImGui::Columns(1);
+            if (clipper.DisplayEnd > clipper.DisplayStart)
+                row_height_ = (ImGui::GetCursorPosY() - start_y) / float(clipper.DisplayEnd - clipper.DisplayStart);
         }
-        else {
-            for (auto& dicom : groups_[group_idx_ - 1].getOrderedDicoms()) {
-                preview_widget(dicom_previews_[dicom], width, mouse_pos, sub_window_dim, dicom, window, parent_dimension);
+        clipper.End();
+        reset_draw_ = false;
+
+        // Preloads the rows around the viewport, the closest ones first
+        for (int distance = 1; distance <= margin_rows_ && first_row < last_row; distance++) {
+            auto priority = distance == 1 ? Job::JOB_PRIORITY_LOW : Job::JOB_PRIORITY_LOWEST;
+            for (int row : {last_row - 1 + distance, first_row - distance}) {
+                if (row < 0 || row >= num_rows)
+                    continue;
+                for (int idx = row * num_cols_; idx < std::min((row + 1) * num_cols_, (int)dicoms.size()); idx++) {
+                    get_preview(dicoms[idx]).load(priority);
+                }
             }
         }
-        reset_draw_ = false;
-        ImGui::Columns(1);
+        release_previews(dicoms, (first_row - margin_rows_) * num_cols_, (last_row + margin_rows_) * num_cols_);
         ImGui::EndChild();
 	}
 	ImGui::End();
 }
 
+void Rendering::DatasetView::run_batch(std::shared_ptr<const ::core::segmentation::BatchOperation> operation) {
+    auto project = project_manager_.getCurrentProject();
+    auto progress = std::make_shared<::core::segmentation::BatchProgress>();
+    std::string name = operation->getName();
+    jobResultFct result_fct = [progress, name](const std::shared_ptr<JobResult>& result) {
+        auto batch_result = std::dynamic_pointer_cast<::core::segmentation::BatchResult>(result);
+        // A canceled operation is not an error
+        if (batch_result != nullptr && progress->num_failed > 0)
+            show_error_modal(name + " error",
+                             std::to_string(progress->num_failed) + " of " + std::to_string(progress->num_cases)
+                             + " cases could not be processed",
+                             batch_result->error_msg);
+    };
+
+    batch_name_ = name;
+    batch_progress_ = progress;
+    auto job = ::core::segmentation::runBatchOperation(active_seg_, project->getDataset().getOrderedDicoms(),
+                                                       project->getRoot(), operation, batch_progress_, result_fct);
+    batch_job_ = job->id;
+    BM_DEBUG("Start batch operation " + batch_name_);
+}
+
+Rendering::Preview& Rendering::DatasetView::get_preview(const std::shared_ptr<::core::DicomSeries>& dicom) {
+    auto it = dicom_previews_.find(dicom);
+    if (it != dicom_previews_.end())
+        return *it->second;
+
+    std::unique_ptr<Preview> preview;
+    if (free_previews_.empty()) {
+        preview = std::make_unique<Preview>(validated_, edited_);
+    }
+    else {
+        preview = std::move(free_previews_.back());
+        free_previews_.pop_back();
+    }
+    preview->setSeries(dicom);
+    preview->setSegmentation(active_seg_);
+    return *dicom_previews_.emplace(dicom, std::move(preview)).first->second;
+}
+
+void Rendering::DatasetView::release_previews(const std::vector<std::shared_ptr<::core::DicomSeries>>& dicoms, int first, int last) {
+    first = std::max(first, 0);
+    last = std::min(last, (int)dicoms.size());
+    std::set<std::shared_ptr<::core::DicomSeries>> kept;
+    for (int i = first; i < last; i++) {
+        kept.insert(dicoms[i]);
+    }
+
+    for (auto it = dicom_previews_.begin(); it != dicom_previews_.end();) {
+        if (kept.find(it->first) != kept.end()) {
+            ++it;
+            continue;
+        }
+        // Unloads the series and cancels its loading jobs
+        it->second->setSeries(nullptr);
+        free_previews_.push_back(std::move(it->second));
+        it = dicom_previews_.erase(it);
+    }
+}
+
+void Rendering::DatasetView::release_all_previews() {
+    release_previews({}, 0, 0);
+}
+
 inline void Rendering::DatasetView::preview_widget(Preview& preview, float width, ImVec2 mouse_pos, Rect sub_window_dim, std::shared_ptr<::core::DicomSeries> dicom, GLFWwindow* window, Rect& parent_dimension) {
     if (Widgets::check_hitbox(mouse_pos, sub_window_dim)) {
         preview.setAllowScroll(true);
@@ -227,15 +344,8 @@ inline void Rendering::DatasetView::preview_widget(Preview& preview, float width
         preview.setAllowScroll(false);
     }
 
-    auto& dim = preview.getDimensions();
-    float margin = 3 * width;
-    float margin_less = 2 * width;
-
-    bool draw = dim.ypos - sub_window_dim.ypos < sub_window_dim.height + margin && dim.ypos - sub_window_dim.ypos > -margin_less;
-    if (draw)
-        preview.load();
-    else if (dim.ypos - sub_window_dim.ypos >= sub_window_dim.height + margin || dim.ypos - sub_window_dim.ypos <= -margin)
-        preview.unload();
+    // Only the visible rows are drawn
+    preview.load(Job::JOB_PRIORITY_HIGH);
 
     // Image widget
     float widget_size = width * 0.98;
@@ -245,33 +355,26 @@ inline void Rendering::DatasetView::preview_widget(Preview& preview, float width
         ImGui::Separator();
 
     // Title
-    if (draw) {
-        ImGui::Text("%s", dicom->getIdPair().first.c_str());
-        if (active_seg_ != nullptr) {
-            auto state = preview.getMaskState();
-            switch (state) {
-            case Preview::VALIDATED:
-                ImGui::SameLine();
-                ImGui::TextColored(ImVec4(0.f, 0.8f, 0.0f, 1.f), "(V)");
-                break;
-            case Preview::PREDICTED:
-                ImGui::SameLine();
-                ImGui::TextColored(ImVec4(0.3f, 0.4f, 0.7f, 1.f), "(P)");
-                break;
-            case Preview::CURRENT:
-                ImGui::SameLine();
-                ImGui::TextColored(ImVec4(0.7f, 0.5f, 0.0f, 1.f), "(E)");
-                break;
-            }
+    ImGui::Text("%s", dicom->getIdPair().first.c_str());
+    if (active_seg_ != nullptr) {
+        auto state = preview.getMaskState();
+        switch (state) {
+        case Preview::VALIDATED:
+            ImGui::SameLine();
+            ImGui::TextColored(ImVec4(0.f, 0.8f, 0.0f, 1.f), "(V)");
+            break;
+        case Preview::PREDICTED:
+            ImGui::SameLine();
+            ImGui::TextColored(ImVec4(0.3f, 0.4f, 0.7f, 1.f), "(P)");
+            break;
+        case Preview::CURRENT:
+            ImGui::SameLine();
+            ImGui::TextColored(ImVec4(0.7f, 0.5f, 0.0f, 1.f), "(E)");
+            break;
         }
-        preview.setNoDraw(false);
-        preview.ImGuiDraw(window, parent_dimension);
-    }
-    else {
-        ImGui::Text("");
-        preview.setNoDraw(true);
-        preview.ImGuiDraw(window, parent_dimension);
     }
+    preview.setNoDraw(false);
+    preview.ImGuiDraw(window, parent_dimension);
 
     col_count_++;
     ImGui::NextColumn();
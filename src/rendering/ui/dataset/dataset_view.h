@@ -3,12 +3,14 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <memory>
 #include "imgui.h"
 
 #include "rendering/drawables.h"
 #include "rendering/ui/dataset/preview.h"
 #include "core/project/project_manager.h"
 #include "rendering/ui/widgets/util.h"
+#include "core/segmentation/batch.h"
 #include "jobscheduler.h"
 
 namespace Rendering {
@@ -19,10 +21,14 @@ namespace Rendering {
     class DatasetView : public AbstractLayout {
     private:
         ::core::project::ProjectManager& project_manager_ = ::core::project::ProjectManager::getInstance();
-        core::dataset::dicom_set dicoms_;
+        size_t num_dicoms_ = 0;
 
-        std::map<std::shared_ptr<::core::DicomSeries>, Preview> dicom_previews_;
-        std::map<std::shared_ptr<::core::DicomSeries>, Rect> dicom_sizes_;
+        // Previews only exist for the rows around the viewport, they are recycled through free_previews_
+        std::map<std::shared_ptr<::core::DicomSeries>, std::unique_ptr<Preview>> dicom_previews_;
+        std::vector<std::unique_ptr<Preview>> free_previews_;
+        // Number of rows above and below the viewport whose previews are kept and preloaded
+        int margin_rows_ = 3;
+        float row_height_ = 0.f;
 
         std::vector<::core::dataset::Group> groups_;
         int group_idx_ = 0;
@@ -31,6 +37,7 @@ namespace Rendering {
         int col_count_ = 0;
 
         Listener reload_seg_;
+        Listener mask_written_;
 
         bool reset_draw_ = true;
         Rect prev_window_dim_;
@@ -47,6 +54,24 @@ namespace Rendering {
 
         int num_cols_ = 3;
 
+        // Bulk operation on the masks of the active segmentation
+        jobId batch_job_ = 0;
+        std::string batch_name_;
+        std::shared_ptr<::core::segmentation::BatchProgress> batch_progress_;
+
+        void run_batch(std::shared_ptr<const ::core::segmentation::BatchOperation> operation);
+
+        /**
+         * Returns the preview of the series, a preview is taken from the pool if there is none yet
+         */
+        Preview& get_preview(const std::shared_ptr<::core::DicomSeries>& dicom);
+
+        /**
+         * Releases the previews of the series that are not between first and last (in the list of shown series)
+         */
+        void release_previews(const std::vector<std::shared_ptr<::core::DicomSeries>>& dicoms, int first, int last);
+        void release_all_previews();
+
         inline void preview_widget(Preview& preview, float width, ImVec2 mouse_pos, Rect sub_window_dim, std::shared_ptr<::core::DicomSeries> dicom, GLFWwindow* window, Rect& parent_dimension);
     public:
         /**
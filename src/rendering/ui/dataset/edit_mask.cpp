@@ -14,8 +14,10 @@ int Rendering::EditMask::instance_number = 0;
 
 
 void Rendering::EditMask::unload_mask() {
+    mask_generation_++;
     if (mask_collection_ != nullptr) { BM_DEBUG("Unload mask");
         mask_collection_->unloadData(true, "edit_mask");
+        mask_collection_ = nullptr;
     }
 }
 
@@ -27,6 +29,7 @@ void Rendering::EditMask::unload_dicom(bool no_reset) {
             dicom_series_ = nullptr;
             image_.reset();
         }
+        edition_limit_pipeline_.reset();
     }
 }
 
@@ -46,6 +49,9 @@ void Rendering::EditMask::loadCase(int idx) {
             image_widget_.setImage(image_);
             dicom_dimensions_.x = dicom.data.rows;
             dicom_dimensions_.y = dicom.data.cols;BM_DEBUG("Dicom loaded " + dicom_series_->getIdPair().first);
+            edition_limit_mask = core::segmentation::Mask();
+            use_edition_limit_mask = false;
+            edition_limit_pipeline_.setImage(dicom.data);
             load_mask();
         });
         set_NextPrev_buttons();
@@ -67,39 +73,26 @@ void Rendering::EditMask::load_segmentation(std::shared_ptr<::core::segmentation
 bool Rendering::EditMask::load_mask() {
     if (dicom_series_ != nullptr) {
         if (active_seg_ != nullptr) {
-            mask_collection_ = active_seg_->getMask(dicom_series_);
-            mask_collection_->loadData(true, true, "edit_mask");
-
-            if (mask_collection_->getIsValidated()) {
-                tmp_mask_ = mask_collection_->getValidated().copy();
-            } else {
-                // No edited mask but a prediction is available
-                if (mask_collection_->size() == 0 && !mask_collection_->getPrediction().empty()) {
-                    tmp_mask_ = mask_collection_->getPrediction().copy();
-                }
-                    // No edited mask and no prediction
-                else if (mask_collection_->size() == 0) {
-                    tmp_mask_ = ::core::segmentation::Mask(dicom_dimensions_.x, dicom_dimensions_.y);
-                    mask_collection_->setDimensions(dicom_dimensions_.x, dicom_dimensions_.y);
-                    //set_mask();
-                }
-                    // Edited mask
-                else {
-                    tmp_mask_ = mask_collection_->getCurrent().copy();
-                }
-            }
-            if (tmp_mask_.rows() == 0 || tmp_mask_.cols() == 0) {
-                tmp_mask_ = ::core::segmentation::Mask(dicom_dimensions_.x, dicom_dimensions_.y);
-                mask_collection_->setDimensions(dicom_dimensions_.x, dicom_dimensions_.y);
-            }
-            updateHuThresholdMask();
-            updateVertebraDistanceMask();
-            updateEditionLimitMask();
-            updateVisceralFatMask();
+            // Start the edition limit job first, it runs while the mask is loading
             updateVisceralFatSegmentationsBox();
             updateOtherMaskBox();
-            updateOtherSegmentationMask();
+            updateEditionLimitMask();
+
+            // The masks are read by a job (on the PyAPI::Executor), the main thread does not wait for Python
+            auto collection = active_seg_->getMask(dicom_series_);
+            int generation = ++mask_generation_;
+            tmp_mask_ = ::core::segmentation::Mask(dicom_dimensions_.x, dicom_dimensions_.y);
             reset_image_ = true;
+            collection->loadData(false, true, "edit_mask", [this, collection, generation] {
+                if (generation != mask_generation_) {
+                    // Another mask has been opened in the meantime
+                    collection->unloadData(true, "edit_mask");
+                    return;
+                }
+                mask_collection_ = collection;
+                set_tmp_mask();
+                reset_image_ = true;
+            }, Job::JOB_PRIORITY_HIGH);
         } else {
             image_.setImageFromHU(
                     dicom_series_->getCurrentDicom().data,
@@ -110,6 +103,31 @@ bool Rendering::EditMask::load_mask() {
     return active_seg_ != nullptr;
 }
 
+void Rendering::EditMask::set_tmp_mask() {
+    if (mask_collection_->getIsValidated()) {
+        tmp_mask_ = mask_collection_->getValidated().copy();
+    } else {
+        // No edited mask but a prediction is available
+        if (mask_collection_->size() == 0 && !mask_collection_->getPrediction().empty()) {
+            tmp_mask_ = mask_collection_->getPrediction().copy();
+        }
+            // No edited mask and no prediction
+        else if (mask_collection_->size() == 0) {
+            tmp_mask_ = ::core::segmentation::Mask(dicom_dimensions_.x, dicom_dimensions_.y);
+            mask_collection_->setDimensions(dicom_dimensions_.x, dicom_dimensions_.y);
+            //set_mask();
+        }
+            // Edited mask
+        else {
+            tmp_mask_ = mask_collection_->getCurrent().copy();
+        }
+    }
+    if (tmp_mask_.rows() == 0 || tmp_mask_.cols() == 0) {
+        tmp_mask_ = ::core::segmentation::Mask(dicom_dimensions_.x, dicom_dimensions_.y);
+        mask_collection_->setDimensions(dicom_dimensions_.x, dicom_dimensions_.y);
+    }
+}
+
 Rendering::EditMask::EditMask()
         : lasso_select_b_(
         "assets/lasso.png",
@@ -211,7 +229,7 @@ Rendering::EditMask::EditMask()
     ctrl_z_.keys = {KEY_CTRL, GLFW_KEY_Z};
     ctrl_z_.name = "undo";
     ctrl_z_.callback = [this] {
-        if (active_seg_ != nullptr && dicom_series_ != nullptr) {
+        if (active_seg_ != nullptr && dicom_series_ != nullptr && mask_collection_ != nullptr) {
             if (!mask_collection_->isCursorBegin()) {
                 undo();
             }
@@ -221,7 +239,7 @@ Rendering::EditMask::EditMask()
     ctrl_y_.keys = {KEY_CTRL, GLFW_KEY_Y};
     ctrl_y_.name = "undo";
     ctrl_y_.callback = [this] {
-        if (active_seg_ != nullptr && dicom_series_ != nullptr) {
+        if (active_seg_ != nullptr && dicom_series_ != nullptr && mask_collection_ != nullptr) {
             if (!mask_collection_->isCursorEnd()) {
                 redo();
             }
@@ -292,6 +310,16 @@ Rendering::EditMask::EditMask()
         lasso_or_brush = 2;
     };
 
+    edition_limit_pipeline_.setPublishFunction(
+            [this](const std::shared_ptr<core::segmentation::EditionLimitResult> &result) {
+                edition_limit_mask = result->edition_limit;
+                use_edition_limit_mask = result->use_edition_limit;
+                visceral_fat_help_debug_rows = result->debug_rows;
+                visceral_fat_help_debug_cols = result->debug_cols;
+                reset_image_ = true;
+                push_animation();
+            });
+
     EventQueue::getInstance().subscribe(&load_dicom_);
     EventQueue::getInstance().subscribe(&reload_seg_);
     EventQueue::getInstance().subscribe(&load_segmentation_);
@@ -527,7 +555,7 @@ void Rendering::EditMask::ImGuiDraw(GLFWwindow *window, Rect &parent_dimension)
                     prev_hu_min_ = hu_min_;
                     prev_ignore_small_holes_and_objects = ignore_small_holes_and_objects;
                     prev_opening_size = opening_size;
-                    updateHuThresholdMask();
+                    updateEditionLimitMask();
                 }
             }
 
@@ -546,7 +574,7 @@ void Rendering::EditMask::ImGuiDraw(GLFWwindow *window, Rect &parent_dimension)
                 if (prev_vertebra_min_HU != vertebra_min_HU || prev_vertebra_min_distance != vertebra_min_distance) {
                     prev_vertebra_min_HU = vertebra_min_HU;
                     prev_vertebra_min_distance = vertebra_min_distance;
-                    updateVertebraDistanceMask();
+                    updateEditionLimitMask();
                 }
             }
 
@@ -567,7 +595,7 @@ void Rendering::EditMask::ImGuiDraw(GLFWwindow *window, Rect &parent_dimension)
 
             if (prev_muscle_segmentation_for_visceral_fat_help != muscle_segmentation_for_visceral_fat_help) {
                 prev_muscle_segmentation_for_visceral_fat_help = muscle_segmentation_for_visceral_fat_help;
-                updateVisceralFatMask();
+                updateEditionLimitMask();
             }
 
             ImGui::Checkbox("Other mask (M)", &use_other_mask_filter);
@@ -583,7 +611,7 @@ void Rendering::EditMask::ImGuiDraw(GLFWwindow *window, Rect &parent_dimension)
 
             if (prev_segmentation_for_other_mask != segmentation_for_other_mask) {
                 prev_segmentation_for_other_mask = segmentation_for_other_mask;
-                updateOtherSegmentationMask();
+                updateEditionLimitMask();
             }
 
             if (!is_validated) {
@@ -657,7 +685,10 @@ void Rendering::EditMask::ImGuiDraw(GLFWwindow *window, Rect &parent_dimension)
         Rect &dimensions = image_widget_.getDimensions();
 
 
-        if (!disable_edit && !is_validated) {
+        // Edits wait for the edition limit of the current slice
+        bool limit_pending = (use_hu_range || use_vertebra_min_distance || use_visceral_fat_help || use_other_mask_filter)
+                             && !edition_limit_pipeline_.isReady();
+        if (!disable_edit && !is_validated && !limit_pending && mask_collection_ != nullptr) {
             if (lasso_or_brush == 0) {
                 lasso_widget(dimensions);
             } else if (lasso_or_brush == 1) {
@@ -725,51 +756,38 @@ void Rendering::EditMask::ImGuiDraw(GLFWwindow *window, Rect &parent_dimension)
 
 }
 
-void Rendering::EditMask::updateHuThresholdMask() {
-    hu_threshold_mask = core::segmentation::huThresholdMask(dicom_series_->getCurrentDicom().data,
-                                                            hu_min_, hu_max_,
-                                                            ignore_small_holes_and_objects,
-                                                            opening_size, opening_size);
-    updateEditionLimitMask();
-}
-
-void Rendering::EditMask::updateVertebraDistanceMask() {
-    vertebra_distance_mask = core::segmentation::vertebraDistanceMask(dicom_series_->getCurrentDicom().data,
-                                                                      vertebra_min_HU, vertebra_min_distance);
-
-    updateEditionLimitMask();
-}
-
 void Rendering::EditMask::updateEditionLimitMask() {
-    edition_limit_mask = core::segmentation::Mask(dicom_series_->getCurrentDicom().data.rows,
-                                                  dicom_series_->getCurrentDicom().data.cols,
-                                                  true);
-    use_edition_limit_mask = false;
-
-    if (use_hu_range) {
-        edition_limit_mask.intersect_with(hu_threshold_mask);
-        use_edition_limit_mask = true;
-    }
-
-    if (use_vertebra_min_distance) {
-        edition_limit_mask.intersect_with(vertebra_distance_mask);
-        use_edition_limit_mask = true;
-    }
+    if (dicom_series_ == nullptr)
+        return;
 
-    if (use_visceral_fat_help) {
-        edition_limit_mask.intersect_with(visceral_fat_mask);
-        use_edition_limit_mask = true;
+    core::segmentation::EditionLimitParams params;
+    params.use_hu_range = use_hu_range;
+    params.hu_min = hu_min_;
+    params.hu_max = hu_max_;
+    params.ignore_small_objects = ignore_small_holes_and_objects;
+    params.opening_size = opening_size;
+
+    params.use_vertebra_distance = use_vertebra_min_distance;
+    params.vertebra_min_hu = vertebra_min_HU;
+    params.vertebra_min_distance = vertebra_min_distance;
+
+    // Mask collections are fetched here, the segmentations are not meant to be accessed from the workers
+    // The revisions make a new request once these masks have been edited (e.g. in another segmentation)
+    params.use_visceral_fat_help = use_visceral_fat_help;
+    if (use_visceral_fat_help && muscle_segmentation_for_visceral_fat_help != nullptr) {
+        params.muscle_masks = muscle_segmentation_for_visceral_fat_help->getMask(dicom_series_);
+        params.muscle_revision = params.muscle_masks->getRevision();
     }
 
-    if (use_other_mask_filter) {
-        edition_limit_mask.intersect_with(other_segmentation_mask);
-        use_edition_limit_mask = true;
+    params.use_other_mask = use_other_mask_filter;
+    if (use_other_mask_filter && segmentation_for_other_mask != nullptr) {
+        params.other_masks = segmentation_for_other_mask->getMask(dicom_series_);
+        params.other_revision = params.other_masks->getRevision();
     }
 
-    reset_image_ = true;
+    edition_limit_pipeline_.request(params);
 }
 
-
 void Rendering::EditMask::accept_drag_and_drop() {
     if (ImGui::BeginDragDropTarget()) { BM_DEBUG("Accept drag and drop");
         if (ImGui::AcceptDragDropPayload("_DICOM_PAYLOAD")) {
@@ -831,13 +849,9 @@ void Rendering::EditMask::button_logic() {
 
 void Rendering::EditMask::set_NextPrev_buttons() {
     auto &project = ::core::project::ProjectManager::getInstance().getCurrentProject();
-    std::vector<std::shared_ptr<::core::DicomSeries>> dicoms;
-    if (group_idx_ >= 0) {
-        auto &groups = project->getDataset().getGroups();
-        dicoms = groups[group_idx_].getOrderedDicoms();
-    } else {
-        dicoms = project->getDataset().getOrderedDicoms();
-    }
+    auto &dataset = project->getDataset();
+    const auto &dicoms = group_idx_ >= 0 ? dataset.getGroups()[group_idx_].getOrderedDicoms()
+                                         : dataset.getOrderedDicoms();
     std::shared_ptr<::core::DicomSeries> prev = nullptr;
     std::shared_ptr<::core::DicomSeries> next = nullptr;
     bool found = false;
@@ -968,10 +982,10 @@ void Rendering::EditMask::lasso_widget(Rect &dimensions) {
             }
 
             // Draw the polygon
-            ::core::segmentation::Mask mask(tmp_mask_.rows(), tmp_mask_.cols());
-            ::core::segmentation::lassoSelectToMask(positions, mask, 1);
-
-            editTmpMaskAreaFromClick(mask, ImGui::IsMouseReleased(0), ImGui::IsMouseReleased(1));
+            stroke_.begin(tmp_mask_.getData().rows, tmp_mask_.getData().cols);
+            stroke_.addPolygon(positions);
+            stroke_.apply(tmp_mask_, use_edition_limit_mask ? &edition_limit_mask : nullptr,
+                          ImGui::IsMouseReleased(0), ImGui::IsMouseReleased(1));
 
             delete[] raw_path_;
             path_size = 0;
@@ -1047,8 +1061,7 @@ void Rendering::EditMask::brush_widget(Rect &dimensions) {
                 }
                 last_mouse_pos_ = mouse_pos;
 
-                ::core::segmentation::Mask mask(tmp_mask_.rows(), tmp_mask_.cols());
-
+                stroke_.begin(tmp_mask_.getData().rows, tmp_mask_.getData().cols);
                 for (auto &pos: positions) {
                     Crop crop = image_widget_.getCrop();
                     ImVec2 corrected_mouse_pos = {
@@ -1057,9 +1070,10 @@ void Rendering::EditMask::brush_widget(Rect &dimensions) {
                             (crop.y0 + (crop.y1 - crop.y0) * (pos.y - dimensions.ypos) / dimensions.height) *
                             image_.height()
                     };
-                    ::core::segmentation::brushToMask(brush_size_ / 2.f, corrected_mouse_pos, mask, 1);
+                    stroke_.addDab(corrected_mouse_pos.x, corrected_mouse_pos.y, brush_size_ / 2.f);
                 }
-                editTmpMaskAreaFromClick(mask, ImGui::IsMouseDown(0), ImGui::IsMouseDown(1));
+                stroke_.apply(tmp_mask_, use_edition_limit_mask ? &edition_limit_mask : nullptr,
+                              ImGui::IsMouseDown(0), ImGui::IsMouseDown(1));
                 reset_image_ = true;
                 begin_action_ = true;
             }
@@ -1083,54 +1097,22 @@ void Rendering::EditMask::flood_fill_widget(Rect &dimensions) {
                     (crop.y0 + (crop.y1 - crop.y0) * (mouse_pos.y - dimensions.ypos) / dimensions.height) *
                     image_.height()
             };
-            ::core::segmentation::Mask edition_area = tmp_mask_.copy();
-            edition_area.combine_with(edition_limit_mask);
-            cv::floodFill(edition_area.getData(), cv::Point(corrected_mouse_pos.x, corrected_mouse_pos.y), 4);
-            edition_area.convert_to_binary(4);
-            editTmpMaskAreaFromClick(edition_area, ImGui::IsMouseDown(0), ImGui::IsMouseDown(1));
-            reset_image_ = true;
-            set_mask();
+            stroke_.begin(tmp_mask_.getData().rows, tmp_mask_.getData().cols);
+            if (stroke_.addFloodFill(tmp_mask_, &edition_limit_mask,
+                                     (int) corrected_mouse_pos.x, (int) corrected_mouse_pos.y)) {
+                stroke_.apply(tmp_mask_, use_edition_limit_mask ? &edition_limit_mask : nullptr,
+                              ImGui::IsMouseDown(0), ImGui::IsMouseDown(1));
+                reset_image_ = true;
+                set_mask();
+            }
         }
     }
 }
 
 
 void Rendering::EditMask::automaticBrushBorders() {
-    std::vector<std::pair<int, int>> mask_border_coordinates;
-    auto tmp_mask_matrix = tmp_mask_.getData();
-    for (int row_index = 0; row_index < tmp_mask_.rows(); row_index++) {
-        for (int col_index = 0; col_index < tmp_mask_.cols(); col_index++) {
-            if (tmp_mask_matrix.at<uchar>(row_index, col_index) == 1) {
-                bool is_border = false;
-                //left
-                if (col_index - 1 >= 0 && tmp_mask_matrix.at<uchar>(row_index, col_index - 1) == 0) {
-                    is_border = true;
-                }
-                //right
-                if (col_index + 1 < tmp_mask_.cols() && tmp_mask_matrix.at<uchar>(row_index, col_index + 1) == 0) {
-                    is_border = true;
-                }
-                //up
-                if (row_index - 1 >= 0 && tmp_mask_matrix.at<uchar>(row_index - 1, col_index) == 0) {
-                    is_border = true;
-                }
-                //down
-                if (row_index + 1 < tmp_mask_.rows() && tmp_mask_matrix.at<uchar>(row_index + 1, col_index) == 0) {
-                    is_border = true;
-                }
-                if (is_border) {
-                    mask_border_coordinates.push_back(std::pair<int, int>(row_index, col_index));
-                }
-            }
-
-        }
-    }
-    for (auto border_coordinate: mask_border_coordinates) {
-        core::segmentation::Mask edition_mask(tmp_mask_.rows(), tmp_mask_.cols());
-        auto position = ImVec2{static_cast<float>(border_coordinate.second),
-                               static_cast<float>(border_coordinate.first)};
-        ::core::segmentation::brushToMask(auto_brush_size_, position, edition_mask, 1);
-        editTmpMaskArea(edition_mask, true, true, true);
+    if (use_edition_limit_mask) {
+        ::core::segmentation::autoBrushBorders(tmp_mask_, edition_limit_mask, auto_brush_size_);
     }
     reset_image_ = true;
     set_mask();
@@ -1144,28 +1126,8 @@ void Rendering::EditMask::editTmpMaskAreaFromClick(const core::segmentation::Mas
 
 void Rendering::EditMask::editTmpMaskArea(const core::segmentation::Mask &area_to_edit, bool add, bool remove,
                                           bool only_if_limitation_used) {
-    if (add) {
-        core::segmentation::Mask area_to_add = area_to_edit.copy();
-        bool limitation_used = false;
-        if (use_edition_limit_mask) {
-            area_to_add.intersect_with(edition_limit_mask);
-            limitation_used = !area_to_add.isEqualTo(area_to_edit);
-        }
-        if (!only_if_limitation_used || limitation_used) {
-            tmp_mask_.union_with(area_to_add);
-        }
-    }
-
-    if (remove) {
-        core::segmentation::Mask area_to_remove = area_to_edit.copy();
-        bool limitation_used = false;
-        if (use_edition_limit_mask) {
-            area_to_remove.difference_with(edition_limit_mask);
-            limitation_used = !area_to_remove.isEqualTo(area_to_edit);
-        }
-        if (!only_if_limitation_used || limitation_used)
-            tmp_mask_.difference_with(area_to_remove);
-    }
+    ::core::segmentation::editMaskArea(tmp_mask_, area_to_edit, use_edition_limit_mask ? &edition_limit_mask : nullptr,
+                                       add, remove, only_if_limitation_used);
 }
 
 void Rendering::EditMask::updateVisceralFatSegmentationsBox() {
@@ -1188,69 +1150,6 @@ void Rendering::EditMask::updateVisceralFatSegmentationsBox() {
     }
 }
 
-void Rendering::EditMask::updateVisceralFatMask() {
-    if (muscle_segmentation_for_visceral_fat_help != nullptr) {
-        auto muscle_mask_collection = muscle_segmentation_for_visceral_fat_help->getMask(dicom_series_);
-        muscle_mask_collection->loadData(true);
-        auto muscle_mask = muscle_mask_collection->getMostAdvancedMask();
-        visceral_fat_help_debug_rows.clear();
-        visceral_fat_help_debug_cols.clear();
-        visceral_fat_mask = core::segmentation::Mask(muscle_mask.rows(), muscle_mask.cols());
-        visceral_fat_mask.fill(1);
-
-
-        if (!muscle_mask.empty()) {
-            int top_muscle_row = muscle_mask.top_row();
-            visceral_fat_help_debug_rows.insert(top_muscle_row);
-            int bottom_muscle_row = muscle_mask.bottom_row();
-            visceral_fat_help_debug_rows.insert(bottom_muscle_row);
-            int base_row = top_muscle_row + (bottom_muscle_row - top_muscle_row) / 4;
-            visceral_fat_help_debug_rows.insert(base_row);
-
-            int left_column = 0;
-            while (left_column < muscle_mask.cols() && muscle_mask.get_pixel(base_row, left_column) == 0) {
-                left_column++;
-            }
-            int right_column = muscle_mask.cols() - 1;
-            while (right_column >= 0 && muscle_mask.get_pixel(base_row, right_column) == 0) {
-                right_column--;
-            }
-
-            int columns_margin = (right_column - left_column) / 8;
-            left_column += columns_margin;
-            right_column -= columns_margin;
-            visceral_fat_help_debug_cols.insert(left_column);
-            visceral_fat_help_debug_cols.insert(right_column);
-
-            cv::Point first_muscle_point = muscle_mask.find_first_pixel(base_row, muscle_mask.rows(), left_column,
-                                                                        right_column);
-            visceral_fat_help_debug_rows.insert(first_muscle_point.y);
-            visceral_fat_help_debug_cols.insert(first_muscle_point.x);
-
-            cv::Point second_muscle_point_candidate1 = muscle_mask.find_first_pixel(base_row, muscle_mask.rows(),
-                                                                                    left_column,
-                                                                                    first_muscle_point.x -
-                                                                                    columns_margin);
-            cv::Point second_muscle_point_candidate2 = muscle_mask.find_first_pixel(base_row, muscle_mask.rows(),
-                                                                                    right_column,
-                                                                                    first_muscle_point.x +
-                                                                                    columns_margin);
-
-            cv::Point second_muscle_point = second_muscle_point_candidate1.y < second_muscle_point_candidate2.y ?
-                                            second_muscle_point_candidate1 : second_muscle_point_candidate2;
-            visceral_fat_help_debug_rows.insert(second_muscle_point.y);
-            visceral_fat_help_debug_cols.insert(second_muscle_point.x);
-
-
-            cv::line(visceral_fat_mask.getData(),
-                     first_muscle_point,
-                     second_muscle_point,
-                     0);
-        }
-        updateEditionLimitMask();
-    }
-}
-
 void Rendering::EditMask::updateOtherMaskBox() {
     static std::set<std::shared_ptr<core::segmentation::Segmentation>> previous_segmentations = {};
     auto segmentations = ::core::project::ProjectManager::getInstance().getCurrentProject()->getSegmentations();
@@ -1271,23 +1170,3 @@ void Rendering::EditMask::updateOtherMaskBox() {
     }
 }
 
-void Rendering::EditMask::updateOtherSegmentationMask() {
-    if(segmentation_for_other_mask != nullptr) {
-        auto other_segmentation_mask_collection = segmentation_for_other_mask->getMask(dicom_series_);
-        other_segmentation_mask_collection->loadData(true);
-        auto other_mask = other_segmentation_mask_collection->getMostAdvancedMask();
-        if (other_mask.empty()) {
-            other_segmentation_mask = ::core::segmentation::Mask();
-            other_segmentation_mask.fill(1);
-        } else {
-            other_segmentation_mask = other_mask.copy();
-            other_segmentation_mask.invert();
-        }
-    }
-    updateEditionLimitMask();
-}
-
-
-
-
-
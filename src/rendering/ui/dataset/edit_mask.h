@@ -10,6 +10,8 @@
 #include "core/dataset/explore.h"
 #include "core/dataset/dataset.h"
 #include "core/segmentation/segmentation.h"
+#include "core/segmentation/edition_limit.h"
+#include "core/segmentation/stroke.h"
 #include "core/project/project_manager.h"
 #include "core/dicom.h"
 #include "events.h"
@@ -99,14 +101,14 @@ namespace Rendering {
         int num_names_ = 0;
 
         ::core::segmentation::Mask tmp_mask_;
-        ::core::segmentation::Mask hu_threshold_mask;
-        ::core::segmentation::Mask vertebra_distance_mask;
-        ::core::segmentation::Mask visceral_fat_mask;
-        ::core::segmentation::Mask other_segmentation_mask;
         ::core::segmentation::Mask edition_limit_mask;
-        bool use_edition_limit_mask;
+        bool use_edition_limit_mask = false;
+        ::core::segmentation::EditionLimitPipeline edition_limit_pipeline_;
+        ::core::segmentation::StrokeEngine stroke_;
 
+        // Only set once the masks are loaded, the mask can not be edited before
         std::shared_ptr<::core::segmentation::MaskCollection> mask_collection_ = nullptr;
+        int mask_generation_ = 0; // Incremented when the mask is unloaded, late loads are then ignored
 
         int case_select_ = 1;
         int previous_select_ = 0;
@@ -129,6 +131,8 @@ namespace Rendering {
 
         bool load_mask();
 
+        void set_tmp_mask();
+
         void disable_buttons();
 
         void button_logic();
@@ -204,13 +208,13 @@ namespace Rendering {
         float vertebra_min_HU = 150;
         float prev_vertebra_min_HU = vertebra_min_HU;
 
-        void updateHuThresholdMask();
-        void updateVertebraDistanceMask();
+        /**
+         * Asks the edition limit pipeline for the mask corresponding to the current options
+         * The mask is computed in the background and published to edition_limit_mask when ready
+         */
         void updateEditionLimitMask();
         void updateVisceralFatSegmentationsBox();
-        void updateVisceralFatMask();
         void updateOtherMaskBox();
-        void updateOtherSegmentationMask();
 
         bool disable_edit = false;
         int opening_size = 0;
@@ -140,14 +140,32 @@ namespace Rendering {
         ImGui::EndChild();
     }
 
-    void Preview::load() {
-        if (!is_loaded_) {
-            set_case(0);
-            load_counter++;
+    void Preview::load(Job::jobPriority priority) {
+        if (is_loaded_ || !is_valid_)
+            return;
+        if (is_loading_) {
+            auto state = waiting_on_ == 0 ? Job::JOB_STATE_NOTEXISTING
+                                          : JobScheduler::getInstance().getJobInfo(waiting_on_).state;
+            // Otherwise the job has been canceled (e.g. by another loadCase of the series) and will never call back,
+            // the case is requested again
+            if (state == Job::JOB_STATE_PENDING || state == Job::JOB_STATE_RUNNING) {
+                // The request is sent again with the new priority, as long as no worker has started it
+                if (priority <= load_priority_ || state != Job::JOB_STATE_PENDING)
+                    return;
+                generation_++;
+                dicom_->cancelPendingJobs();
+            }
+            is_loading_ = false;
         }
+        set_case(0, priority);
     }
 
     void Preview::unload() {
+        generation_++;
+        if (is_loading_) {
+            dicom_->cancelPendingJobs();
+            is_loading_ = false;
+        }
         if (is_loaded_) {
             image_.reset();
             dicom_->unloadCase(case_idx_);
@@ -159,7 +177,7 @@ namespace Rendering {
     }
 
     void Preview::unload_mask() {
-        if (active_seg_ != nullptr) {
+        if (active_seg_ != nullptr && dicom_ != nullptr) {
             auto& collection = active_seg_->getMask(dicom_);
             if (collection->isSet()) {
                 reset_image_ = false;
@@ -175,10 +193,11 @@ namespace Rendering {
         if (dicom_ != nullptr && is_loaded_) {
             if (active_seg_ != nullptr) {
                 auto& collection = active_seg_->getMask(dicom_);
+                int generation = generation_;
                 collection->loadData(
                     false, false, "",
-                    [this]() {
-                        if (__hack == 235.654885342) {
+                    [this, generation]() {
+                        if (__hack == 235.654885342 && generation == generation_) {
                             set_image();
                             reset_image_ = true;
                             is_mask_loaded = true;
@@ -268,16 +287,20 @@ namespace Rendering {
         int idx = (int)(percentage * (float)(dicom_->size() - 1));
         if (idx != tmp_case_idx_) {
             tmp_case_idx_ = idx;
-            std::cout << idx << " " << percentage << std::endl;
-            set_case(idx);
+            set_case(idx, Job::JOB_PRIORITY_HIGH);
         }
     }
 
-    void Preview::set_case(int idx) {
+    void Preview::set_case(int idx, Job::jobPriority priority) {
         if (!is_valid_)
             return;
 
-        dicom_->loadCase(idx, false, [idx, this](const core::Dicom& dicom) {
+        int generation = generation_;
+        unsigned int series_generation = dicom_->getGeneration();
+        is_loading_ = true;
+        load_priority_ = priority;
+        // The callback is called immediately if the case is already loaded
+        jobId id = dicom_->loadCase(idx, false, [idx, generation, series_generation, this](const core::Dicom& dicom) {
             // Preface: this is extremely bad practice, I know
             // This function may cause a segfault (if Preview is destroyed before the job is finished)
             // This happens when there is a problem when the project loads (syntax error in python file mostly)
@@ -289,13 +312,22 @@ namespace Rendering {
             // If this function is called when Preview is already destroyed, __num should contain any garbage
             // What are the chances that __num will contain exactly this sequence (defined when constructed):
             // 0100000001101101011101001111010011010010000110101101000010100010 ?
-            if (__hack == 235.654885342) {
+            if (__hack == 235.654885342 && generation == generation_) {
+                // The images of the series have been replaced, the case is requested again by the next load
+                if (series_generation != dicom_->getGeneration()) {
+                    is_loading_ = false;
+                    return;
+                }
+                if (!is_loaded_)
+                    load_counter++;
                 case_idx_ = idx;
                 reset_image_ = true;
                 is_loaded_ = true;
+                is_loading_ = false;
                 setAndLoadMask(idx);
             }
-        });
+        }, priority);
+        waiting_on_ = is_loading_ ? id : 0;
     }
 
     void Preview::set_crop(ImVec2 crop_x, ImVec2 crop_y, bool lock) {
@@ -309,6 +341,12 @@ namespace Rendering {
     }
 
     void Preview::setSeries(std::shared_ptr<::core::DicomSeries> dicom) {
+        if (dicom_ != dicom) {
+            unload();
+            state_ = NOTHING;
+            case_idx_ = 0;
+            tmp_case_idx_ = 0;
+        }
         EventQueue::getInstance().unsubscribe(&mask_listener_);
         if (dicom != nullptr) {
             is_valid_ = true;
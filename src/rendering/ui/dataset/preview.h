@@ -28,6 +28,10 @@ namespace Rendering {
         static int instance_number;
         bool is_valid_ = false;
         bool is_loaded_ = false;
+        bool is_loading_ = false;
+        Job::jobPriority load_priority_ = Job::JOB_PRIORITY_NORMAL;
+        // Incremented when the preview is unloaded, so that the loading jobs started before are ignored
+        int generation_ = 0;
         bool is_mask_loaded = false;
         bool load_mask_ = false;
 
@@ -67,7 +71,7 @@ namespace Rendering {
         Listener mask_listener_;
 
         Listener job_listener_;
-        jobId waiting_on_;
+        jobId waiting_on_ = 0;
 
         bool is_crop_locked = false; // When true, setCrop won't affect excepted when forced
         bool is_window_locked = false;
@@ -78,7 +82,7 @@ namespace Rendering {
         
         double __hack = 235.654885342;
 
-        void set_case(int idx);
+        void set_case(int idx, Job::jobPriority priority = Job::JOB_PRIORITY_NORMAL);
         void set_crop(ImVec2 crop_x, ImVec2 crop_y, bool lock = false);
         void set_window(int width, int center, bool lock = false);
 
@@ -122,8 +126,12 @@ namespace Rendering {
 
         /**
          * If the image has been unloaded before, call reload to show the widget again
+         *
+         * Can be called every frame, the image is only requested once. If the image is still waiting for a worker,
+         * it is requested again when the priority is raised (e.g. when the preview becomes visible)
+         * @param priority priority of the loading job
         */
-        void load();
+        void load(Job::jobPriority priority = Job::JOB_PRIORITY_NORMAL);
 
         //void setWindowing(int width, int center, bool force = false);
 
@@ -141,6 +149,9 @@ namespace Rendering {
 
         void setAllowScroll(bool allow_scroll) { allow_scroll_ = allow_scroll; }
 
+        /**
+         * Sets the series shown by the preview, the previous series is unloaded so that the preview can be reused
+         */
         void setSeries(std::shared_ptr<::core::DicomSeries> dicom);
 
         //bool isLocked() const { return is_crop_locked || is_window_locked; }
@@ -30,6 +30,18 @@ Rendering::ExplorerPreview::ExplorerPreview(ImVec2 init_size) : init_size_(init_
     };
     build_tree_listener_.filter = "dataset/explorer/build";
 
+    delta_tree_listener_.callback = [=](Event_ptr &event) {
+        auto delta = reinterpret_cast<::core::dataset::ExplorerDeltaEvent*>(event.get());
+        // Deltas of a tree that has not been built yet are already in the tree given by the build event
+        if (!is_cases_set_ || delta->getCases() != cases_)
+            return;
+        // New series get a preview, series that have new images are reloaded
+        for (auto &payload : delta->getSeries()) {
+            dicom_previews_[payload.series].loadSeries(payload.series, payload.case_);
+        }
+    };
+    delta_tree_listener_.filter = "dataset/explorer/delta";
+
     filter_tree_listener_.callback = [=](Event_ptr &event) {
         auto filters = reinterpret_cast<::core::dataset::ExplorerFilterEvent*>(event.get());
         ::core::dataset::build_tree(cases_, filters->caseFilter(), filters->studyFilter(), filters->seriesFilter());
@@ -44,12 +56,14 @@ Rendering::ExplorerPreview::ExplorerPreview(ImVec2 init_size) : init_size_(init_
     reset_tree_listener_.filter = "dataset/dicom/reset";
 
     EventQueue::getInstance().subscribe(&build_tree_listener_);
+    EventQueue::getInstance().subscribe(&delta_tree_listener_);
     EventQueue::getInstance().subscribe(&reset_tree_listener_);
     EventQueue::getInstance().subscribe(&filter_tree_listener_);
 }
 
 Rendering::ExplorerPreview::~ExplorerPreview() {
     EventQueue::getInstance().unsubscribe(&build_tree_listener_);
+    EventQueue::getInstance().unsubscribe(&delta_tree_listener_);
     EventQueue::getInstance().unsubscribe(&reset_tree_listener_);
     EventQueue::getInstance().unsubscribe(&filter_tree_listener_);
 }
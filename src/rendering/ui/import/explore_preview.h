@@ -23,6 +23,7 @@ namespace Rendering {
          * For capturing the log sent by the Dicom Search
          */
         Listener build_tree_listener_;
+        Listener delta_tree_listener_;
         Listener reset_tree_listener_;
         Listener filter_tree_listener_;
 
@@ -38,6 +38,10 @@ void Rendering::ExploreFolder::ImGuiDraw(GLFWwindow *window, Rect &parent_dimens
 //        ImGui::SetNextWindowDockID(docking_id_);
 //    }
     ImGui::Begin("Find dicoms in folder");
+    // Insert the images found since the last frame
+    if (explorer_->update())
+        build_tree_ = true;
+
     if (explorer_->getStatus() == ::core::dataset::Explore::EXPLORE_WORKING) {
         if (ImGui::Button("Stop search")) {
             BM_DEBUG("Stop search");
@@ -60,6 +64,9 @@ void Rendering::ExploreFolder::ImGuiDraw(GLFWwindow *window, Rect &parent_dimens
                 EventQueue::getInstance().post(Event_ptr(new Event("dataset/dicom/reset")));
                 explorer_->findDicoms(outPath);
                 path_ = outPath;
+                build_tree_ = true;
+                is_new_tree_ = true;
+                set_tree_closed_ = true;
 
                 BM_DEBUG("Begin folder exploration");
             } else if (result == NFD_ERROR) {
@@ -81,10 +88,7 @@ void Rendering::ExploreFolder::ImGuiDraw(GLFWwindow *window, Rect &parent_dimens
     ImGui::Separator();
     switch (explorer_->getStatus()) {
         case dataset::Explore::EXPLORE_WORKING:
-            build_tree_ = true;
             display_import_button_ = false;
-            is_new_tree_ = true;
-            set_tree_closed_ = true;
             ImGui::Text("Searching the folder %s...", path_.c_str());
             break;
         case dataset::Explore::EXPLORE_SUCCESS:
@@ -112,18 +116,19 @@ void Rendering::ExploreFolder::ImGuiDraw(GLFWwindow *window, Rect &parent_dimens
     }
     else {
         // Draw the log of the exploration
-        if (explorer_->getStatus() == dataset::Explore::EXPLORE_WORKING) {
+        bool is_working = explorer_->getStatus() == dataset::Explore::EXPLORE_WORKING;
+        if (is_working) {
             ImGui::Separator();
-            ImGui::BeginChild("log_scroll", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
+            ImGui::BeginChild("log_scroll", ImVec2(0, 120), false, ImGuiWindowFlags_HorizontalScrollbar);
             ImGui::TextUnformatted(log_buffer_.begin(), log_buffer_.end());
             if (ImGui::GetScrollY() >= ImGui::GetScrollMaxY())
                 ImGui::SetScrollHereY(1.0f);
             ImGui::EndChild();
         }
-        // Draw the result and / or the errors
-        else if (explorer_->getStatus() != dataset::Explore::EXPLORE_SLEEPING) {
+        // Draw the result and / or the errors, the tree grows while the exploration is running
+        if (explorer_->getStatus() != dataset::Explore::EXPLORE_SLEEPING) {
             ImGui::Separator();
-            display_import_button_ = true;
+            display_import_button_ = !is_working;
 
             // Error log
             if (!error_buffer_.empty()) {
@@ -173,7 +178,7 @@ void Rendering::ExploreFolder::ImGuiDraw(GLFWwindow *window, Rect &parent_dimens
                     ImGui::PushStyleColor(ImGuiCol_Text, disabled_text_color);
 
                 // Patient ID node
-                bool node1 = ImGui::TreeNodeEx((void*)&patient, nodeFlags, "Case ID: %s", patient.ID.c_str());
+                bool node1 = ImGui::TreeNodeEx(patient.ID.c_str(), nodeFlags, "Case ID: %s", patient.ID.c_str());
                 exclude_menu(patient.is_active, "case");
 
                 if (node1) {
@@ -187,8 +192,10 @@ void Rendering::ExploreFolder::ImGuiDraw(GLFWwindow *window, Rect &parent_dimens
                         bool study_active = study.is_active && patient_active;
                         if (!study_active)
                             ImGui::PushStyleColor(ImGuiCol_Text, disabled_text_color);
-                        // Study node
-                        bool node2 = ImGui::TreeNodeEx((void*)&study, nodeFlags, "%s", study.description.c_str());
+                        // Study node, the ids do not depend on the address of the nodes that move when the
+                        // tree grows
+                        std::string study_id = study.date + study.time + study.description;
+                        bool node2 = ImGui::TreeNodeEx(study_id.c_str(), nodeFlags, "%s", study.description.c_str());
                         if (ImGui::IsItemHovered()) {
                             ImGui::SetTooltip("%s at %s", study.date.c_str(), study.time.c_str());
                         }
@@ -204,11 +211,11 @@ void Rendering::ExploreFolder::ImGuiDraw(GLFWwindow *window, Rect &parent_dimens
                                 bool series_active = series->is_active && study_active && patient_active;
                                 if (!series_active)
                                     ImGui::PushStyleColor(ImGuiCol_Text, disabled_text_color);
-                                // Series node
+                                // Series node, closed by default as series keep appearing during the exploration
                                 if (set_tree_closed_) {
                                     ImGui::SetNextItemOpen(false);
                                 }
-                                bool node3 = ImGui::TreeNodeEx((void*)&series, nodeFlags | ImGuiTreeNodeFlags_Framed, "Series %s, Modality %s",
+                                bool node3 = ImGui::TreeNodeEx((void*)series.get(), ImGuiTreeNodeFlags_Framed, "Series %s, Modality %s",
                                     series->number.c_str(), series->modality.c_str());
                                 exclude_menu(series->is_active, "series");
 
@@ -225,7 +232,7 @@ void Rendering::ExploreFolder::ImGuiDraw(GLFWwindow *window, Rect &parent_dimens
                                             ImGui::PushStyleColor(ImGuiCol_Text, disabled_text_color);
 
                                         // Image node
-                                        bool node4 = ImGui::TreeNodeEx((void*)&image, leaf_flag, "%s",
+                                        bool node4 = ImGui::TreeNodeEx(image.path.c_str(), leaf_flag, "%s",
                                             image.number.c_str());
                                         exclude_menu(image.is_active, "image");
                                         if (node4)
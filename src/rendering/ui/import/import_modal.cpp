@@ -162,12 +162,55 @@ namespace Rendering {
                             auto& job_info = JobScheduler::getInstance().getJobInfo(job_id_);
                             push_animation();
 
+                            auto& import_progress = dataset.getImportProgress();
+                            int num_done = 0;
+                            int num_to_import = 0;
+                            for (auto& series : import_progress) {
+                                if (!series->skipped && !series->cancel) {
+                                    num_done += series->num_done;
+                                    num_to_import += series->num_images;
+                                }
+                            }
+
                             const ImU32 col = ImGui::GetColorU32(ImGuiCol_ButtonHovered);
                             const ImU32 bg = ImGui::GetColorU32(ImGuiCol_Button);
-                            ImGui::Text("Import image %d / %d", (int)(job_info.progress*num_images), num_images);
+                            ImGui::Text("Import image %d / %d", num_done, num_to_import);
                             ImGui::Spinner("##spinner", 15, 6, col);
                             ImGui::BufferingBar("##buffer_bar", job_info.progress, ImVec2(400, 6), bg, col);
 
+                            // Progress of each series, which can be cancelled independently
+                            ImGui::BeginChild("series_progress", ImVec2(600, std::min(30.f * import_progress.size(), 300.f)));
+                            for (auto& series : import_progress) {
+                                ImGui::PushID(series.get());
+                                if (series->skipped) {
+                                    ImGui::TextDisabled("%s (already in the project)", series->id.c_str());
+                                }
+                                else {
+                                    int series_done = series->num_done;
+                                    std::string overlay = std::to_string(series_done) + " / " + std::to_string(series->num_images);
+                                    ImGui::ProgressBar(series->num_images > 0 ? float(series_done) / float(series->num_images) : 1.f,
+                                                       ImVec2(200, 0), overlay.c_str());
+                                    ImGui::SameLine();
+                                    if (series->cancel) {
+                                        ImGui::TextDisabled("Cancelled");
+                                    }
+                                    else if (series_done == series->num_images) {
+                                        ImGui::Text("Done     ");
+                                    }
+                                    else if (ImGui::Button("Cancel", ImVec2(60, 0))) {
+                                        series->cancel = true;
+                                    }
+                                    ImGui::SameLine();
+                                    ImGui::Text("%s", series->id.c_str());
+                                }
+                                ImGui::PopID();
+                            }
+                            ImGui::EndChild();
+
+                            if (ImGui::Button("Cancel import")) {
+                                JobScheduler::getInstance().stopJob(job_id_);
+                            }
+
                             if (job_info.name.empty()) {
                                 ImGui::CloseCurrentPopup();
                             }
@@ -31,6 +31,11 @@ void Rendering::MainMenuBar::ImGuiDraw(GLFWwindow *window, Rect &parent_dimensio
             settings_menu();
             ImGui::EndMenu();
         }
+
+        if (ImGui::BeginMenu("View")) {
+            ImGui::MenuItem("Performance", nullptr, &performance_window_.isOpen());
+            ImGui::EndMenu();
+        }
         if (!page_title_.empty()) {
             ImGui::SameLine((ImGui::GetWindowWidth() - 200.f) / 2);
             ImGui::TextDisabled(page_title_.c_str());
@@ -61,6 +66,7 @@ void Rendering::MainMenuBar::ImGuiDraw(GLFWwindow *window, Rect &parent_dimensio
         //}
         ImGui::EndMainMenuBar();
     }
+    performance_window_.ImGuiDraw(window, parent_dimension);
     //if (close_projects_ && project_manager_.getNumProjects() == 0) {
     //    EventQueue::getInstance().post(Event_ptr(new SetViewEvent(std::make_unique<DefaultView>())));
     //    close_projects_ = false;
@@ -174,6 +180,18 @@ void Rendering::MainMenuBar::settings_menu(){
         },
         ImGuiWindowFlags_AlwaysAutoResize);
     }
+    if (ImGui::MenuItem("Prediction")) {
+        Modals::getInstance().setModal("Prediction settings", [] (bool &show, bool &enter, bool &escape) {
+            ImGui::DragInt("Images per batch", &Settings::getInstance().getPredictionBatchSize(), 0.2f, 1, 64);
+            ImGui::DragInt("Threads (0 for all)", &Settings::getInstance().getPredictionThreads(), 0.2f, 0, 64);
+            if(ImGui::Button("Ok") || escape || enter) {
+                BM_DEBUG("Set prediction settings");
+                Settings::getInstance().saveSettings();
+                show = false;
+            }
+        },
+        ImGuiWindowFlags_AlwaysAutoResize);
+    }
 }
 
 void Rendering::MainMenuBar::open_file(std::string filename) {
@@ -11,6 +11,7 @@
 #include "rendering/ui/modales/error_message.h"
 #include "rendering/ui/project/new_project.h"
 #include "rendering/ui/project/close_project_modal.h"
+#include "rendering/ui/performance_window.h"
 
 #include "core/project/project_manager.h"
 
@@ -37,6 +38,7 @@ namespace Rendering {
         bool close_projects_ = false;
         bool show_modal_ = false;
         CloseProjectModal close_project_modal_;
+        PerformanceWindow performance_window_;
 
         void init_listeners();
         void destroy_listeners();
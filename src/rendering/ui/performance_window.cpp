@@ -0,0 +1,119 @@
+#include "performance_window.h"
+
+#include <algorithm>
+
+#include "nfd.h"
+
+#include "rendering/ui/modales/error_message.h"
+#include "rendering/ui/widgets/util.h"
+#include "profiler.h"
+
+void Rendering::PerformanceWindow::export_trace() {
+    NFD_Init();
+    nfdchar_t *outPath;
+    nfdfilteritem_t filterItem[1] = { { "Chrome trace", "json" } };
+    nfdresult_t result = NFD_SaveDialog(&outPath, filterItem, 1, nullptr, "trace.json");
+    if (result == NFD_OKAY) {
+        std::string error = Profiler::getInstance().exportTrace(outPath);
+        if (!error.empty())
+            show_error_modal("Error: export trace", "The trace could not be exported.", error);
+        NFD_FreePath(outPath);
+    } else if (result == NFD_ERROR) {
+        show_error_modal("Error: export trace",
+                         "An error has occurred when choosing the file.",
+                         NFD_GetError());
+    }
+    NFD_Quit();
+}
+
+void Rendering::PerformanceWindow::ImGuiDraw(GLFWwindow *window, Rect &parent_dimension) {
+    if (!open_)
+        return;
+    if (!ImGui::Begin("Performance", &open_)) {
+        ImGui::End();
+        return;
+    }
+    auto &profiler = Profiler::getInstance();
+
+    // Frame times
+    auto frame_times = profiler.getFrameTimes();
+    if (!frame_times.empty()) {
+        float sum = 0.f;
+        float max = 0.f;
+        for (float time : frame_times) {
+            sum += time;
+            max = std::max(max, time);
+        }
+        ImGui::Text("Frame: %.2f ms (mean %.2f ms, max %.2f ms)", frame_times.back(), sum / (float)frame_times.size(), max);
+        ImGui::PlotLines("##frame_times", frame_times.data(), (int)frame_times.size(), 0, nullptr, 0.f,
+                         std::max(max, 1000.f / 60.f), ImVec2(-1, 60));
+    }
+
+    auto counters = profiler.getCounters();
+    int64_t hits = counters["dicom/cache_hits"];
+    int64_t misses = counters["dicom/cache_misses"];
+    if (hits + misses > 0) {
+        ImGui::Text("Slice cache hit rate: %.1f%% (%lld hits, %lld misses)", 100.f * (float)hits / (float)(hits + misses),
+                    (long long)hits, (long long)misses);
+    }
+    ImGui::Text("Texture uploads: %.1f MB", (double)counters["image/texture_upload_bytes"] / (1024. * 1024.));
+
+    // Trace
+    if (profiler.isTracing()) {
+        if (ImGui::Button("Stop trace"))
+            profiler.stopTrace();
+        ImGui::SameLine();
+        ImGui::Text("%zu events", profiler.getTraceSize());
+    } else {
+        if (ImGui::Button("Record trace"))
+            profiler.startTrace();
+        ImGui::SameLine();
+        if (ImGui::Button("Export trace"))
+            export_trace();
+        ImGui::SameLine();
+        Widgets::HelpMarker("Exports the last recorded trace in the Chrome trace-event format,\n"
+                            "which can be opened in chrome://tracing or Perfetto.");
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Reset"))
+        profiler.reset();
+
+    ImGui::Separator();
+
+    // Timers : queue wait and run time of the jobs, GIL, decode, ...
+    ImGui::BeginChild("timers");
+    ImGui::Columns(5, "timers");
+    ImGui::Text("Timer");
+    ImGui::NextColumn();
+    ImGui::Text("Count");
+    ImGui::NextColumn();
+    ImGui::Text("Total (ms)");
+    ImGui::NextColumn();
+    ImGui::Text("Mean (ms)");
+    ImGui::NextColumn();
+    ImGui::Text("Max (ms)");
+    ImGui::NextColumn();
+    ImGui::Separator();
+    for (auto &timer : profiler.getTimers()) {
+        auto &stats = timer.second;
+        ImGui::Text("%s", timer.first.c_str());
+        ImGui::NextColumn();
+        ImGui::Text("%llu", (unsigned long long)stats.count);
+        ImGui::NextColumn();
+        ImGui::Text("%.1f", stats.total_ms);
+        ImGui::NextColumn();
+        ImGui::Text("%.3f", stats.count > 0 ? stats.total_ms / (double)stats.count : 0.);
+        ImGui::NextColumn();
+        ImGui::Text("%.3f", stats.max_ms);
+        ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+
+    ImGui::Separator();
+    for (auto &counter : counters) {
+        ImGui::Text("%s: %lld", counter.first.c_str(), (long long)counter.second);
+    }
+    ImGui::EndChild();
+
+    ImGui::End();
+}
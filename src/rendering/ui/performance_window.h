@@ -0,0 +1,26 @@
+#pragma once
+
+#include "first_include.h"
+
+#include "imgui.h"
+
+#include "rendering/drawables.h"
+
+namespace Rendering {
+
+    /**
+     * Dockable window that shows the measures of the Profiler (frame times, timers, counters) and records traces
+     */
+    class PerformanceWindow : public AbstractLayout {
+    private:
+        bool open_ = false;
+
+        void export_trace();
+    public:
+        PerformanceWindow() = default;
+
+        bool& isOpen() { return open_; }
+
+        void ImGuiDraw(GLFWwindow *window, Rect &parent_dimension) override;
+    };
+}
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <exception>
 #include <fstream>
+#include <algorithm>
 
 
 class SettingsError: public std::exception
@@ -85,6 +86,12 @@ void Settings::saveSettings() {
     const toml::value recent_files{
             {"recent", recent_projects_}};
     file << recent_files << std::endl;
+
+    file << "[prediction]" << std::endl;
+    const toml::value prediction{
+            {"batch_size", prediction_batch_size_},
+            {"threads", prediction_threads_}};
+    file << prediction << std::endl;
 }
 
 void Settings::loadSettings(std::string filename) {
@@ -128,6 +135,13 @@ void Settings::loadSettings(std::string filename) {
     for(auto& name : file_list) {
         recent_projects_.push_back(name);
     }
+
+    // Prediction settings, missing in the settings files of older versions
+    if (settings.as_table().count("prediction")) {
+        const auto prediction = toml::find(settings, "prediction");
+        prediction_batch_size_ = std::max(toml::find_or<int>(prediction, "batch_size", prediction_batch_size_), 1);
+        prediction_threads_ = std::max(toml::find_or<int>(prediction, "threads", prediction_threads_), 0);
+    }
 }
 
 void Settings::addRecentFile(std::string filename) {
@@ -24,6 +24,10 @@ private:
     // In percentage
     int ui_size_ = 100;
 
+    // Number of images per forward pass of the ML models, and number of threads that predict (0 for all)
+    int prediction_batch_size_ = 8;
+    int prediction_threads_ = 0;
+
     // For saving the settings to the disk
     std::string filesave_;
 
@@ -117,6 +121,16 @@ public:
      */
     Theme getCurrentTheme() { return current_theme_; }
 
+    /**
+     * @return returns the number of images given at once to the ML models
+     */
+    int &getPredictionBatchSize() { return prediction_batch_size_; }
+
+    /**
+     * @return returns the number of threads that run the ML models (0 for all the workers)
+     */
+    int &getPredictionThreads() { return prediction_threads_; }
+
     /**
      * @return returns the recent files (projects) saved in the settings
      */
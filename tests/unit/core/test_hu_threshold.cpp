@@ -0,0 +1,107 @@
+#include <random>
+#include <string>
+
+#include "core/segmentation/mask.h"
+#include "core/segmentation/hu_threshold.h"
+#include <gtest/gtest.h>
+
+using core::segmentation::Mask;
+using core::segmentation::HuThresholdCache;
+using core::segmentation::huThresholdMask;
+
+namespace {
+    /**
+     * Smooth random HU values, so that the thresholds give objects of various sizes
+     */
+    cv::Mat random_slice(int rows, int cols, unsigned int seed) {
+        cv::theRNG().state = seed;
+        cv::Mat noise(rows, cols, CV_16S);
+        cv::randu(noise, cv::Scalar(-300), cv::Scalar(400));
+        cv::Mat slice;
+        cv::blur(noise, slice, cv::Size(5, 5));
+        return slice;
+    }
+
+    int num_differences(const Mask& expected, const Mask& mask) {
+        if (expected.getData().size() != mask.getData().size())
+            return -1;
+        cv::Mat different;
+        cv::compare(expected.getData(), mask.getData(), different, cv::CMP_NE);
+        return cv::countNonZero(different);
+    }
+
+    /**
+     * Random sequence of bounds and morphology sizes, each update is compared to a full recompute
+     */
+    void check_random_sequence(const cv::Mat& slice, unsigned int seed) {
+        std::mt19937 random(seed);
+        std::uniform_int_distribution<int> min_hu(-250, 250);
+        std::uniform_int_distribution<int> range(0, 300);
+        std::uniform_int_distribution<int> morphology_size(0, 3);
+        std::uniform_int_distribution<int> one_in(0, 9);
+
+        HuThresholdCache cache;
+        int closing_size = 0, opening_size = 0;
+        bool ignore_small_objects = false;
+        int min = -29, max = 150;
+        for (int step = 0; step < 200; step++) {
+            // Mostly the bounds move, as when a slider is dragged
+            if (one_in(random) == 0) {
+                closing_size = morphology_size(random);
+                opening_size = morphology_size(random);
+            }
+            if (one_in(random) == 0)
+                ignore_small_objects = !ignore_small_objects;
+            if (one_in(random) < 5) {
+                min = min_hu(random);
+                max = min + range(random);
+            }
+            else {
+                max = std::max(min, max + range(random) / 10 - 15);
+            }
+
+            Mask expected = huThresholdMask(slice, min, max, ignore_small_objects, closing_size, opening_size);
+            Mask mask = cache.update(slice, min, max, ignore_small_objects, closing_size, opening_size);
+            ASSERT_EQ(num_differences(expected, mask), 0)
+                << "Step " << step << ": [" << min << ", " << max << "], closing " << closing_size
+                << ", opening " << opening_size << ", ignore small objects " << ignore_small_objects;
+        }
+    }
+}
+
+TEST(HuThresholdCache, SameAsFullRecompute) {
+    check_random_sequence(random_slice(128, 128, 1), 1);
+    check_random_sequence(random_slice(97, 131, 2), 2);
+}
+
+/*
+ * Crops of a slice are not continuous
+ */
+TEST(HuThresholdCache, Crop) {
+    cv::Mat slice = random_slice(128, 128, 3);
+    check_random_sequence(slice(cv::Rect(10, 5, 100, 90)), 3);
+}
+
+/*
+ * A new slice, or a slice whose values changed in place, is not thresholded with the index of the previous one
+ */
+TEST(HuThresholdCache, NewImage) {
+    HuThresholdCache cache;
+    cv::Mat first = random_slice(64, 64, 4);
+    cv::Mat second = random_slice(64, 64, 5);
+    cache.update(first, -29, 150, false, 1, 1);
+
+    Mask mask = cache.update(second, -29, 150, false, 1, 1);
+    EXPECT_EQ(num_differences(huThresholdMask(second, -29, 150, false, 1, 1), mask), 0);
+
+    // Other size, same buffer
+    mask = cache.update(second(cv::Rect(0, 0, 32, 64)), -29, 150, false, 1, 1);
+    EXPECT_EQ(num_differences(huThresholdMask(second(cv::Rect(0, 0, 32, 64)), -29, 150, false, 1, 1), mask), 0);
+
+    // Same buffer, values written in place
+    random_slice(64, 64, 6).copyTo(second);
+    mask = cache.update(second, -29, 150, false, 1, 1, 1);
+    EXPECT_EQ(num_differences(huThresholdMask(second, -29, 150, false, 1, 1), mask), 0);
+    mask = cache.update(second, -29, 160, false, 1, 1, 1);
+    EXPECT_EQ(num_differences(huThresholdMask(second, -29, 160, false, 1, 1), mask), 0);
+}
@@ -0,0 +1,247 @@
+#include <string>
+#include <vector>
+#include <cstring>
+#include <filesystem>
+
+#include <zlib.h>
+
+#include "core/dataset/npz.h"
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+using core::dataset::NpzReader;
+using core::dataset::NpzWriter;
+using core::dataset::NpyArray;
+
+namespace {
+    cv::Mat make_matrix(int rows, int cols, int type) {
+        cv::Mat matrix(rows, cols, type);
+        for (size_t i = 0; i < matrix.total() * matrix.elemSize(); i++)
+            matrix.data[i] = (unsigned char) (i * 7 + rows);
+        return matrix;
+    }
+
+    bool is_same(const cv::Mat& lhs, const cv::Mat& rhs) {
+        return lhs.rows == rhs.rows && lhs.cols == rhs.cols && lhs.type() == rhs.type()
+               && memcmp(lhs.data, rhs.data, lhs.total() * lhs.elemSize()) == 0;
+    }
+
+    void put_u16(std::string& out, uint16_t value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void put_u32(std::string& out, uint32_t value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    /**
+     * Archive as written by numpy.savez for np.array(None), which is how the app saves the masks that do not exist:
+     * a 0-d array of objects (pickled None), not compressed
+     */
+    std::string missing_mask_archive(const std::string& name) {
+        std::string header = "{'descr': '|O', 'fortran_order': False, 'shape': (), }";
+        header.append(128 - 10 - header.size() - 1, ' ');
+        header += '\n';
+        std::string npy = std::string("\x93NUMPY\x01\x00", 8);
+        put_u16(npy, (uint16_t) header.size());
+        npy += header;
+        npy += std::string("\x80\x02N.", 4);
+
+        std::string filename = name + ".npy";
+        uint32_t crc = (uint32_t) crc32(0L, (const Bytef*) npy.data(), (uInt) npy.size());
+        auto put_sizes = [&](std::string& out) {
+            put_u32(out, crc);
+            put_u32(out, (uint32_t) npy.size());
+            put_u32(out, (uint32_t) npy.size());
+            put_u16(out, (uint16_t) filename.size());
+            put_u16(out, 0);
+        };
+
+        std::string archive;
+        put_u32(archive, 0x04034b50);
+        put_u16(archive, 20);
+        put_u16(archive, 0);
+        put_u16(archive, 0);
+        put_u32(archive, 0);
+        put_sizes(archive);
+        archive += filename + npy;
+
+        uint32_t directory_offset = (uint32_t) archive.size();
+        put_u32(archive, 0x02014b50);
+        put_u16(archive, 20);
+        put_u16(archive, 20);
+        put_u16(archive, 0);
+        put_u16(archive, 0);
+        put_u32(archive, 0);
+        put_sizes(archive);
+        put_u16(archive, 0);
+        put_u16(archive, 0);
+        put_u16(archive, 0);
+        put_u32(archive, 0);
+        put_u32(archive, 0);
+        archive += filename;
+        uint32_t directory_size = (uint32_t) archive.size() - directory_offset;
+
+        put_u32(archive, 0x06054b50);
+        put_u16(archive, 0);
+        put_u16(archive, 0);
+        put_u16(archive, 1);
+        put_u16(archive, 1);
+        put_u32(archive, directory_size);
+        put_u32(archive, directory_offset);
+        put_u16(archive, 0);
+        return archive;
+    }
+}
+
+/*
+ * The arrays written are read back with the same type, shape and values
+ */
+TEST(Npz, RoundTrip) {
+    cv::Mat mask = make_matrix(20, 30, CV_8U);
+    cv::Mat image = make_matrix(16, 8, CV_16S);
+    NpzWriter writer;
+    writer.add("mask", mask);
+    writer.add("matrix", image);
+    writer.add("spacing", std::vector<double>{0.7, 0.8});
+    writer.add("windowing", std::vector<int64_t>{400, 40});
+    std::string archive;
+    ASSERT_EQ(writer.encode(archive), "");
+
+    std::string filename = (fs::temp_directory_path() / "bm_test_npz.npz").string();
+    ASSERT_EQ(NpzWriter::writeFile(filename, archive), "");
+    NpzReader reader;
+    ASSERT_EQ(reader.open(filename), "");
+    fs::remove(filename);
+    EXPECT_EQ(reader.getNames(), (std::vector<std::string>{"mask", "matrix", "spacing", "windowing"}));
+
+    NpyArray array;
+    cv::Mat read;
+    ASSERT_EQ(reader.read("mask", array), "");
+    ASSERT_TRUE(array.toMat(read));
+    EXPECT_TRUE(is_same(mask, read)) << "Mask read is not the one written";
+    ASSERT_EQ(reader.read("matrix", array), "");
+    ASSERT_TRUE(array.toMat(read));
+    EXPECT_TRUE(is_same(image, read)) << "Image read is not the one written";
+
+    ASSERT_EQ(reader.read("spacing", array), "");
+    EXPECT_EQ(array.descr, "<f8");
+    EXPECT_EQ(array.shape, std::vector<size_t>{2});
+    ASSERT_EQ(array.data.size(), 2 * sizeof(double));
+    double spacing[2];
+    memcpy(spacing, array.data.data(), sizeof(spacing));
+    EXPECT_EQ(spacing[0], 0.7);
+    EXPECT_EQ(spacing[1], 0.8);
+
+    ASSERT_EQ(reader.read("windowing", array, true), "");
+    EXPECT_EQ(array.descr, "<i8");
+    EXPECT_EQ(array.shape, std::vector<size_t>{2});
+    EXPECT_TRUE(array.data.empty()) << "Only the header should be read";
+
+    EXPECT_NE(reader.read("users", array), "");
+}
+
+/*
+ * Arrays copied from another archive are not decompressed, and can be read as the original ones
+ */
+TEST(Npz, Copy) {
+    cv::Mat current = make_matrix(12, 10, CV_8U);
+    cv::Mat validated = make_matrix(12, 10, CV_8U);
+    validated.data[0] = 42;
+    NpzWriter writer;
+    writer.add("current", current);
+    writer.add("validated", validated);
+    std::string archive;
+    ASSERT_EQ(writer.encode(archive), "");
+    NpzReader reader;
+    ASSERT_EQ(reader.parse(archive), "");
+
+    // Same as a batch operation that only changes one layer
+    cv::Mat predicted = make_matrix(12, 10, CV_8U);
+    predicted.data[1] = 3;
+    NpzWriter copy_writer;
+    EXPECT_TRUE(copy_writer.copy(reader, "current"));
+    EXPECT_TRUE(copy_writer.copy(reader, "validated"));
+    EXPECT_FALSE(copy_writer.copy(reader, "users"));
+    copy_writer.add("predicted", predicted);
+    std::string copy;
+    ASSERT_EQ(copy_writer.encode(copy), "");
+
+    NpzReader copy_reader;
+    ASSERT_EQ(copy_reader.parse(copy), "");
+    EXPECT_EQ(copy_reader.getNames(), (std::vector<std::string>{"current", "validated", "predicted"}));
+    NpyArray array;
+    cv::Mat read;
+    ASSERT_EQ(copy_reader.read("current", array), "");
+    ASSERT_TRUE(array.toMat(read));
+    EXPECT_TRUE(is_same(current, read));
+    ASSERT_EQ(copy_reader.read("validated", array), "");
+    ASSERT_TRUE(array.toMat(read));
+    EXPECT_TRUE(is_same(validated, read));
+    ASSERT_EQ(copy_reader.read("predicted", array), "");
+    ASSERT_TRUE(array.toMat(read));
+    EXPECT_TRUE(is_same(predicted, read));
+}
+
+/*
+ * Masks that do not exist are 0-d arrays of objects, they can be inspected and copied but not converted
+ */
+TEST(Npz, MissingMask) {
+    NpzReader reader;
+    ASSERT_EQ(reader.parse(missing_mask_archive("validated")), "");
+    ASSERT_TRUE(reader.contains("validated"));
+
+    NpyArray array;
+    ASSERT_EQ(reader.read("validated", array, true), "");
+    EXPECT_EQ(array.descr, "|O");
+    EXPECT_TRUE(array.shape.empty()) << "A missing mask must have no dimension";
+    ASSERT_EQ(reader.read("validated", array), "");
+    cv::Mat read;
+    EXPECT_FALSE(array.toMat(read)) << "An array of objects can not be converted";
+
+    NpzWriter writer;
+    ASSERT_TRUE(writer.copy(reader, "validated"));
+    writer.add("current", make_matrix(4, 4, CV_8U));
+    std::string archive;
+    ASSERT_EQ(writer.encode(archive), "");
+    NpzReader copy_reader;
+    ASSERT_EQ(copy_reader.parse(archive), "");
+    ASSERT_EQ(copy_reader.read("validated", array), "");
+    EXPECT_EQ(array.descr, "|O");
+    EXPECT_TRUE(array.shape.empty());
+}
+
+/*
+ * A truncated or corrupted archive is reported, not read as a valid one
+ */
+TEST(Npz, TruncatedArchive) {
+    NpzWriter writer;
+    writer.add("current", make_matrix(64, 64, CV_8U));
+    writer.add("predicted", make_matrix(64, 64, CV_8U));
+    std::string archive;
+    ASSERT_EQ(writer.encode(archive), "");
+
+    NpzReader reader;
+    EXPECT_NE(reader.parse(""), "");
+    for (size_t size : {archive.size() - 1, archive.size() - 30, archive.size() / 2, (size_t) 10})
+        EXPECT_NE(reader.parse(archive.substr(0, size)), "") << "Archive truncated to " << size << " bytes";
+
+    std::string filename = (fs::temp_directory_path() / "bm_test_npz_truncated.npz").string();
+    ASSERT_EQ(NpzWriter::writeFile(filename, archive.substr(0, archive.size() / 2)), "");
+    EXPECT_NE(reader.open(filename), "");
+    fs::remove(filename);
+    EXPECT_NE(reader.open(filename), "") << "Missing file should be reported";
+
+    // Data of the first array changed, its directory being intact
+    ASSERT_EQ(reader.parse(archive), "");
+    uint16_t name_length, extra_length;
+    memcpy(&name_length, archive.data() + 26, sizeof(name_length));
+    memcpy(&extra_length, archive.data() + 28, sizeof(extra_length));
+    std::string corrupted = archive;
+    size_t data = 30 + name_length + extra_length + 2;
+    corrupted[data] = (char) ~corrupted[data];
+    ASSERT_EQ(reader.parse(corrupted), "");
+    NpyArray array;
+    EXPECT_NE(reader.read("current", array), "") << "Corrupted data should be reported";
+    EXPECT_EQ(reader.read("predicted", array), "");
+}
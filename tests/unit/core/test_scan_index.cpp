@@ -0,0 +1,101 @@
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include "core/dataset/scan_index.h"
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+using core::dataset::ScanIndex;
+using core::dataset::ScanIndexEntry;
+
+namespace {
+    ScanIndexEntry make_entry(uint64_t size, const std::string& patient) {
+        ScanIndexEntry entry;
+        entry.size = size;
+        entry.mtime = 1000 + (int64_t)size;
+        entry.found = true;
+        entry.has_case = true;
+        entry.case_.patientID = patient;
+        entry.case_.seriesNumber = "3";
+        return entry;
+    }
+
+    fs::path index_folder() {
+        fs::path folder = fs::temp_directory_path() / "bm_test_scan_index";
+        fs::remove_all(folder);
+        return folder;
+    }
+}
+
+/*
+ * The files of a previous scan are found again after reloading the index
+ */
+TEST(ScanIndex, SaveAndLoad) {
+    fs::path folder = index_folder();
+    std::vector<std::pair<std::string, ScanIndexEntry>> entries = {
+        {"a.dcm", make_entry(10, "patient_a")},
+        {"b.dcm", make_entry(20, "patient_b")}
+    };
+    {
+        ScanIndex index("/data/scan", folder.string());
+        ASSERT_EQ(index.load(), "");
+        ASSERT_EQ(index.save(entries, true), "");
+    }
+
+    ScanIndex index("/data/scan", folder.string());
+    ASSERT_EQ(index.load(), "");
+    auto found = index.lookup("b.dcm", 20, 1020);
+    ASSERT_NE(found, nullptr) << "File of the previous scan not found";
+    EXPECT_EQ(found->case_.patientID, "patient_b");
+    EXPECT_EQ(found->case_.path, "b.dcm");
+    EXPECT_EQ(index.lookup("b.dcm", 21, 1020), nullptr) << "Changed file should not be found";
+
+    // Another root has its own index
+    ScanIndex other("/data/other", folder.string());
+    ASSERT_EQ(other.load(), "");
+    EXPECT_EQ(other.lookup("a.dcm", 10, 1010), nullptr);
+
+    fs::remove_all(folder);
+}
+
+/*
+ * A record cut in the middle (the app stopped while appending) must not corrupt the records appended afterwards
+ */
+TEST(ScanIndex, TruncatedRecord) {
+    fs::path folder = index_folder();
+    std::string filename;
+    {
+        std::vector<std::pair<std::string, ScanIndexEntry>> entries = {{"a.dcm", make_entry(10, "patient_a")}};
+        ScanIndex index("/data/scan", folder.string());
+        ASSERT_EQ(index.load(), "");
+        ASSERT_EQ(index.save(entries, true), "");
+        // Appended record
+        entries = {{"b.dcm", make_entry(20, "patient_b")}};
+        ASSERT_EQ(index.save(entries, false), "");
+        filename = index.getFilename();
+    }
+    fs::resize_file(filename, fs::file_size(filename) - 5);
+
+    {
+        ScanIndex index("/data/scan", folder.string());
+        ASSERT_EQ(index.load(), "");
+        EXPECT_NE(index.lookup("a.dcm", 10, 1010), nullptr);
+        EXPECT_EQ(index.lookup("b.dcm", 20, 1020), nullptr) << "Truncated record should be ignored";
+
+        std::vector<std::pair<std::string, ScanIndexEntry>> entries = {{"c.dcm", make_entry(30, "patient_c")}};
+        ASSERT_EQ(index.save(entries, false), "");
+    }
+
+    ScanIndex index("/data/scan", folder.string());
+    ASSERT_EQ(index.load(), "");
+    auto found_a = index.lookup("a.dcm", 10, 1010);
+    auto found_c = index.lookup("c.dcm", 30, 1030);
+    ASSERT_NE(found_a, nullptr);
+    ASSERT_NE(found_c, nullptr) << "Record saved after the truncated one could not be read";
+    EXPECT_EQ(found_a->case_.patientID, "patient_a");
+    EXPECT_EQ(found_c->case_.patientID, "patient_c");
+    EXPECT_EQ(found_c->case_.seriesNumber, "3");
+
+    fs::remove_all(folder);
+}